@@ -0,0 +1,749 @@
+// Reads a corpus of small files with io_uring or threads, see
+// corpus_reader.h.
+
+// pread(), O_CLOEXEC and struct statx.
+#define _GNU_SOURCE
+
+#include "corpus_reader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "wav_reader.h"
+
+typedef struct FileNode FileNode;
+
+struct FileNode {
+  CorpusFile file;  // First, CorpusReader_Release() gets it back.
+  uint8_t* buffer;
+  // Size of the file when opened, allocated and counted against the memory
+  // limit as a whole.
+  size_t capacity;
+  // Up to the end of the data chunk once the first read is in, at most
+  // |capacity|.
+  size_t expected;
+  FileNode* next;
+};
+
+enum {
+  kSlotFree = 0,
+  kSlotOpening,
+  kSlotStating,
+  kSlotWaitingForMemory,
+  kSlotReading,
+  kSlotClosing
+};
+
+typedef struct {
+  int state;
+  int fd;
+  FileNode* node;
+  // Of the read in flight.
+  size_t read_size;
+  // Turn in the queue for memory, while waiting for it.
+  uint64_t ticket;
+  struct statx status;
+} Slot;
+
+typedef struct {
+  int fd;
+  uint32_t* sq_head;
+  uint32_t* sq_tail;
+  uint32_t sq_mask;
+  uint32_t* sq_array;
+  uint32_t* cq_head;
+  uint32_t* cq_tail;
+  uint32_t cq_mask;
+  struct io_uring_sqe* sqes;
+  struct io_uring_cqe* cqes;
+  void* sq_map;
+  size_t sq_map_size;
+  void* cq_map;
+  size_t cq_map_size;
+  size_t sqes_size;
+  uint32_t sq_entries;
+  uint32_t to_submit;
+} Ring;
+
+struct CorpusReader {
+  CorpusReaderConfig config;
+  const char* const* paths;
+  size_t num_paths;
+  int use_io_uring;
+  Ring ring;
+  pthread_t* threads;
+  int num_threads;
+
+  pthread_mutex_t mutex;
+  // Signaled when a file is ready, and when all are.
+  pthread_cond_t ready;
+  // Signaled when memory is released.
+  pthread_cond_t released;
+  FileNode* ready_head;
+  FileNode* ready_tail;
+  size_t num_completed;
+  size_t num_taken;
+  // Bytes of the buffers of all files, loading or loaded.
+  size_t memory_used;
+  // Files get memory in the order their sizes became known, so that a large
+  // one is not starved by a stream of small ones.
+  uint64_t next_ticket;
+  uint64_t serving_ticket;
+  size_t next_path;
+  int stopping;
+  // Set when a reading thread gave up, out of memory or with a broken ring.
+  // No more files are started, and CorpusReader_Next() returns NULL once the
+  // started ones are taken.
+  int failed;
+};
+
+void CorpusReader_DefaultConfig(CorpusReaderConfig* config) {
+  config->queue_depth = 256;
+  config->first_read = 64 << 10;
+  config->memory_limit = (size_t) 256 << 20;
+  config->max_file_size = (size_t) 1 << 30;
+  config->num_threads = 16;
+  config->use_io_uring = 1;
+}
+
+// Needs |self->mutex|. Takes |bytes| from the budget if it is the turn of
+// |ticket| and they fit, or nothing else is loaded.
+static int TryReserve(CorpusReader* self, uint64_t ticket, size_t bytes) {
+  if (ticket != self->serving_ticket ||
+      (self->memory_used + bytes > self->config.memory_limit &&
+       self->memory_used > 0)) {
+    return 0;
+  }
+  self->memory_used += bytes;
+  self->serving_ticket++;
+  pthread_cond_broadcast(&self->released);  // The next turn.
+  return 1;
+}
+
+// Needs |self->mutex|. Whether every file that will be completed is.
+static int AllCompleted(const CorpusReader* self) {
+  return self->num_completed ==
+      (self->failed ? self->next_path : self->num_paths);
+}
+
+// Needs |self->mutex|. Stops starting files, see |failed|.
+static void Fail(CorpusReader* self) {
+  self->failed = 1;
+  pthread_cond_broadcast(&self->ready);
+  pthread_cond_broadcast(&self->released);
+}
+
+// Hands |node| over to CorpusReader_Next(), with |error| or its data.
+static void Complete(CorpusReader* self, FileNode* node, int error) {
+  pthread_mutex_lock(&self->mutex);
+  if (error != 0) {
+    free(node->buffer);
+    node->buffer = NULL;
+    self->memory_used -= node->capacity;
+    node->capacity = 0;
+    pthread_cond_broadcast(&self->released);
+  }
+  node->file.error = error;
+  node->file.data = node->buffer;
+  node->next = NULL;
+  if (self->ready_tail != NULL) {
+    self->ready_tail->next = node;
+  } else {
+    self->ready_head = node;
+  }
+  self->ready_tail = node;
+  self->num_completed++;
+  pthread_cond_signal(&self->ready);
+  if (AllCompleted(self)) {
+    pthread_cond_broadcast(&self->ready);
+  }
+  pthread_mutex_unlock(&self->mutex);
+}
+
+// Needs |self->mutex|. Returns the next file, or NULL if all are started or
+// the reader failed.
+static FileNode* StartFile(CorpusReader* self) {
+  FileNode* node;
+
+  if (self->next_path == self->num_paths || self->failed) {
+    return NULL;
+  }
+  node = (FileNode*) calloc(1, sizeof(FileNode));
+  if (node == NULL) {
+    Fail(self);
+    return NULL;
+  }
+  node->file.index = self->next_path++;
+  node->file.path = self->paths[node->file.index];
+  return node;
+}
+
+// Checks the size of an opened file and queues it for memory.
+//
+// returns : 0 - (OK), or an errno value
+static int SetSize(CorpusReader* self, FileNode* node, uint64_t size,
+                   uint64_t* ticket) {
+  if (size > self->config.max_file_size) {
+    return EFBIG;
+  }
+  node->capacity = (size_t) size;
+  pthread_mutex_lock(&self->mutex);
+  *ticket = self->next_ticket++;
+  pthread_mutex_unlock(&self->mutex);
+  return 0;
+}
+
+// Allocates the buffer of |node| once its memory is reserved.
+static int Allocate(CorpusReader* self, FileNode* node) {
+  // One byte at least, so that |data| is only NULL on errors.
+  node->buffer = (uint8_t*) malloc(node->capacity > 0 ? node->capacity : 1);
+  if (node->buffer == NULL) {
+    pthread_mutex_lock(&self->mutex);
+    self->memory_used -= node->capacity;
+    pthread_cond_broadcast(&self->released);
+    pthread_mutex_unlock(&self->mutex);
+    node->capacity = 0;
+    return ENOMEM;
+  }
+  return 0;
+}
+
+// Size of the first read of |node|.
+static size_t FirstRead(const CorpusReader* self, const FileNode* node) {
+  return node->capacity < self->config.first_read ? node->capacity :
+      self->config.first_read;
+}
+
+// After a read of |read_size| bytes returned |result|, returns the size of
+// the next read, or 0 when the file is complete. The header may claim more
+// than the file holds, so the size when opened bounds it.
+static size_t NextRead(FileNode* node, size_t read_size, size_t result) {
+  const int first = node->file.size == 0;
+
+  node->file.size += result;
+  if (result < read_size) {
+    return 0;  // End of file, it shrank since it was opened.
+  }
+  if (first) {
+    node->expected = WavReader_ExpectedSize(node->buffer, node->file.size);
+    if (node->expected == 0 || node->expected > node->capacity) {
+      node->expected = node->capacity;
+    }
+  }
+  return node->file.size < node->expected ?
+      node->expected - node->file.size : 0;
+}
+
+// Reading threads, without io_uring.
+
+static int ReadWithPread(CorpusReader* self, FileNode* node, int fd) {
+  struct stat status;
+  uint64_t ticket;
+  size_t read_size;
+  int reserved = 0;
+  int error;
+
+  if (fstat(fd, &status) != 0) {
+    return errno;
+  }
+  error = SetSize(self, node, (uint64_t) status.st_size, &ticket);
+  if (error != 0) {
+    return error;
+  }
+  pthread_mutex_lock(&self->mutex);
+  while (!self->stopping && !(reserved = TryReserve(self, ticket,
+                                                    node->capacity))) {
+    pthread_cond_wait(&self->released, &self->mutex);
+  }
+  pthread_mutex_unlock(&self->mutex);
+  if (!reserved) {
+    node->capacity = 0;
+    return ECANCELED;
+  }
+  error = Allocate(self, node);
+  for (read_size = FirstRead(self, node); error == 0 && read_size > 0;) {
+    const ssize_t result = pread(fd, node->buffer + node->file.size,
+                                 read_size, (off_t) node->file.size);
+
+    if (result < 0) {
+      return errno;
+    }
+    read_size = NextRead(node, read_size, (size_t) result);
+  }
+  return error;
+}
+
+static void* RunReadThread(void* argument) {
+  CorpusReader* self = (CorpusReader*) argument;
+
+  for (;;) {
+    FileNode* node = NULL;
+    int fd, error;
+
+    pthread_mutex_lock(&self->mutex);
+    if (!self->stopping) {
+      node = StartFile(self);
+    }
+    pthread_mutex_unlock(&self->mutex);
+    if (node == NULL) {
+      return NULL;
+    }
+    fd = open(node->file.path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      Complete(self, node, errno);
+      continue;
+    }
+    error = ReadWithPread(self, node, fd);
+    close(fd);
+    Complete(self, node, error);
+  }
+}
+
+// io_uring, by raw system calls.
+
+static int SetUpRing(Ring* ring, uint32_t entries) {
+  struct io_uring_params params;
+
+  memset(ring, 0, sizeof(*ring));
+  memset(&params, 0, sizeof(params));
+  ring->fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd < 0) {
+    return -1;
+  }
+  ring->sq_map_size = params.sq_off.array + params.sq_entries *
+      sizeof(uint32_t);
+  ring->cq_map_size = params.cq_off.cqes + params.cq_entries *
+      sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring->cq_map_size > ring->sq_map_size) {
+      ring->sq_map_size = ring->cq_map_size;
+    }
+    ring->cq_map_size = 0;
+  }
+  ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  ring->cq_map = ring->sq_map;
+  if (ring->sq_map != MAP_FAILED && ring->cq_map_size != 0) {
+    ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_CQ_RING);
+  }
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = (struct io_uring_sqe*) mmap(NULL, ring->sqes_size,
+                                           PROT_READ | PROT_WRITE,
+                                           MAP_SHARED | MAP_POPULATE,
+                                           ring->fd, IORING_OFF_SQES);
+  if (ring->sq_map == MAP_FAILED || ring->cq_map == MAP_FAILED ||
+      ring->sqes == MAP_FAILED) {
+    return -1;
+  }
+  ring->sq_head = (uint32_t*) ((uint8_t*) ring->sq_map + params.sq_off.head);
+  ring->sq_tail = (uint32_t*) ((uint8_t*) ring->sq_map + params.sq_off.tail);
+  ring->sq_mask = *(uint32_t*) ((uint8_t*) ring->sq_map +
+                                params.sq_off.ring_mask);
+  ring->sq_array = (uint32_t*) ((uint8_t*) ring->sq_map +
+                                params.sq_off.array);
+  ring->cq_head = (uint32_t*) ((uint8_t*) ring->cq_map + params.cq_off.head);
+  ring->cq_tail = (uint32_t*) ((uint8_t*) ring->cq_map + params.cq_off.tail);
+  ring->cq_mask = *(uint32_t*) ((uint8_t*) ring->cq_map +
+                                params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe*) ((uint8_t*) ring->cq_map +
+                                       params.cq_off.cqes);
+  ring->sq_entries = params.sq_entries;
+  return 0;
+}
+
+static void TearDownRing(Ring* ring) {
+  if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+    munmap(ring->sqes, ring->sqes_size);
+  }
+  if (ring->cq_map != NULL && ring->cq_map != MAP_FAILED &&
+      ring->cq_map != ring->sq_map) {
+    munmap(ring->cq_map, ring->cq_map_size);
+  }
+  if (ring->sq_map != NULL && ring->sq_map != MAP_FAILED) {
+    munmap(ring->sq_map, ring->sq_map_size);
+  }
+  if (ring->fd > 0) {
+    close(ring->fd);
+  }
+}
+
+// Submits what is queued, and waits for |min_complete| completions.
+static int Enter(Ring* ring, uint32_t min_complete) {
+  for (;;) {
+    const int submitted = (int) syscall(
+        __NR_io_uring_enter, ring->fd, ring->to_submit, min_complete,
+        min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+
+    if (submitted >= 0) {
+      ring->to_submit -= (uint32_t) submitted;
+      return 0;
+    }
+    if (errno != EINTR) {
+      return -1;
+    }
+  }
+}
+
+// Returns a cleared entry for |slot|. There is always one: every slot has
+// at most one request in flight, and the ring has an entry per slot.
+static struct io_uring_sqe* NextEntry(Ring* ring, int slot, int opcode) {
+  const uint32_t tail = *ring->sq_tail;
+  struct io_uring_sqe* sqe = &ring->sqes[tail & ring->sq_mask];
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = (uint8_t) opcode;
+  sqe->user_data = (uint64_t) slot;
+  ring->sq_array[tail & ring->sq_mask] = tail & ring->sq_mask;
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ring->to_submit++;
+  return sqe;
+}
+
+static void SubmitRead(Ring* ring, Slot* slots, int s) {
+  Slot* slot = &slots[s];
+  struct io_uring_sqe* sqe = NextEntry(ring, s, IORING_OP_READ);
+
+  sqe->fd = slot->fd;
+  sqe->addr = (uint64_t) (uintptr_t) (slot->node->buffer +
+                                      slot->node->file.size);
+  sqe->len = (uint32_t) slot->read_size;
+  sqe->off = slot->node->file.size;
+  slot->state = kSlotReading;
+}
+
+static void SubmitClose(Ring* ring, Slot* slots, int s) {
+  struct io_uring_sqe* sqe = NextEntry(ring, s, IORING_OP_CLOSE);
+
+  sqe->fd = slots[s].fd;
+  slots[s].state = kSlotClosing;
+  slots[s].node = NULL;
+}
+
+// Closes the file of slot |s| and completes it with |error|.
+static void Finish(CorpusReader* self, Slot* slots, int s, int error) {
+  Complete(self, slots[s].node, error);
+  SubmitClose(&self->ring, slots, s);
+}
+
+// Takes the memory of slot |s| and submits its first read, or returns 0 to
+// keep it waiting.
+static int StartReading(CorpusReader* self, Slot* slots, int s) {
+  Slot* slot = &slots[s];
+  int reserved, error;
+
+  pthread_mutex_lock(&self->mutex);
+  reserved = TryReserve(self, slot->ticket, slot->node->capacity);
+  pthread_mutex_unlock(&self->mutex);
+  if (!reserved) {
+    slot->state = kSlotWaitingForMemory;
+    return 0;
+  }
+  error = Allocate(self, slot->node);
+  slot->read_size = FirstRead(self, slot->node);
+  if (error != 0 || slot->read_size == 0) {
+    Finish(self, slots, s, error);
+    return 1;
+  }
+  SubmitRead(&self->ring, slots, s);
+  return 1;
+}
+
+static void OnCompletion(CorpusReader* self, Slot* slots, int s, int result) {
+  static const char kEmptyPath[] = "";
+  Slot* slot = &slots[s];
+  struct io_uring_sqe* sqe;
+  int error;
+
+  switch (slot->state) {
+    case kSlotOpening:
+      if (result < 0) {
+        Complete(self, slot->node, -result);
+        slot->node = NULL;
+        slot->state = kSlotFree;
+        return;
+      }
+      slot->fd = result;
+      sqe = NextEntry(&self->ring, s, IORING_OP_STATX);
+      sqe->fd = slot->fd;
+      sqe->addr = (uint64_t) (uintptr_t) kEmptyPath;
+      sqe->len = STATX_SIZE;
+      sqe->off = (uint64_t) (uintptr_t) &slot->status;
+      sqe->statx_flags = AT_EMPTY_PATH;
+      slot->state = kSlotStating;
+      return;
+    case kSlotStating:
+      error = result < 0 ? -result :
+          SetSize(self, slot->node, slot->status.stx_size, &slot->ticket);
+      if (error != 0) {
+        Finish(self, slots, s, error);
+        return;
+      }
+      StartReading(self, slots, s);
+      return;
+    case kSlotReading:
+      if (result < 0) {
+        Finish(self, slots, s, -result);
+        return;
+      }
+      slot->read_size = NextRead(slot->node, slot->read_size,
+                                 (size_t) result);
+      if (slot->read_size == 0) {
+        Finish(self, slots, s, 0);
+        return;
+      }
+      SubmitRead(&self->ring, slots, s);
+      return;
+    case kSlotClosing:
+      slot->state = kSlotFree;
+      return;
+  }
+}
+
+// After the ring broke, completes the files of all slots with |error|. The
+// kernel may still write into the buffers being read and into |slots|, so
+// those are left to it.
+static void AbandonSlots(CorpusReader* self, Slot* slots, int num_slots,
+                         int error) {
+  int s;
+
+  pthread_mutex_lock(&self->mutex);
+  Fail(self);
+  pthread_mutex_unlock(&self->mutex);
+  for (s = 0; s < num_slots; s++) {
+    if (slots[s].node == NULL) {
+      continue;  // Free or closing.
+    }
+    if (slots[s].state == kSlotReading) {
+      slots[s].node->buffer = NULL;
+    } else if (slots[s].state == kSlotWaitingForMemory) {
+      slots[s].node->capacity = 0;  // Not reserved.
+    }
+    Complete(self, slots[s].node, error);
+    slots[s].node = NULL;
+  }
+}
+
+static void* RunRing(void* argument) {
+  CorpusReader* self = (CorpusReader*) argument;
+  Ring* ring = &self->ring;
+  const int num_slots = self->config.queue_depth;
+  Slot* slots = (Slot*) calloc(num_slots, sizeof(Slot));
+  int in_flight = 0;
+  int s;
+
+  if (slots == NULL) {
+    pthread_mutex_lock(&self->mutex);
+    Fail(self);
+    pthread_mutex_unlock(&self->mutex);
+    return NULL;
+  }
+  for (;;) {
+    int waiting = 0;
+    int stopping;
+    uint32_t head, tail;
+
+    // Start the reads waiting for memory, and fill the free slots. Once
+    // stopped, the files in flight are cut short, but the requests of the
+    // kernel into their buffers must still complete.
+    pthread_mutex_lock(&self->mutex);
+    stopping = self->stopping;
+    pthread_mutex_unlock(&self->mutex);
+    for (s = 0; s < num_slots; s++) {
+      if (slots[s].state == kSlotWaitingForMemory) {
+        if (stopping) {
+          slots[s].node->capacity = 0;
+          Finish(self, slots, s, ECANCELED);
+          in_flight++;
+        } else if (StartReading(self, slots, s)) {
+          in_flight++;
+        } else {
+          waiting++;
+        }
+      }
+    }
+    pthread_mutex_lock(&self->mutex);
+    for (s = 0; s < num_slots && !self->stopping; s++) {
+      if (slots[s].state == kSlotFree) {
+        FileNode* node = StartFile(self);
+        struct io_uring_sqe* sqe;
+
+        if (node == NULL) {
+          break;
+        }
+        slots[s].node = node;
+        slots[s].state = kSlotOpening;
+        sqe = NextEntry(ring, s, IORING_OP_OPENAT);
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uint64_t) (uintptr_t) node->file.path;
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        in_flight++;
+      }
+    }
+    if (in_flight == 0) {
+      // Nothing to wait for but memory, or done.
+      if (self->stopping || (waiting == 0 &&
+                             (self->next_path == self->num_paths ||
+                              self->failed))) {
+        pthread_mutex_unlock(&self->mutex);
+        break;
+      }
+      pthread_cond_wait(&self->released, &self->mutex);
+      pthread_mutex_unlock(&self->mutex);
+      continue;
+    }
+    pthread_mutex_unlock(&self->mutex);
+
+    if (Enter(ring, 1) != 0) {
+      AbandonSlots(self, slots, num_slots, errno);
+      return NULL;
+    }
+    head = *ring->cq_head;
+    tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+      const struct io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+      const int slot = (int) cqe->user_data;
+      const int result = cqe->res;
+
+      // A slot's next request is submitted right away, so one fewer is in
+      // flight only when a close or a failed open completes, or the file
+      // waits for memory.
+      OnCompletion(self, slots, slot, result);
+      if (slots[slot].state == kSlotFree ||
+          slots[slot].state == kSlotWaitingForMemory) {
+        in_flight--;
+      }
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+  }
+  free(slots);
+  return NULL;
+}
+
+CorpusReader* CorpusReader_Create(const char* const* paths, size_t num_paths,
+                                  const CorpusReaderConfig* config) {
+  CorpusReader* self;
+  int t;
+
+  self = (CorpusReader*) calloc(1, sizeof(CorpusReader));
+  if (self == NULL) {
+    return NULL;
+  }
+  if (config != NULL) {
+    self->config = *config;
+  } else {
+    CorpusReader_DefaultConfig(&self->config);
+  }
+  if (self->config.queue_depth < 1 || self->config.queue_depth > 4096 ||
+      self->config.first_read < 64 || self->config.first_read > (1 << 30) ||
+      self->config.max_file_size < self->config.first_read ||
+      self->config.num_threads < 1) {
+    free(self);
+    return NULL;
+  }
+  self->paths = paths;
+  self->num_paths = num_paths;
+  pthread_mutex_init(&self->mutex, NULL);
+  pthread_cond_init(&self->ready, NULL);
+  pthread_cond_init(&self->released, NULL);
+
+  self->use_io_uring = self->config.use_io_uring &&
+      SetUpRing(&self->ring, (uint32_t) self->config.queue_depth) == 0;
+  if (!self->use_io_uring) {
+    TearDownRing(&self->ring);
+    memset(&self->ring, 0, sizeof(self->ring));
+  }
+  self->num_threads = self->use_io_uring ? 1 : self->config.num_threads;
+  self->threads = (pthread_t*) calloc(self->num_threads, sizeof(pthread_t));
+  if (self->threads == NULL) {
+    CorpusReader_Free(self);
+    return NULL;
+  }
+  for (t = 0; t < self->num_threads; t++) {
+    if (pthread_create(&self->threads[t], NULL,
+                       self->use_io_uring ? RunRing : RunReadThread,
+                       self) != 0) {
+      self->num_threads = t;
+      CorpusReader_Free(self);
+      return NULL;
+    }
+  }
+  return self;
+}
+
+CorpusFile* CorpusReader_Next(CorpusReader* self) {
+  FileNode* node;
+
+  pthread_mutex_lock(&self->mutex);
+  while (self->ready_head == NULL && !AllCompleted(self) && !self->stopping) {
+    pthread_cond_wait(&self->ready, &self->mutex);
+  }
+  node = self->ready_head;
+  if (node != NULL) {
+    self->ready_head = node->next;
+    if (self->ready_head == NULL) {
+      self->ready_tail = NULL;
+    }
+    self->num_taken++;
+  }
+  pthread_mutex_unlock(&self->mutex);
+  return node != NULL ? &node->file : NULL;
+}
+
+void CorpusReader_Release(CorpusReader* self, CorpusFile* file) {
+  FileNode* node = (FileNode*) file;
+
+  if (node == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&self->mutex);
+  self->memory_used -= node->capacity;
+  pthread_cond_broadcast(&self->released);
+  pthread_mutex_unlock(&self->mutex);
+  free(node->buffer);
+  free(node);
+}
+
+int CorpusReader_UsesIoUring(const CorpusReader* self) {
+  return self->use_io_uring;
+}
+
+void CorpusReader_Free(CorpusReader* self) {
+  int t;
+
+  if (self == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&self->mutex);
+  self->stopping = 1;
+  pthread_cond_broadcast(&self->released);
+  pthread_cond_broadcast(&self->ready);
+  pthread_mutex_unlock(&self->mutex);
+  for (t = 0; t < self->num_threads; t++) {
+    pthread_join(self->threads[t], NULL);
+  }
+  while (self->ready_head != NULL) {
+    FileNode* node = self->ready_head;
+
+    self->ready_head = node->next;
+    free(node->buffer);
+    free(node);
+  }
+  if (self->use_io_uring) {
+    TearDownRing(&self->ring);
+  }
+  free(self->threads);
+  pthread_mutex_destroy(&self->mutex);
+  pthread_cond_destroy(&self->ready);
+  pthread_cond_destroy(&self->released);
+  free(self);
+}
@@ -0,0 +1,72 @@
+#ifndef CORPUS_READER_H_
+#define CORPUS_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Reads many small files into memory ahead of the threads that process them,
+// for batch jobs where opening and reading, not compute, dominate the cost
+// per file. With io_uring one thread keeps up to |queue_depth| files in
+// flight, each opened, read and closed by requests submitted in batches. On
+// kernels without io_uring (or when it is disabled) |num_threads| threads
+// do the same with open(), pread() and close().
+//
+// Every file is opened and its size taken (statx, or fstat() by the
+// threads), then read up to |first_read| bytes. If that is not all of it, the
+// WAVE header in it tells where the data chunk ends (see
+// WavReader_ExpectedSize()), and the rest up to there is read with one more
+// request. The header is never trusted beyond the size of the file.
+//
+// A file counts against |memory_limit| with its whole size from the moment
+// that is known until it is released. Files wait for memory, opened, in the
+// order their sizes became known, and the sum never exceeds the limit,
+// except for a single file larger than it, which is loaded alone.
+typedef struct CorpusReader CorpusReader;
+
+typedef struct {
+  int queue_depth;        // Files in flight.
+  size_t first_read;      // Bytes of the first read of every file.
+  size_t memory_limit;    // Bytes of loaded files held at once.
+  size_t max_file_size;   // Larger files fail with EFBIG.
+  int num_threads;        // Reading threads without io_uring.
+  int use_io_uring;       // 0 - (threads only), 1 - (io_uring if available)
+} CorpusReaderConfig;
+
+typedef struct {
+  size_t index;           // Of the path in the list.
+  const char* path;
+  // The whole file, NULL on error.
+  const uint8_t* data;
+  size_t size;
+  int error;              // errno of a failed open() or read, or 0.
+} CorpusFile;
+
+// Sets |config| to 256 files in flight, 64 KiB first reads, 256 MiB of
+// memory, files up to 1 GiB, 16 threads and io_uring.
+void CorpusReader_DefaultConfig(CorpusReaderConfig* config);
+
+// Starts reading |paths| in order. The paths are not copied.
+//
+// returns : The reader, or NULL (invalid settings, out of memory)
+CorpusReader* CorpusReader_Create(const char* const* paths, size_t num_paths,
+                                  const CorpusReaderConfig* config);
+
+// Takes the next loaded file, in no particular order, waiting for one if
+// needed. Thread safe.
+//
+// returns : A file to give back with CorpusReader_Release(), or NULL when all
+//           files have been taken. If the reader failed (out of memory, or
+//           io_uring broke), that is before every file of |paths| was seen.
+CorpusFile* CorpusReader_Next(CorpusReader* self);
+
+// Frees a file taken with CorpusReader_Next(). Thread safe.
+void CorpusReader_Release(CorpusReader* self, CorpusFile* file);
+
+// Returns 1 if the files are read with io_uring, 0 if with threads.
+int CorpusReader_UsesIoUring(const CorpusReader* self);
+
+// Stops reading and frees the reader. Files still taken must be released
+// first.
+void CorpusReader_Free(CorpusReader* self);
+
+#endif  // CORPUS_READER_H_
@@ -0,0 +1,590 @@
+// Replays a recording as many G.711 RTP streams to vad_rtpd and checks its
+// events.
+//
+// Usage: rtp_replay [-a addr] [-p port] [-n streams] [-t seconds]
+//                   [-f packet_ms] [-l loss_%] [-r reorder_%] [-m mode] [-A]
+//                   [-u events.sock] [-s seed] [-S sockets] file.wav
+//
+// The file (8 or 16 kHz, the first channel) is brought to 8 kHz and encoded
+// as mu-law, or A-law with -A. Every stream plays it from its own offset,
+// one packet per stream every |packet_ms|, sent with sendmmsg() from one of
+// |sockets| source ports so that vad_rtpd can spread them over its workers.
+// Packets are dropped and swapped
+// with their successor at random, except for the first packet of a stream.
+//
+// With -u the events of vad_rtpd are compared with a local VAD that gets
+// the same packets in sequence order and skips the lost ones, as vad_rtpd
+// does. |mode| must match the daemon, and its jitter buffer must hold a
+// swapped packet; the exit status is 1 on any difference.
+
+// recvmmsg(), sendmmsg() and accept4().
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vad.h"
+#include "wav_reader.h"
+
+enum { kRtpHeaderSize = 12 };
+enum { kMaxPayload = 480 };
+enum { kBatch = 64 };
+// Time given to the daemon for the last packets and events.
+enum { kDrainMs = 500 };
+
+typedef struct {
+  uint32_t ssrc;
+  uint8_t type;
+  uint32_t media_ms;
+} Event;
+
+typedef struct {
+  Event* events;
+  size_t size;
+  size_t capacity;
+} EventList;
+
+typedef struct {
+  uint32_t ssrc;
+  uint16_t seq;
+  uint32_t timestamp;
+  size_t position;
+  // A packet sent after the next one.
+  int held_length;
+  uint8_t held[kRtpHeaderSize + kMaxPayload];
+  // Reference.
+  VadInst* vad;
+  int speech;
+  uint32_t frames;
+  int lost;
+} Stream;
+
+// Packets queued for one sendmmsg().
+typedef struct {
+  int socket;
+  uint8_t packets[kBatch][kRtpHeaderSize + kMaxPayload];
+  struct mmsghdr messages[kBatch];
+  struct iovec iovecs[kBatch];
+  int num_messages;
+  uint64_t sent;
+} Sender;
+
+typedef struct {
+  int socket;
+  char buffer[4096];
+  size_t length;
+  // Events of other runs, such as the stops of their idle streams, are
+  // ignored.
+  uint32_t ssrc_base;
+  uint32_t num_ssrcs;
+  EventList events;
+} EventReader;
+
+static uint64_t NowNs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void AddEvent(EventList* list, uint32_t ssrc, int type,
+                     uint32_t media_ms) {
+  if (list->size == list->capacity) {
+    list->capacity = list->capacity ? 2 * list->capacity : 1024;
+    list->events = (Event*) realloc(list->events,
+                                    list->capacity * sizeof(Event));
+    if (list->events == NULL) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+  }
+  list->events[list->size].ssrc = ssrc;
+  list->events[list->size].type = (uint8_t) type;
+  list->events[list->size].media_ms = media_ms;
+  list->size++;
+}
+
+static int CompareEvents(const void* a, const void* b) {
+  const Event* x = (const Event*) a;
+  const Event* y = (const Event*) b;
+
+  if (x->ssrc != y->ssrc) {
+    return x->ssrc < y->ssrc ? -1 : 1;
+  }
+  if (x->media_ms != y->media_ms) {
+    return x->media_ms < y->media_ms ? -1 : 1;
+  }
+  return x->type - y->type;
+}
+
+// G.711 mu-law code of |sample|, as the G.711 reference encoder.
+static uint8_t LinearToMuLaw(int sample) {
+  const int mask = sample < 0 ? 0x7F : 0xFF;
+  int magnitude = (sample < 0 ? -sample : sample) + 0x84;
+  int segment = 0;
+
+  if (magnitude > 0x7FFF) {
+    magnitude = 0x7FFF;
+  }
+  while (segment < 7 && magnitude >= (0x100 << segment)) {
+    segment++;
+  }
+  return (uint8_t) (((segment << 4) |
+                     ((magnitude >> (segment + 3)) & 0x0F)) ^ mask);
+}
+
+// G.711 A-law code of |sample|, as the G.711 reference encoder.
+static uint8_t LinearToALaw(int sample) {
+  const int mask = sample >= 0 ? 0xD5 : 0x55;
+  const int magnitude = sample >= 0 ? sample >> 3 : -(sample >> 3) - 1;
+  int segment = 0;
+
+  while (segment < 7 && magnitude >= (0x20 << segment)) {
+    segment++;
+  }
+  return (uint8_t) (((segment << 4) |
+                     ((magnitude >> (segment < 2 ? 1 : segment)) & 0x0F)) ^
+                    mask);
+}
+
+static int Flush(Sender* sender) {
+  int done = 0;
+
+  while (done < sender->num_messages) {
+    const int n = sendmmsg(sender->socket, sender->messages + done,
+                           sender->num_messages - done, 0);
+
+    if (n < 0 && errno != EINTR && errno != ENOBUFS) {
+      perror("sendmmsg");
+      return -1;
+    }
+    done += n > 0 ? n : 0;
+  }
+  sender->sent += sender->num_messages;
+  sender->num_messages = 0;
+  return 0;
+}
+
+static int FlushAll(Sender* senders, int num_senders) {
+  int s;
+
+  for (s = 0; s < num_senders; s++) {
+    if (Flush(&senders[s]) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int Queue(Sender* sender, const uint8_t* packet, int size) {
+  const int i = sender->num_messages++;
+
+  memcpy(sender->packets[i], packet, size);
+  sender->iovecs[i].iov_base = sender->packets[i];
+  sender->iovecs[i].iov_len = size;
+  memset(&sender->messages[i].msg_hdr, 0, sizeof(struct msghdr));
+  sender->messages[i].msg_hdr.msg_iov = &sender->iovecs[i];
+  sender->messages[i].msg_hdr.msg_iovlen = 1;
+  return sender->num_messages == kBatch ? Flush(sender) : 0;
+}
+
+// Reads the complete event lines sent so far.
+static void ReadEvents(EventReader* reader) {
+  for (;;) {
+    char* line = reader->buffer;
+    char* end;
+    ssize_t received;
+
+    received = recv(reader->socket, reader->buffer + reader->length,
+                    sizeof(reader->buffer) - reader->length - 1,
+                    MSG_DONTWAIT);
+    if (received <= 0) {
+      return;
+    }
+    reader->length += received;
+    reader->buffer[reader->length] = '\0';
+    while ((end = strchr(line, '\n')) != NULL) {
+      char type[8];
+      unsigned ssrc, media_ms;
+
+      *end = '\0';
+      if (sscanf(line, "%7s %x %u", type, &ssrc, &media_ms) == 3 &&
+          ssrc - reader->ssrc_base < reader->num_ssrcs) {
+        AddEvent(&reader->events, ssrc, strcmp(type, "start") == 0,
+                 media_ms);
+      }
+      line = end + 1;
+    }
+    reader->length -= line - reader->buffer;
+    memmove(reader->buffer, line, reader->length);
+  }
+}
+
+// Frames of the local VAD, as vad_rtpd plays out |payload|, or skips it if
+// NULL.
+static void Reference(Stream* stream, int format, const uint8_t* payload,
+                      int length, int frame_length, EventList* events) {
+  int offset, vad;
+
+  if (payload == NULL) {
+    stream->lost++;
+    stream->frames += length / frame_length;
+    return;
+  }
+  // Lost packets are skipped once the next one is played out, frame by
+  // frame while in speech.
+  if (stream->lost > 0) {
+    uint32_t frame = stream->frames - stream->lost * (length / frame_length);
+    int skip = stream->lost * (length / frame_length);
+
+    while (skip > 0 && stream->speech) {
+      if (WebRtcVad_ProcessNonSpeech(stream->vad, 8000, frame_length, 1,
+                                     NULL) == 0) {
+        stream->speech = 0;
+        AddEvent(events, stream->ssrc, 0, frame * frame_length / 8);
+      }
+      frame++;
+      skip--;
+    }
+    if (skip > 0) {
+      WebRtcVad_ProcessNonSpeech(stream->vad, 8000, frame_length, skip, NULL);
+    }
+    stream->lost = 0;
+  }
+  for (offset = 0; offset < length; offset += frame_length) {
+    vad = WebRtcVad_ProcessFormat(stream->vad, 8000, format, &payload[offset],
+                                  frame_length);
+    if (vad >= 0 && vad != stream->speech) {
+      stream->speech = vad;
+      AddEvent(events, stream->ssrc, vad, stream->frames * frame_length / 8);
+    }
+    stream->frames++;
+  }
+}
+
+static void Usage(void) {
+  fprintf(stderr, "usage: rtp_replay [-a addr] [-p port] [-n streams] "
+          "[-t seconds] [-f packet_ms] [-l loss_%%] [-r reorder_%%] "
+          "[-m mode] [-A] [-u events.sock] [-s seed] [-S sockets] "
+          "file.wav\n");
+}
+
+int main(int argc, char* argv[]) {
+  const char* address = "127.0.0.1";
+  int port = 5004;
+  int num_streams = 100;
+  double seconds = 10;
+  int packet_ms = 20;
+  double loss = 0;
+  double reorder = 0;
+  int mode = 2;
+  int alaw = 0;
+  const char* events_path = NULL;
+  unsigned seed = (unsigned) time(NULL);
+  WavReader wav;
+  int16_t* audio;
+  int16_t* wideband = NULL;
+  uint8_t* encoded;
+  size_t num_samples, i;
+  int rate, format, payload_length, frame_length;
+  Stream* streams;
+  EventList expected = { NULL, 0, 0 };
+  EventReader reader;
+  struct sockaddr_in destination;
+  int num_senders = 16;
+  Sender* senders;
+  uint64_t start_ns, tick_ns, num_ticks, tick;
+  uint64_t sent = 0, dropped = 0, swapped = 0, behind = 0;
+  uint32_t ssrc_base;
+  int opt, s;
+
+  while ((opt = getopt(argc, argv, "a:p:n:t:f:l:r:m:Au:s:S:")) != -1) {
+    if (opt == 'a') {
+      address = optarg;
+    } else if (opt == 'p') {
+      port = atoi(optarg);
+    } else if (opt == 'n') {
+      num_streams = atoi(optarg);
+    } else if (opt == 't') {
+      seconds = atof(optarg);
+    } else if (opt == 'f') {
+      packet_ms = atoi(optarg);
+    } else if (opt == 'l') {
+      loss = atof(optarg);
+    } else if (opt == 'r') {
+      reorder = atof(optarg);
+    } else if (opt == 'm') {
+      mode = atoi(optarg);
+    } else if (opt == 'A') {
+      alaw = 1;
+    } else if (opt == 'u') {
+      events_path = optarg;
+    } else if (opt == 's') {
+      seed = (unsigned) strtoul(optarg, NULL, 0);
+    } else if (opt == 'S') {
+      num_senders = atoi(optarg);
+    } else {
+      Usage();
+      return 1;
+    }
+  }
+  if (optind != argc - 1 || num_streams < 1 || num_senders < 1 ||
+      packet_ms < 10 ||
+      packet_ms > 60 || packet_ms % 10 != 0) {
+    Usage();
+    return 1;
+  }
+  format = alaw ? kVadFormatALaw : kVadFormatMuLaw;
+  payload_length = 8 * packet_ms;
+  // As vad_rtpd splits the payload.
+  frame_length = payload_length % 240 == 0 ? 240 :
+      payload_length % 160 == 0 ? 160 : 80;
+
+  if (WavReader_Open(&wav, argv[optind]) != 0) {
+    fprintf(stderr, "%s: %s\n", argv[optind], wav.error);
+    return 1;
+  }
+  rate = WavReader_VadRate(&wav);
+  if (rate != 8000 && rate != 16000) {
+    fprintf(stderr, "%d Hz is not supported, only 8 or 16 kHz\n",
+            wav.sample_rate);
+    return 1;
+  }
+  num_samples = wav.num_samples;
+  audio = WavReader_CopyChannel(&wav, 0);
+  if (audio == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  if (rate == 16000) {
+    int32_t state[2] = { 0, 0 };
+
+    wideband = audio;
+    num_samples /= 2;
+    audio = (int16_t*) malloc(num_samples * sizeof(int16_t));
+    if (audio == NULL) {
+      fprintf(stderr, "out of memory\n");
+      return 1;
+    }
+    WebRtcVad_Downsampling(wideband, 1, audio, state, (int) num_samples * 2);
+    free(wideband);
+  }
+  WavReader_Close(&wav);
+  if (num_samples < (size_t) payload_length) {
+    fprintf(stderr, "%s: too short\n", argv[optind]);
+    return 1;
+  }
+  encoded = (uint8_t*) malloc(num_samples);
+  for (i = 0; i < num_samples; i++) {
+    encoded[i] = alaw ? LinearToALaw(audio[i]) : LinearToMuLaw(audio[i]);
+  }
+  free(audio);
+  num_samples -= num_samples % payload_length;
+
+  srand(seed);
+  ssrc_base = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+  streams = (Stream*) calloc(num_streams, sizeof(Stream));
+  for (s = 0; s < num_streams; s++) {
+    streams[s].ssrc = ssrc_base + s;
+    streams[s].seq = (uint16_t) rand();
+    streams[s].timestamp = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+    streams[s].position = (size_t) s * 7919 * payload_length % num_samples;
+    if (events_path != NULL &&
+        (WebRtcVad_Create(&streams[s].vad) != 0 ||
+         WebRtcVad_Init(streams[s].vad) != 0 ||
+         WebRtcVad_set_mode(streams[s].vad, mode) != 0)) {
+      fprintf(stderr, "cannot set up the VAD\n");
+      return 1;
+    }
+  }
+
+  memset(&reader, 0, sizeof(reader));
+  reader.socket = -1;
+  reader.ssrc_base = ssrc_base;
+  reader.num_ssrcs = (uint32_t) num_streams;
+  if (events_path != NULL) {
+    struct sockaddr_un unix_address;
+
+    memset(&unix_address, 0, sizeof(unix_address));
+    unix_address.sun_family = AF_UNIX;
+    strncpy(unix_address.sun_path, events_path,
+            sizeof(unix_address.sun_path) - 1);
+    reader.socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(reader.socket, (struct sockaddr*) &unix_address,
+                sizeof(unix_address)) != 0) {
+      perror(events_path);
+      return 1;
+    }
+  }
+
+  memset(&destination, 0, sizeof(destination));
+  destination.sin_family = AF_INET;
+  destination.sin_port = htons((uint16_t) port);
+  if (inet_pton(AF_INET, address, &destination.sin_addr) != 1) {
+    fprintf(stderr, "invalid address: %s\n", address);
+    return 1;
+  }
+  senders = (Sender*) calloc(num_senders, sizeof(Sender));
+  if (senders == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  for (s = 0; s < num_senders; s++) {
+    senders[s].socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (connect(senders[s].socket, (struct sockaddr*) &destination,
+                sizeof(destination)) != 0) {
+      perror("udp");
+      return 1;
+    }
+  }
+
+  printf("%d streams of %d ms packets, %.0f pps for %.1f s, %.1f%% loss, "
+         "%.1f%% reorder, seed %u\n", num_streams, packet_ms,
+         num_streams * 1000.0 / packet_ms, seconds, loss, reorder, seed);
+  tick_ns = (uint64_t) packet_ms * 1000000;
+  num_ticks = (uint64_t) (seconds * 1000 / packet_ms);
+  start_ns = NowNs();
+  for (tick = 0; tick < num_ticks; tick++) {
+    const uint64_t due_ns = start_ns + tick * tick_ns;
+    struct timespec due;
+
+    if (NowNs() > due_ns + tick_ns) {
+      behind++;
+    }
+    due.tv_sec = due_ns / 1000000000;
+    due.tv_nsec = due_ns % 1000000000;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+
+    for (s = 0; s < num_streams; s++) {
+      Stream* stream = &streams[s];
+      Sender* sender = &senders[s % num_senders];
+      uint8_t packet[kRtpHeaderSize + kMaxPayload];
+      const int size = kRtpHeaderSize + payload_length;
+      const int lose = tick > 0 && rand() < loss / 100 * RAND_MAX;
+      const int swap = !lose && tick > 0 && stream->held_length == 0 &&
+          rand() < reorder / 100 * RAND_MAX;
+
+      packet[0] = 0x80;
+      packet[1] = alaw ? 8 : 0;
+      packet[2] = (uint8_t) (stream->seq >> 8);
+      packet[3] = (uint8_t) stream->seq;
+      packet[4] = (uint8_t) (stream->timestamp >> 24);
+      packet[5] = (uint8_t) (stream->timestamp >> 16);
+      packet[6] = (uint8_t) (stream->timestamp >> 8);
+      packet[7] = (uint8_t) stream->timestamp;
+      packet[8] = (uint8_t) (stream->ssrc >> 24);
+      packet[9] = (uint8_t) (stream->ssrc >> 16);
+      packet[10] = (uint8_t) (stream->ssrc >> 8);
+      packet[11] = (uint8_t) stream->ssrc;
+      memcpy(&packet[kRtpHeaderSize], &encoded[stream->position],
+             payload_length);
+      if (stream->vad != NULL) {
+        Reference(stream, format, lose ? NULL : &encoded[stream->position],
+                  payload_length, frame_length, &expected);
+      }
+      stream->seq++;
+      stream->timestamp += payload_length;
+      stream->position += payload_length;
+      if (stream->position == num_samples) {
+        stream->position = 0;
+      }
+
+      if (lose) {
+        dropped++;
+      } else if (swap) {
+        memcpy(stream->held, packet, size);
+        stream->held_length = size;
+        swapped++;
+        continue;
+      } else if (Queue(sender, packet, size) != 0) {
+        return 1;
+      }
+      if (stream->held_length > 0) {
+        if (Queue(sender, stream->held, stream->held_length) != 0) {
+          return 1;
+        }
+        stream->held_length = 0;
+      }
+    }
+    if (FlushAll(senders, num_senders) != 0) {
+      return 1;
+    }
+    if (reader.socket >= 0) {
+      ReadEvents(&reader);
+    }
+  }
+  for (s = 0; s < num_streams; s++) {
+    if (streams[s].held_length > 0 &&
+        Queue(&senders[s % num_senders], streams[s].held,
+              streams[s].held_length) != 0) {
+      return 1;
+    }
+  }
+  if (FlushAll(senders, num_senders) != 0) {
+    return 1;
+  }
+  for (s = 0; s < num_senders; s++) {
+    sent += senders[s].sent;
+  }
+  printf("sent %llu packets in %.2f s, %llu dropped, %llu swapped, "
+         "%llu ticks behind\n", (unsigned long long) sent,
+         (NowNs() - start_ns) / 1e9, (unsigned long long) dropped,
+         (unsigned long long) swapped, (unsigned long long) behind);
+
+  if (reader.socket >= 0) {
+    const uint64_t drain_ns = NowNs() + (uint64_t) kDrainMs * 1000000;
+    size_t mismatches = 0, shown = 0;
+    size_t a = 0, b = 0;
+
+    while (NowNs() < drain_ns) {
+      usleep(10000);
+      ReadEvents(&reader);
+    }
+    qsort(expected.events, expected.size, sizeof(Event), CompareEvents);
+    qsort(reader.events.events, reader.events.size, sizeof(Event),
+          CompareEvents);
+    // Merge of the two sorted lists.
+    while (a < expected.size || b < reader.events.size) {
+      int order;
+
+      if (a == expected.size) {
+        order = 1;
+      } else if (b == reader.events.size) {
+        order = -1;
+      } else {
+        order = CompareEvents(&expected.events[a], &reader.events.events[b]);
+      }
+      if (order == 0) {
+        a++;
+        b++;
+        continue;
+      }
+      mismatches++;
+      if (shown++ < 10) {
+        const Event* e = order < 0 ? &expected.events[a] :
+            &reader.events.events[b];
+        printf("%s: %s %08x %u\n", order < 0 ? "missing" : "unexpected",
+               e->type ? "start" : "stop", e->ssrc, e->media_ms);
+      }
+      if (order < 0) {
+        a++;
+      } else {
+        b++;
+      }
+    }
+    printf("%zu events expected, %zu received, %zu mismatches\n",
+           expected.size, reader.events.size, mismatches);
+    if (mismatches > 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -10,69 +10,1150 @@
 
 #include "vad.h"
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#if defined(WEBRTC_VAD_TRACE)
+#include <stdio.h>
+#endif
+
+#if defined(WEBRTC_VAD_STATS) && defined(WEBRTC_ARCH_X86_FAMILY)
+#include <x86intrin.h>
+#endif
+
+// Static probes of provider "webrtc_vad" for perf and bpftrace, e.g.
+//   bpftrace -e 'usdt:./vad_test:webrtc_vad:decision_change { ... }'
+// Compiled in with -DWEBRTC_VAD_USDT where <sys/sdt.h> is available. Each
+// probe is a single nop until a tracer attaches; without the header they
+// compile to nothing.
+#if defined(WEBRTC_VAD_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define WEBRTC_VAD_HAVE_SDT
+#endif
+#endif
+
+#if defined(WEBRTC_VAD_HAVE_SDT)
+#define VAD_PROBE2(name, a, b) DTRACE_PROBE2(webrtc_vad, name, a, b)
+#define VAD_PROBE3(name, a, b, c) DTRACE_PROBE3(webrtc_vad, name, a, b, c)
+#else
+#define VAD_PROBE2(name, a, b) \
+  do { \
+    (void) (a); \
+    (void) (b); \
+  } while (0)
+#define VAD_PROBE3(name, a, b, c) \
+  do { \
+    (void) (a); \
+    (void) (b); \
+    (void) (c); \
+  } while (0)
+#endif
 
 static const int kInitCheck = 42;
 static const int kValidRates[] = { 8000, 16000, 32000, 48000 };
 static const size_t kRatesSize = sizeof(kValidRates) / sizeof(*kValidRates);
 static const int kMaxFrameLengthMs = 30;
+// Instances are cache line aligned, see the layout notes on VadInstT.
+static const size_t kInstanceAlignment = 64;
+
+// Statistics, see WebRtcVad_get_stats(). Every count goes to the instance
+// and to the calling thread.
+#if defined(WEBRTC_VAD_STATS)
+#if defined(_MSC_VER)
+static __declspec(thread) VadStats thread_stats;
+#else
+static __thread VadStats thread_stats;
+#endif
+
+static uint64_t StatsTicks(void) {
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+  return __rdtsc();
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+#define VAD_STATS_ADD(self, field, n) \
+  do { \
+    (self)->stats.field += (n); \
+    thread_stats.field += (n); \
+  } while (0)
+#else
+#define VAD_STATS_ADD(self, field, n)
+#endif
+
+static uint64_t MonotonicNs(void) {
+  struct timespec ts;
+
+#if defined(WEBRTC_POSIX)
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+  timespec_get(&ts, TIME_UTC);
+#endif
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Timeline trace, see WebRtcVad_TraceStart(). Spans are appended lock-free;
+// threads get their trace id on their first span or name of each trace.
+#if defined(WEBRTC_VAD_TRACE)
+enum { kTraceMaxThreads = 1024 };
+enum { kTraceThreadNameLength = 32 };
+
+typedef struct {
+  const char* name;
+  const char* category;
+  uint64_t start_ns;
+  uint64_t duration_ns;
+  uint32_t thread;
+} TraceEvent;
+
+static TraceEvent* trace_events = NULL;
+static size_t trace_capacity = 0;
+static size_t trace_size = 0;
+static uint64_t trace_origin_ns = 0;
+static uint32_t trace_num_threads = 0;
+// Counts the traces, so that ids from an earlier one are not reused.
+static uint32_t trace_generation = 0;
+static char trace_thread_names[kTraceMaxThreads][kTraceThreadNameLength];
+#if defined(_MSC_VER)
+static __declspec(thread) uint32_t trace_thread;
+static __declspec(thread) uint32_t trace_thread_generation;
+#else
+static __thread uint32_t trace_thread;
+static __thread uint32_t trace_thread_generation;
+#endif
+
+// Returns the trace id of the calling thread in the running trace, starting
+// at 1.
+static uint32_t TraceThread(void) {
+  if (trace_thread == 0 || trace_thread_generation != trace_generation) {
+    trace_thread = __atomic_add_fetch(&trace_num_threads, 1,
+                                      __ATOMIC_RELAXED);
+    trace_thread_generation = trace_generation;
+  }
+  return trace_thread;
+}
+
+static const char* const kStageNames[kVadNumStages] = {
+  "resample", "features", "gmm", "update"
+};
+
+#define TRACE_RUNNING() (trace_events != NULL)
+#else
+#define TRACE_RUNNING() 0
+#endif
+
+// Per-stage timing, for the statistics and the trace.
+#if defined(WEBRTC_VAD_STATS) || defined(WEBRTC_VAD_TRACE)
+typedef struct {
+#if defined(WEBRTC_VAD_STATS)
+  uint64_t ticks;
+#endif
+#if defined(WEBRTC_VAD_TRACE)
+  uint64_t ns;
+#endif
+} StageTimer;
+
+static void StartStage(StageTimer* timer) {
+#if defined(WEBRTC_VAD_STATS)
+  timer->ticks = StatsTicks();
+#endif
+#if defined(WEBRTC_VAD_TRACE)
+  timer->ns = TRACE_RUNNING() ? MonotonicNs() : 0;
+#endif
+}
+
+static void StopStage(VadInstT* self, int stage, const StageTimer* timer) {
+#if defined(WEBRTC_VAD_STATS)
+  VAD_STATS_ADD(self, ticks[stage], StatsTicks() - timer->ticks);
+#else
+  (void) self;
+#endif
+#if defined(WEBRTC_VAD_TRACE)
+  if (TRACE_RUNNING()) {
+    WebRtcVad_TraceSpan(kStageNames[stage], "vad", timer->ns, MonotonicNs());
+  }
+#endif
+}
+
+#define VAD_STAGE_TIMER(timer) StageTimer timer
+#define VAD_STAGE_START(timer) StartStage(&(timer))
+#define VAD_STAGE_STOP(self, stage, timer) StopStage(self, stage, &(timer))
+#else
+#define VAD_STAGE_TIMER(timer)
+#define VAD_STAGE_START(timer)
+#define VAD_STAGE_STOP(self, stage, timer)
+#endif
+
+int WebRtcVad_Create(VadInst** handle) {
+  VadInstT* self = NULL;
+
+  if (handle == NULL) {
+    return -1;
+  }
+
+  *handle = NULL;
+#if defined(WEBRTC_POSIX)
+  if (posix_memalign((void**) &self, kInstanceAlignment,
+                     sizeof(VadInstT)) != 0) {
+    self = NULL;
+  }
+#else
+  self = (VadInstT*) malloc(sizeof(VadInstT));
+#endif
+  *handle = (VadInst*) self;
+
+  if (self == NULL) {
+    return -1;
+  }
+
+  WebRtcSpl_Init();
+
+  self->init_flag = 0;
+  self->state_48_to_8 = NULL;
+  self->float_state = NULL;
+  self->latency_stream = NULL;
+  self->latency_worker = NULL;
+
+  return 0;
+}
+
+int WebRtcVad_Free(VadInst* handle) {
+  VadInstT* self = (VadInstT*) handle;
+
+  if (handle == NULL) {
+    return -1;
+  }
+
+  free(self->state_48_to_8);
+  free(self->float_state);
+  free(handle);
+
+  return 0;
+}
+
+// TODO(bjornv): Move WebRtcVad_InitCore() code here.
+int WebRtcVad_Init(VadInst* handle) {
+  // Initialize the core VAD component.
+  return WebRtcVad_InitCore((VadInstT*) handle);
+}
+
+int WebRtcVad_Clone(VadInst* handle, const VadInst* prototype) {
+  VadInstT* self = (VadInstT*) handle;
+  const VadInstT* source = (const VadInstT*) prototype;
+  WebRtcSpl_State48khzTo8khz* state_48_to_8 = NULL;
+  VadFloatState* float_state = NULL;
+  VadLatencyHistogram* latency_stream;
+  VadLatencyHistogram* latency_worker;
+
+  if (handle == NULL || prototype == NULL) {
+    return -1;
+  }
+  if (source->init_flag != kInitCheck) {
+    return -1;
+  }
+  if (self == source) {
+    return 0;
+  }
+
+  // The 48 kHz resampler state is owned by each instance. Keep the one of
+  // |self|, and allocate it if |prototype| carries a state we have to copy.
+  state_48_to_8 = self->state_48_to_8;
+  if (state_48_to_8 == NULL && source->state_48_to_8 != NULL) {
+    state_48_to_8 = (WebRtcSpl_State48khzTo8khz*)
+        malloc(sizeof(WebRtcSpl_State48khzTo8khz));
+    if (state_48_to_8 == NULL) {
+      return -1;
+    }
+  }
+  // So is the float engine state.
+  float_state = self->float_state;
+  if (float_state == NULL && source->float_state != NULL) {
+    float_state = (VadFloatState*) malloc(sizeof(VadFloatState));
+    if (float_state == NULL) {
+      if (state_48_to_8 != self->state_48_to_8) {
+        free(state_48_to_8);
+      }
+      return -1;
+    }
+  }
+
+  // Attached histograms stay with |self| as well.
+  latency_stream = self->latency_stream;
+  latency_worker = self->latency_worker;
+
+  memcpy(self, source, sizeof(VadInstT));
+
+  self->latency_stream = latency_stream;
+  self->latency_worker = latency_worker;
+  // The counters are those of |self|, and start over as after Init().
+  self->model_updates = 0;
+  self->model_updates_skipped = 0;
+#if defined(WEBRTC_VAD_STATS)
+  memset(&self->stats, 0, sizeof(self->stats));
+#endif
+  self->state_48_to_8 = state_48_to_8;
+  if (state_48_to_8 != NULL) {
+    if (source->state_48_to_8 != NULL) {
+      memcpy(state_48_to_8, source->state_48_to_8,
+             sizeof(WebRtcSpl_State48khzTo8khz));
+    } else {
+      WebRtcSpl_ResetResample48khzTo8khz(state_48_to_8);
+    }
+  }
+  self->float_state = float_state;
+  if (float_state != NULL) {
+    if (source->float_state != NULL) {
+      memcpy(float_state, source->float_state, sizeof(VadFloatState));
+    } else {
+      memset(float_state, 0, sizeof(VadFloatState));
+    }
+  }
+
+  return 0;
+}
+
+int WebRtcVad_InitBatch(VadInst** handles, int num_handles,
+                        const VadInst* prototype) {
+  int i = 0;
+
+  if (handles == NULL || num_handles < 0) {
+    return -1;
+  }
+  if (num_handles == 0) {
+    return 0;
+  }
+
+  // Without a |prototype| the first instance is fully initialized and
+  // used as prototype for the rest.
+  if (prototype == NULL) {
+    if (WebRtcVad_Init(handles[0]) != 0) {
+      return -1;
+    }
+    prototype = handles[0];
+    i = 1;
+  }
+
+  for (; i < num_handles; i++) {
+    if (WebRtcVad_Clone(handles[i], prototype) != 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+// TODO(bjornv): Move WebRtcVad_set_mode_core() code here.
+int WebRtcVad_set_mode(VadInst* handle, int mode) {
+  VadInstT* self = (VadInstT*) handle;
+
+  if (handle == NULL) {
+    return -1;
+  }
+  if (self->init_flag != kInitCheck) {
+    return -1;
+  }
+
+  return WebRtcVad_set_mode_core(self, mode);
+}
+
+int WebRtcVad_set_adaptation(VadInst* handle, int interval,
+                             int drift_threshold) {
+  VadInstT* self = (VadInstT*) handle;
+
+  if (handle == NULL) {
+    return -1;
+  }
+  if (self->init_flag != kInitCheck) {
+    return -1;
+  }
+  if (interval < 1 || interval > WEBRTC_SPL_WORD16_MAX ||
+      drift_threshold < 0 || drift_threshold > WEBRTC_SPL_WORD16_MAX) {
+    return -1;
+  }
+
+  self->adapt_interval = (int16_t) interval;
+  self->adapt_drift_threshold = (int16_t) drift_threshold;
+  // Start from an update, so that the drift is measured before any skipping.
+  self->frames_since_update = 0;
+  self->last_update_drift = WEBRTC_SPL_WORD16_MAX;
+
+  return 0;
+}
+
+int WebRtcVad_get_adaptation_stats(VadInst* handle, uint32_t* updates,
+                                   uint32_t* skipped) {
+  VadInstT* self = (VadInstT*) handle;
+
+  if (handle == NULL || updates == NULL || skipped == NULL) {
+    return -1;
+  }
+  if (self->init_flag != kInitCheck) {
+    return -1;
+  }
+
+  *updates = self->model_updates;
+  *skipped = self->model_updates_skipped;
+
+  return 0;
+}
+
+int WebRtcVad_get_stats(VadInst* handle, VadStats* stats, int reset) {
+#if defined(WEBRTC_VAD_STATS)
+  VadInstT* self = (VadInstT*) handle;
+
+  if (handle == NULL || stats == NULL) {
+    return -1;
+  }
+  if (self->init_flag != kInitCheck) {
+    return -1;
+  }
+
+  *stats = self->stats;
+  if (reset) {
+    memset(&self->stats, 0, sizeof(self->stats));
+  }
+  return 0;
+#else
+  (void) handle;
+  (void) stats;
+  (void) reset;
+  return -1;
+#endif
+}
+
+int WebRtcVad_get_thread_stats(VadStats* stats, int reset) {
+#if defined(WEBRTC_VAD_STATS)
+  if (stats == NULL) {
+    return -1;
+  }
+
+  *stats = thread_stats;
+  if (reset) {
+    memset(&thread_stats, 0, sizeof(thread_stats));
+  }
+  return 0;
+#else
+  (void) stats;
+  (void) reset;
+  return -1;
+#endif
+}
+
+int WebRtcVad_TraceStart(size_t max_events) {
+#if defined(WEBRTC_VAD_TRACE)
+  if (trace_events != NULL || max_events == 0) {
+    return -1;
+  }
+  trace_events = (TraceEvent*) malloc(max_events * sizeof(TraceEvent));
+  if (trace_events == NULL) {
+    return -1;
+  }
+  trace_capacity = max_events;
+  trace_size = 0;
+  trace_num_threads = 0;
+  trace_generation++;
+  trace_origin_ns = MonotonicNs();
+  return 0;
+#else
+  (void) max_events;
+  return -1;
+#endif
+}
+
+int WebRtcVad_TraceThreadName(const char* name) {
+#if defined(WEBRTC_VAD_TRACE)
+  uint32_t thread;
+
+  if (trace_events == NULL || name == NULL) {
+    return -1;
+  }
+  thread = TraceThread();
+  if (thread < kTraceMaxThreads) {
+    strncpy(trace_thread_names[thread], name, kTraceThreadNameLength - 1);
+    trace_thread_names[thread][kTraceThreadNameLength - 1] = '\0';
+  }
+  return 0;
+#else
+  (void) name;
+  return -1;
+#endif
+}
+
+uint64_t WebRtcVad_TraceNow(void) {
+  return MonotonicNs();
+}
+
+int WebRtcVad_TraceSpan(const char* name, const char* category,
+                        uint64_t start_ns, uint64_t end_ns) {
+#if defined(WEBRTC_VAD_TRACE)
+  TraceEvent* event;
+  size_t index;
+
+  if (trace_events == NULL) {
+    return -1;
+  }
+  // |trace_size| keeps counting past the capacity, the excess is dropped.
+  index = __atomic_fetch_add(&trace_size, 1, __ATOMIC_RELAXED);
+  if (index >= trace_capacity) {
+    return -1;
+  }
+  event = &trace_events[index];
+  event->name = name;
+  event->category = category;
+  event->start_ns = start_ns;
+  event->duration_ns = end_ns > start_ns ? end_ns - start_ns : 0;
+  event->thread = TraceThread();
+  return 0;
+#else
+  (void) name;
+  (void) category;
+  (void) start_ns;
+  (void) end_ns;
+  return -1;
+#endif
+}
+
+int64_t WebRtcVad_TraceStop(const char* path) {
+#if defined(WEBRTC_VAD_TRACE)
+  const size_t size = trace_size < trace_capacity ? trace_size : trace_capacity;
+  const int64_t dropped = (int64_t) (trace_size - size);
+  FILE* file = NULL;
+  uint32_t thread;
+  size_t i;
+  int result = 0;
+
+  if (trace_events == NULL) {
+    return -1;
+  }
+
+  if (path != NULL) {
+    file = fopen(path, "w");
+    if (file == NULL) {
+      result = -1;
+    }
+  }
+  if (file != NULL) {
+    // Complete ("X") events in microseconds, relative to the trace start.
+    fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    for (thread = 1; thread <= trace_num_threads &&
+         thread < kTraceMaxThreads; thread++) {
+      if (trace_thread_names[thread][0] != '\0') {
+        fprintf(file, "{\"ph\": \"M\", \"name\": \"thread_name\", "
+                "\"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}},\n",
+                thread, trace_thread_names[thread]);
+      }
+    }
+    for (i = 0; i < size; i++) {
+      const TraceEvent* event = &trace_events[i];
+      const uint64_t start = event->start_ns > trace_origin_ns ?
+          event->start_ns - trace_origin_ns : 0;
+
+      fprintf(file, "{\"ph\": \"X\", \"name\": \"%s\", \"cat\": \"%s\", "
+              "\"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f},\n",
+              event->name, event->category, event->thread, start / 1e3,
+              event->duration_ns / 1e3);
+    }
+    fprintf(file, "{\"ph\": \"M\", \"name\": \"process_name\", \"pid\": 1, "
+            "\"args\": {\"name\": \"webrtc_vad\", \"dropped_spans\": %lld}}\n"
+            "]}\n", (long long) dropped);
+    if (fclose(file) != 0) {
+      result = -1;
+    }
+  }
+
+  free(trace_events);
+  trace_events = NULL;
+  trace_capacity = 0;
+  trace_size = 0;
+  memset(trace_thread_names, 0, sizeof(trace_thread_names));
+  return result == 0 ? dropped : -1;
+#else
+  (void) path;
+  return -1;
+#endif
+}
+
+int WebRtcVad_set_latency_histograms(VadInst* handle,
+                                     VadLatencyHistogram* stream,
+                                     VadLatencyHistogram* worker) {
+  VadInstT* self = (VadInstT*) handle;
+
+  if (handle == NULL) {
+    return -1;
+  }
+  if (self->init_flag != kInitCheck) {
+    return -1;
+  }
+
+  self->latency_stream = stream;
+  self->latency_worker = worker;
+
+  return 0;
+}
+
+// Latency histogram buckets. Values below |kVadLatencySubBuckets| have a
+// bucket each. Above, every power of two [2^m, 2^(m+1)) is split into
+// |kVadLatencySubBuckets| buckets of width 2^(m-4).
+static const int kLatencySubBucketBits = 4;
+static const int kLatencyMaxBits = 36;
+
+static int LatencyBucket(uint64_t ns) {
+  int msb;
+
+  if (ns < kVadLatencySubBuckets) {
+    return (int) ns;
+  }
+  if (ns >> kLatencyMaxBits) {
+    return kVadLatencyBuckets - 1;
+  }
+  msb = 63 - __builtin_clzll(ns);
+  return (msb - kLatencySubBucketBits + 1) * kVadLatencySubBuckets +
+      (int) ((ns >> (msb - kLatencySubBucketBits)) &
+             (kVadLatencySubBuckets - 1));
+}
+
+// Returns the largest value of |bucket|.
+static uint64_t LatencyBucketUpperBound(int bucket) {
+  int shift;
+
+  if (bucket < kVadLatencySubBuckets) {
+    return (uint64_t) bucket;
+  }
+  shift = bucket / kVadLatencySubBuckets - 1;
+  return (((uint64_t) (kVadLatencySubBuckets +
+                       bucket % kVadLatencySubBuckets) + 1) << shift) - 1;
+}
+
+void WebRtcVad_RecordLatency(VadLatencyHistogram* histogram, uint64_t ns) {
+  uint64_t max_ns;
+
+  // Relaxed ordering is enough, readers only need each count to be atomic.
+  __atomic_fetch_add(&histogram->counts[LatencyBucket(ns)], 1,
+                     __ATOMIC_RELAXED);
+  __atomic_fetch_add(&histogram->count, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&histogram->sum_ns, ns, __ATOMIC_RELAXED);
+  max_ns = __atomic_load_n(&histogram->max_ns, __ATOMIC_RELAXED);
+  while (ns > max_ns &&
+         !__atomic_compare_exchange_n(&histogram->max_ns, &max_ns, ns, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+void WebRtcVad_SnapshotLatency(VadLatencyHistogram* histogram,
+                               VadLatencyHistogram* snapshot, int reset) {
+  int i;
+
+  // With |reset| every count is swapped out, so a concurrent record lands
+  // either in this snapshot or in the next one. |count| is summed from the
+  // buckets, which keeps it consistent with them.
+  snapshot->count = 0;
+  for (i = 0; i < kVadLatencyBuckets; i++) {
+    if (reset) {
+      snapshot->counts[i] = __atomic_exchange_n(&histogram->counts[i], 0,
+                                                __ATOMIC_RELAXED);
+    } else {
+      snapshot->counts[i] = __atomic_load_n(&histogram->counts[i],
+                                            __ATOMIC_RELAXED);
+    }
+    snapshot->count += snapshot->counts[i];
+  }
+  if (reset) {
+    __atomic_fetch_sub(&histogram->count, snapshot->count, __ATOMIC_RELAXED);
+    snapshot->sum_ns = __atomic_exchange_n(&histogram->sum_ns, 0,
+                                           __ATOMIC_RELAXED);
+    snapshot->max_ns = __atomic_exchange_n(&histogram->max_ns, 0,
+                                           __ATOMIC_RELAXED);
+  } else {
+    snapshot->sum_ns = __atomic_load_n(&histogram->sum_ns, __ATOMIC_RELAXED);
+    snapshot->max_ns = __atomic_load_n(&histogram->max_ns, __ATOMIC_RELAXED);
+  }
+}
+
+void WebRtcVad_MergeLatency(VadLatencyHistogram* target,
+                            const VadLatencyHistogram* source) {
+  int i;
+
+  for (i = 0; i < kVadLatencyBuckets; i++) {
+    target->counts[i] += source->counts[i];
+  }
+  target->count += source->count;
+  target->sum_ns += source->sum_ns;
+  if (source->max_ns > target->max_ns) {
+    target->max_ns = source->max_ns;
+  }
+}
+
+uint64_t WebRtcVad_LatencyPercentile(const VadLatencyHistogram* snapshot,
+                                     double percentile) {
+  uint64_t rank;
+  uint64_t seen = 0;
+  uint64_t value;
+  int i;
+
+  if (snapshot->count == 0) {
+    return 0;
+  }
+  if (percentile < 0) {
+    percentile = 0;
+  } else if (percentile > 100) {
+    percentile = 100;
+  }
+
+  // The smallest value that at least |percentile| % of the records are at.
+  rank = (uint64_t) (percentile / 100 * snapshot->count + 0.5);
+  if (rank == 0) {
+    rank = 1;
+  }
+  for (i = 0; i < kVadLatencyBuckets - 1; i++) {
+    seen += snapshot->counts[i];
+    if (seen >= rank) {
+      break;
+    }
+  }
+  value = LatencyBucketUpperBound(i);
+  return value < snapshot->max_ns ? value : snapshot->max_ns;
+}
+
+int WebRtcVad_set_silence_skip(VadInst* handle, int enable, int threshold) {
+  VadInstT* self = (VadInstT*) handle;
+
+  if (handle == NULL) {
+    return -1;
+  }
+  if (self->init_flag != kInitCheck) {
+    return -1;
+  }
+  if (enable < 0 || enable > 1 || threshold < 0 ||
+      threshold > WEBRTC_SPL_WORD16_MAX) {
+    return -1;
+  }
+
+  self->silence_skip = (int16_t) enable;
+  self->silence_threshold = (int16_t) threshold;
+
+  return 0;
+}
+
+int WebRtcVad_set_feature_mode(VadInst* handle, int mode) {
+  VadInstT* self = (VadInstT*) handle;
+
+  if (handle == NULL) {
+    return -1;
+  }
+  if (self->init_flag != kInitCheck) {
+    return -1;
+  }
+  if (mode != kVadFeaturesFilterBank && mode != kVadFeaturesSpectral) {
+    return -1;
+  }
+
+  if (mode != self->feature_mode) {
+    // Whether an all-zero frame is a fixed point depends on the extractor.
+    self->zero_input_key = 0;
+  }
+  self->feature_mode = (int16_t) mode;
+
+  return 0;
+}
+
+int WebRtcVad_set_engine(VadInst* handle, int engine) {
+  VadInstT* self = (VadInstT*) handle;
+
+  if (handle == NULL) {
+    return -1;
+  }
+  if (self->init_flag != kInitCheck) {
+    return -1;
+  }
+  if (engine != kVadEngineFixed && engine != kVadEngineFloat) {
+    return -1;
+  }
+
+  if (engine == kVadEngineFloat && self->float_state == NULL) {
+    self->float_state = (VadFloatState*) calloc(1, sizeof(VadFloatState));
+    if (self->float_state == NULL) {
+      return -1;
+    }
+  }
+  if (engine != self->engine) {
+    WebRtcVad_ConvertEngineState(self, engine);
+    self->zero_input_key = 0;
+  }
+  self->engine = (int16_t) engine;
+
+  return 0;
+}
+
+int WebRtcVad_get_high_band_features(VadInst* handle, int16_t* features) {
+  VadInstT* self = (VadInstT*) handle;
+
+  if (handle == NULL || features == NULL) {
+    return -1;
+  }
+  if (self->init_flag != kInitCheck) {
+    return -1;
+  }
+
+  memcpy(features, self->high_band_features,
+         self->num_high_bands * sizeof(*features));
+
+  return self->num_high_bands;
+}
+
+// Runs the full VAD for a frame of a valid rate and length. The frame is
+// every |stride|th sample of |audio_frame|.
+static int CalcVad(VadInstT* self, int fs, const int16_t* audio_frame,
+                   int stride, int frame_length) {
+  int vad = -1;
+
+  if (self->feature_mode == kVadFeaturesSpectral) {
+    vad = WebRtcVad_CalcVadSpectral(self, fs, audio_frame, stride,
+                                    frame_length);
+  } else if (fs == 48000) {
+    vad = WebRtcVad_CalcVad48khz(self, audio_frame, stride, frame_length);
+  } else if (fs == 32000) {
+    vad = WebRtcVad_CalcVad32khz(self, audio_frame, stride, frame_length);
+  } else if (fs == 16000) {
+    vad = WebRtcVad_CalcVad16khz(self, audio_frame, stride, frame_length);
+  } else if (fs == 8000) {
+    vad = WebRtcVad_CalcVad8khz(self, audio_frame, stride, frame_length);
+  }
+
+  return vad;
+}
+
+// Returns the largest absolute value of every |stride|th of |length| samples.
+static int16_t MaxAbsValueStrided(const int16_t* vector, int stride,
+                                  int length) {
+  int i;
+  int maximum = 0;
+
+  if (stride == 1) {
+    return WebRtcSpl_MaxAbsValueW16(vector, length);
+  }
+  for (i = 0; i < length; i++) {
+    const int absolute = abs(vector[i * stride]);
+    if (absolute > maximum) {
+      maximum = absolute;
+    }
+  }
+  return (int16_t) (maximum > WEBRTC_SPL_WORD16_MAX ? WEBRTC_SPL_WORD16_MAX :
+                    maximum);
+}
+
+// The filter states an all-zero frame may change without exceeding
+// |kMinEnergy|. Nothing else but the hangover changes in that case.
+typedef struct {
+  int16_t upper_state[5];
+  int16_t lower_state[5];
+  int16_t hp_filter_state[4];
+  float float_upper_state[5];
+  float float_lower_state[5];
+  float float_hp_filter_state[4];
+  int32_t downsampling_filter_states[4];
+  WebRtcSpl_State48khzTo8khz state_48_to_8;
+  int32_t frame_counter;
+} FilterSnapshot;
+
+static void TakeFilterSnapshot(const VadInstT* self, FilterSnapshot* snapshot) {
+  // Zero everything first, so that snapshots can be compared with memcmp().
+  memset(snapshot, 0, sizeof(*snapshot));
+  memcpy(snapshot->upper_state, self->upper_state, sizeof(self->upper_state));
+  memcpy(snapshot->lower_state, self->lower_state, sizeof(self->lower_state));
+  memcpy(snapshot->hp_filter_state, self->hp_filter_state,
+         sizeof(self->hp_filter_state));
+  if (self->float_state != NULL) {
+    memcpy(snapshot->float_upper_state, self->float_state->upper_state,
+           sizeof(snapshot->float_upper_state));
+    memcpy(snapshot->float_lower_state, self->float_state->lower_state,
+           sizeof(snapshot->float_lower_state));
+    memcpy(snapshot->float_hp_filter_state,
+           self->float_state->hp_filter_state,
+           sizeof(snapshot->float_hp_filter_state));
+  }
+  memcpy(snapshot->downsampling_filter_states,
+         self->downsampling_filter_states,
+         sizeof(self->downsampling_filter_states));
+  if (self->state_48_to_8 != NULL) {
+    memcpy(&snapshot->state_48_to_8, self->state_48_to_8,
+           sizeof(snapshot->state_48_to_8));
+  }
+  snapshot->frame_counter = self->frame_counter;
+}
+
+// Processes an all-zero frame. If it already is known that such a frame
+// leaves the state unchanged, only the hangover is run.
+static int ProcessZeroFrame(VadInstT* self, int fs,
+                            const int16_t* audio_frame, int stride,
+                            int frame_length) {
+  const int32_t key = ((fs / 1000) << 16) | frame_length;
+  FilterSnapshot before, after;
+  int vad;
+
+  if (self->zero_input_key == key) {
+    VAD_STATS_ADD(self, silent_frames_skipped, 1);
+    return WebRtcVad_SmoothDecision(self, 0, frame_length / (fs / 8000));
+  }
+
+  TakeFilterSnapshot(self, &before);
+  vad = CalcVad(self, fs, audio_frame, stride, frame_length);
+  TakeFilterSnapshot(self, &after);
+
+  self->zero_input_key = 0;
+  if (vad >= 0 && memcmp(&before, &after, sizeof(before)) == 0) {
+    self->zero_input_key = key;
+  }
+
+  return vad;
+}
+
+// Processes a frame of a valid rate and length, every |stride|th sample of
+// |audio_frame|.
+static int ProcessFrame(VadInstT* self, int fs, const int16_t* audio_frame,
+                        int stride, int frame_length) {
+  const int previous = self->vad > 0;
+  int vad = -1;
+  int max_abs = -1;
+
+  // 8000, 16000, 32000 and 48000 Hz map to 0, 1, 2 and 3.
+  VAD_STATS_ADD(self, frames[fs == 48000 ? 3 : fs / 16000], 1);
+
+  if (self->silence_skip || self->silence_threshold > 0) {
+    max_abs = MaxAbsValueStrided(audio_frame, stride, frame_length);
+  }
+
+  if (max_abs == 0 && self->silence_skip) {
+    vad = ProcessZeroFrame(self, fs, audio_frame, stride, frame_length);
+  } else if (max_abs >= 0 && max_abs <= self->silence_threshold) {
+    // Approximate skip, the filter states are left as they are.
+    VAD_STATS_ADD(self, silent_frames_skipped, 1);
+    vad = WebRtcVad_SmoothDecision(self, 0, frame_length / (fs / 8000));
+  } else {
+    self->zero_input_key = 0;
+    vad = CalcVad(self, fs, audio_frame, stride, frame_length);
+  }
+
+  if (vad > 0) {
+    vad = 1;
+    VAD_STATS_ADD(self, speech_frames, 1);
+  } else if (vad == 0) {
+    VAD_STATS_ADD(self, non_speech_frames, 1);
+  }
+  if (vad >= 0 && vad != previous) {
+    // Arguments: instance, new decision, frames processed so far.
+    VAD_PROBE3(decision_change, self, vad, self->frame_counter);
+  }
+  return vad;
+}
 
-int WebRtcVad_Create(VadInst** handle) {
-  VadInstT* self = NULL;
+// ProcessFrame() with the latency histograms, trace and probes.
+static int ProcessFrameTimed(VadInstT* self, int fs, const int16_t* audio_frame,
+                             int stride, int frame_length) {
+  int vad;
+  uint64_t start, end;
+
+  VAD_PROBE3(process_entry, self, fs, frame_length);
+  if (self->latency_stream == NULL && self->latency_worker == NULL &&
+      !TRACE_RUNNING()) {
+    vad = ProcessFrame(self, fs, audio_frame, stride, frame_length);
+  } else {
+    start = MonotonicNs();
+    vad = ProcessFrame(self, fs, audio_frame, stride, frame_length);
+    end = MonotonicNs();
+    if (self->latency_stream != NULL) {
+      WebRtcVad_RecordLatency(self->latency_stream, end - start);
+    }
+    if (self->latency_worker != NULL) {
+      WebRtcVad_RecordLatency(self->latency_worker, end - start);
+    }
+    if (TRACE_RUNNING()) {
+      WebRtcVad_TraceSpan("frame", "vad", start, end);
+    }
+  }
+  VAD_PROBE2(process_return, self, vad);
+  return vad;
+}
+
+int WebRtcVad_Process(VadInst* handle, int fs, int16_t* audio_frame,
+                      int frame_length) {
+  VadInstT* self = (VadInstT*) handle;
 
   if (handle == NULL) {
     return -1;
   }
 
-  *handle = NULL;
-  self = (VadInstT*) malloc(sizeof(VadInstT));
-  *handle = (VadInst*) self;
+  if (self->init_flag != kInitCheck) {
+    return -1;
+  }
+  if (audio_frame == NULL) {
+    return -1;
+  }
+  if (WebRtcVad_ValidRateAndFrameLength(fs, frame_length) != 0) {
+    return -1;
+  }
 
-  if (self == NULL) {
+  return ProcessFrameTimed(self, fs, audio_frame, 1, frame_length);
+}
+
+int WebRtcVad_ProcessInterleaved(VadInst* const* handles, int num_channels,
+                                 int stride, int fs, const int16_t* audio,
+                                 int frame_length, size_t num_frames,
+                                 uint8_t* decisions) {
+  const int16_t* frame;
+  size_t i;
+  int channel;
+  int vad;
+
+  if (handles == NULL || num_channels <= 0 || stride < num_channels) {
+    return -1;
+  }
+  if ((audio == NULL || decisions == NULL) && num_frames > 0) {
     return -1;
   }
+  if (WebRtcVad_ValidRateAndFrameLength(fs, frame_length) != 0) {
+    return -1;
+  }
+  for (channel = 0; channel < num_channels; channel++) {
+    const VadInstT* self = (const VadInstT*) handles[channel];
+    if (self == NULL || self->init_flag != kInitCheck) {
+      return -1;
+    }
+  }
 
-  WebRtcSpl_Init();
+  // The channels of a frame are processed one after the other. Each reads
+  // its samples directly from |audio| in its first filter stage, so the
+  // frame is fetched from memory once and then read from the cache.
+  for (i = 0; i < num_frames; i++) {
+    frame = audio + i * frame_length * stride;
+    for (channel = 0; channel < num_channels; channel++) {
+      vad = ProcessFrameTimed((VadInstT*) handles[channel], fs,
+                              frame + channel, stride, frame_length);
+      if (vad < 0) {
+        return -1;
+      }
+      decisions[i * num_channels + channel] = (uint8_t) vad;
+    }
+  }
 
-  self->init_flag = 0;
+  return 0;
+}
+
+// Expands |length| samples of |format| to 16 bits. Returns -1 for an unknown
+// format.
+static int ExpandSamples(int format, const void* in, int length,
+                         int16_t* out) {
+  const uint8_t* bytes = (const uint8_t*) in;
+  const float* floats = (const float*) in;
+  int i;
 
+  if (format == kVadFormatMuLaw) {
+    WebRtcSpl_MuLawToW16(bytes, length, out);
+  } else if (format == kVadFormatALaw) {
+    WebRtcSpl_ALawToW16(bytes, length, out);
+  } else if (format == kVadFormatFloat) {
+    for (i = 0; i < length; i++) {
+      const float scaled = floats[i] * 32768.0f;
+
+      if (scaled >= 32767.0f) {
+        out[i] = 32767;
+      } else if (scaled <= -32768.0f) {
+        out[i] = -32768;
+      } else if (scaled == scaled) {
+        out[i] = (int16_t) lrintf(scaled);
+      } else {
+        out[i] = 0;  // NaN.
+      }
+    }
+  } else if (format == kVadFormatS24LE) {
+    for (i = 0; i < length; i++) {
+      out[i] = (int16_t) (bytes[3 * i + 1] | (bytes[3 * i + 2] << 8));
+    }
+  } else if (format == kVadFormatS32LE) {
+    for (i = 0; i < length; i++) {
+      out[i] = (int16_t) (bytes[4 * i + 2] | (bytes[4 * i + 3] << 8));
+    }
+  } else {
+    return -1;
+  }
   return 0;
 }
 
-int WebRtcVad_Free(VadInst* handle) {
+int WebRtcVad_ProcessFormat(VadInst* handle, int fs, int format,
+                            const void* audio_frame, int frame_length) {
+  int16_t frame[1440];  // 30 ms in 48 kHz.
+  VadInstT* self = (VadInstT*) handle;
+
   if (handle == NULL) {
     return -1;
   }
 
-  free(handle);
-
-  return 0;
-}
+  if (self->init_flag != kInitCheck) {
+    return -1;
+  }
+  if (audio_frame == NULL) {
+    return -1;
+  }
+  if (WebRtcVad_ValidRateAndFrameLength(fs, frame_length) != 0) {
+    return -1;
+  }
 
-// TODO(bjornv): Move WebRtcVad_InitCore() code here.
-int WebRtcVad_Init(VadInst* handle) {
-  // Initialize the core VAD component.
-  return WebRtcVad_InitCore((VadInstT*) handle);
+  if (format == kVadFormatS16) {
+    return ProcessFrameTimed(self, fs, (const int16_t*) audio_frame, 1,
+                             frame_length);
+  }
+  // At most 2.9 kB, so the first filter stage reads it from the L1 cache.
+  if (ExpandSamples(format, audio_frame, frame_length, frame) != 0) {
+    return -1;
+  }
+  return ProcessFrameTimed(self, fs, frame, 1, frame_length);
 }
 
-// TODO(bjornv): Move WebRtcVad_set_mode_core() code here.
-int WebRtcVad_set_mode(VadInst* handle, int mode) {
+int WebRtcVad_ProcessBatch(VadInst* handle, int fs, const int16_t* audio,
+                           int frame_length, size_t num_frames,
+                           uint8_t* decisions) {
+  size_t i;
+  int vad;
   VadInstT* self = (VadInstT*) handle;
 
   if (handle == NULL) {
     return -1;
   }
+
   if (self->init_flag != kInitCheck) {
     return -1;
   }
+  if ((audio == NULL || decisions == NULL) && num_frames > 0) {
+    return -1;
+  }
+  if (WebRtcVad_ValidRateAndFrameLength(fs, frame_length) != 0) {
+    return -1;
+  }
 
-  return WebRtcVad_set_mode_core(self, mode);
+  for (i = 0; i < num_frames; i++) {
+    // The filter bank never writes to its input.
+    vad = WebRtcVad_Process(handle, fs, (int16_t*) audio, frame_length);
+    if (vad < 0) {
+      return -1;
+    }
+    decisions[i] = (uint8_t) vad;
+    audio += frame_length;
+  }
+
+  return 0;
 }
 
-int WebRtcVad_Process(VadInst* handle, int fs, int16_t* audio_frame,
-                      int frame_length) {
-  int vad = -1;
+int WebRtcVad_ProcessNonSpeech(VadInst* handle, int fs, int frame_length,
+                               int num_frames, const int16_t* features) {
+  int vad = 0;
+  int i;
+  int frame_length_8khz;
   VadInstT* self = (VadInstT*) handle;
 
   if (handle == NULL) {
@@ -82,21 +1163,19 @@ int WebRtcVad_Process(VadInst* handle, int fs, int16_t* audio_frame,
   if (self->init_flag != kInitCheck) {
     return -1;
   }
-  if (audio_frame == NULL) {
+  if (num_frames <= 0) {
     return -1;
   }
   if (WebRtcVad_ValidRateAndFrameLength(fs, frame_length) != 0) {
     return -1;
   }
 
-  if (fs == 48000) {
-      vad = WebRtcVad_CalcVad48khz(self, audio_frame, frame_length);
-  } else if (fs == 32000) {
-    vad = WebRtcVad_CalcVad32khz(self, audio_frame, frame_length);
-  } else if (fs == 16000) {
-    vad = WebRtcVad_CalcVad16khz(self, audio_frame, frame_length);
-  } else if (fs == 8000) {
-    vad = WebRtcVad_CalcVad8khz(self, audio_frame, frame_length);
+  frame_length_8khz = frame_length / (fs / 8000);
+  for (i = 0; i < num_frames; i++) {
+    if (features != NULL) {
+      WebRtcVad_AdaptToNoise(self, features, frame_length_8khz);
+    }
+    vad = WebRtcVad_SmoothDecision(self, 0, frame_length_8khz);
   }
 
   if (vad > 0) {
@@ -865,6 +1944,57 @@ int16_t WebRtcSpl_MaxAbsValueW16C(const int16_t* vector, int length) {
   return (int16_t)maximum;
 }
 
+#if defined(WEBRTC_USE_SSE2) || defined(WEBRTC_SPL_SSE2_IFUNC)
+#include <emmintrin.h>
+
+// SSE2 code in a build for a target without SSE2.
+#if defined(WEBRTC_SPL_SSE2_IFUNC)
+#define SSE2_TARGET __attribute__((target("sse2")))
+#else
+#define SSE2_TARGET
+#endif
+
+// Maximum absolute value of word16 vector. SSE2 version, bit-exact with the
+// C version.
+SSE2_TARGET
+int16_t WebRtcSpl_MaxAbsValueW16SSE2(const int16_t* vector, int length) {
+  int i = 0, absolute = 0, maximum = 0;
+  const __m128i zero = _mm_setzero_si128();
+  __m128i max_abs = zero;
+
+  if (vector == NULL || length <= 0) {
+    return -1;
+  }
+
+  for (i = 0; i + 8 <= length; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i*) &vector[i]);
+    // Saturating negation maps -32768 to 32767, which is the guarded value
+    // of abs(-32768) in the C version.
+    __m128i negated = _mm_subs_epi16(zero, v);
+    max_abs = _mm_max_epi16(max_abs, _mm_max_epi16(v, negated));
+  }
+  max_abs = _mm_max_epi16(max_abs, _mm_srli_si128(max_abs, 8));
+  max_abs = _mm_max_epi16(max_abs, _mm_srli_si128(max_abs, 4));
+  max_abs = _mm_max_epi16(max_abs, _mm_srli_si128(max_abs, 2));
+  maximum = (int16_t) _mm_cvtsi128_si32(max_abs);
+
+  for (; i < length; i++) {
+    absolute = abs((int)vector[i]);
+
+    if (absolute > maximum) {
+      maximum = absolute;
+    }
+  }
+
+  // Guard the case for abs(-32768).
+  if (maximum > WEBRTC_SPL_WORD16_MAX) {
+    maximum = WEBRTC_SPL_WORD16_MAX;
+  }
+
+  return (int16_t)maximum;
+}
+#endif
+
 // Maximum absolute value of word32 vector. C version for generic platforms.
 int32_t WebRtcSpl_MaxAbsValueW32C(const int32_t* vector, int length) {
   // Use uint32_t for the local variables, to accommodate the return value
@@ -1093,6 +2223,472 @@ int WebRtcSpl_RealInverseFFTC(struct RealFFT* self,
   return WebRtcSpl_ComplexIFFT(data_out, self->order, 1);
 }
 
+#if defined(WEBRTC_USE_SSE2) || defined(WEBRTC_SPL_SSE2_IFUNC)
+// Vectorized versions of the high accuracy (mode 1) WebRtcSpl_ComplexFFT()
+// and WebRtcSpl_ComplexIFFT(), bit-exact with them. Both round after every
+// radix-2 stage, so the stages are kept and each one is vectorized across
+// the butterflies sharing a block, four (SSE2) or eight (AVX2) at a time.
+//
+// The forward and inverse stages only differ in the sign of the twiddle
+// imaginary part and in the final shift: the forward transform always
+// halves, i.e., it is the inverse one with |shift| 1.
+
+// Scalar stage, for the stages with fewer butterflies per block than lanes.
+static void ComplexFFTStage(int16_t* frfi, int n, int l, int k, int inverse,
+                            int shift) {
+  const int istep = l << 1;
+  const int32_t round2 = 8192 << shift;
+  int i, j, m;
+  int16_t wr, wi;
+  int32_t tr32, ti32, qr32, qi32;
+
+  for (m = 0; m < l; ++m) {
+    j = m << k;
+    wr = kSinTable1024[j + 256];
+    wi = inverse ? kSinTable1024[j] : -kSinTable1024[j];
+
+    for (i = m; i < n; i += istep) {
+      j = i + l;
+
+      tr32 = WEBRTC_SPL_MUL_16_16(wr, frfi[2 * j])
+          - WEBRTC_SPL_MUL_16_16(wi, frfi[2 * j + 1]) + CFFTRND;
+      ti32 = WEBRTC_SPL_MUL_16_16(wr, frfi[2 * j + 1])
+          + WEBRTC_SPL_MUL_16_16(wi, frfi[2 * j]) + CFFTRND;
+      tr32 = WEBRTC_SPL_RSHIFT_W32(tr32, 15 - CFFTSFT);
+      ti32 = WEBRTC_SPL_RSHIFT_W32(ti32, 15 - CFFTSFT);
+
+      qr32 = ((int32_t) frfi[2 * i]) << CFFTSFT;
+      qi32 = ((int32_t) frfi[2 * i + 1]) << CFFTSFT;
+
+      frfi[2 * j] = (int16_t) WEBRTC_SPL_RSHIFT_W32(qr32 - tr32 + round2,
+                                                    shift + CFFTSFT);
+      frfi[2 * j + 1] = (int16_t) WEBRTC_SPL_RSHIFT_W32(qi32 - ti32 + round2,
+                                                        shift + CFFTSFT);
+      frfi[2 * i] = (int16_t) WEBRTC_SPL_RSHIFT_W32(qr32 + tr32 + round2,
+                                                    shift + CFFTSFT);
+      frfi[2 * i + 1] = (int16_t) WEBRTC_SPL_RSHIFT_W32(qi32 + ti32 + round2,
+                                                        shift + CFFTSFT);
+    }
+  }
+}
+
+// Four butterflies. |top| and |bottom| hold four complex values each, as
+// interleaved 16-bit pairs, so _mm_madd_epi16() of |bottom| with |w_real|
+// (wr, -wi) and |w_imag| (wi, wr) gives the 32-bit products as in the C
+// version.
+SSE2_TARGET
+static __inline void ButterfliesSSE2(__m128i* top, __m128i* bottom,
+                                     __m128i w_real, __m128i w_imag,
+                                     __m128i round2, __m128i count) {
+  const __m128i one = _mm_set1_epi32(CFFTRND);
+  const __m128i low_mask = _mm_set1_epi32(0xFFFF);
+  __m128i tr = _mm_madd_epi16(*bottom, w_real);
+  __m128i ti = _mm_madd_epi16(*bottom, w_imag);
+  __m128i qr = _mm_slli_epi32(_mm_srai_epi32(_mm_slli_epi32(*top, 16), 16),
+                              CFFTSFT);
+  __m128i qi = _mm_slli_epi32(_mm_srai_epi32(*top, 16), CFFTSFT);
+  __m128i out_r, out_i;
+
+  tr = _mm_srai_epi32(_mm_add_epi32(tr, one), 15 - CFFTSFT);
+  ti = _mm_srai_epi32(_mm_add_epi32(ti, one), 15 - CFFTSFT);
+  qr = _mm_add_epi32(qr, round2);
+  qi = _mm_add_epi32(qi, round2);
+
+  // The 16-bit results are truncated, not saturated, as in C.
+  out_r = _mm_sra_epi32(_mm_sub_epi32(qr, tr), count);
+  out_i = _mm_sra_epi32(_mm_sub_epi32(qi, ti), count);
+  *bottom = _mm_or_si128(_mm_and_si128(out_r, low_mask),
+                         _mm_slli_epi32(out_i, 16));
+  out_r = _mm_sra_epi32(_mm_add_epi32(qr, tr), count);
+  out_i = _mm_sra_epi32(_mm_add_epi32(qi, ti), count);
+  *top = _mm_or_si128(_mm_and_si128(out_r, low_mask),
+                      _mm_slli_epi32(out_i, 16));
+}
+
+// Loads the twiddle factors of butterflies |m| to |m| + 3 of a stage, see
+// ButterfliesSSE2(). |m_step| is 0 for four times the same one.
+SSE2_TARGET
+static void LoadTwiddlesSSE2(int m, int m_step, int k, int inverse,
+                             __m128i* w_real, __m128i* w_imag) {
+  int16_t w[16];
+  int t;
+
+  // Short stages load butterflies past the end of the block, which are not
+  // used. Keep them inside the table.
+  for (t = 0; t < 4; t++) {
+    const int j = ((m + t * m_step) << k) & 511;
+    const int16_t wr = kSinTable1024[j + 256];
+    const int16_t wi = inverse ? kSinTable1024[j] : -kSinTable1024[j];
+
+    w[2 * t] = wr;
+    w[2 * t + 1] = -wi;
+    w[8 + 2 * t] = wi;
+    w[8 + 2 * t + 1] = wr;
+  }
+  *w_real = _mm_loadu_si128((const __m128i*) &w[0]);
+  *w_imag = _mm_loadu_si128((const __m128i*) &w[8]);
+}
+
+// Stage with a multiple of four butterflies per block.
+SSE2_TARGET
+static void ComplexFFTStageSSE2(int16_t* frfi, int n, int l, int k,
+                                int inverse, int shift) {
+  const int istep = l << 1;
+  const __m128i round2 = _mm_set1_epi32(8192 << shift);
+  const __m128i count = _mm_cvtsi32_si128(shift + CFFTSFT);
+  int i, m;
+
+  for (m = 0; m < l; m += 4) {
+    __m128i w_real, w_imag;
+
+    LoadTwiddlesSSE2(m, 1, k, inverse, &w_real, &w_imag);
+    for (i = m; i < n; i += istep) {
+      __m128i* top = (__m128i*) &frfi[2 * i];
+      __m128i* bottom = (__m128i*) &frfi[2 * (i + l)];
+      __m128i a = _mm_loadu_si128(top);
+      __m128i x = _mm_loadu_si128(bottom);
+
+      ButterfliesSSE2(&a, &x, w_real, w_imag, round2, count);
+      _mm_storeu_si128(bottom, x);
+      _mm_storeu_si128(top, a);
+    }
+  }
+}
+
+// The first two stages, |l| 1 or 2, for a multiple of eight complex values.
+// Eight consecutive values hold four (l == 1) or two (l == 2) blocks; their
+// tops and bottoms are gathered into one register each, with shuffles of the
+// 32-bit complex values.
+SSE2_TARGET
+static void ComplexFFTShortStageSSE2(int16_t* frfi, int n, int l, int k,
+                                     int inverse, int shift) {
+  const __m128i round2 = _mm_set1_epi32(8192 << shift);
+  const __m128i count = _mm_cvtsi32_si128(shift + CFFTSFT);
+  __m128i w_real, w_imag;
+  int i;
+
+  if (l == 1) {
+    LoadTwiddlesSSE2(0, 0, k, inverse, &w_real, &w_imag);
+  } else {
+    // Butterflies 0, 1, 0, 1.
+    __m128i w_real_01, w_imag_01;
+
+    LoadTwiddlesSSE2(0, 1, k, inverse, &w_real_01, &w_imag_01);
+    w_real = _mm_unpacklo_epi64(w_real_01, w_real_01);
+    w_imag = _mm_unpacklo_epi64(w_imag_01, w_imag_01);
+  }
+
+  for (i = 0; i < n; i += 8) {
+    __m128i* data = (__m128i*) &frfi[2 * i];
+    __m128i v0 = _mm_loadu_si128(data);
+    __m128i v1 = _mm_loadu_si128(data + 1);
+    __m128i top, bottom;
+
+    if (l == 1) {
+      // (c0, c2, c1, c3) and (c4, c6, c5, c7).
+      v0 = _mm_shuffle_epi32(v0, _MM_SHUFFLE(3, 1, 2, 0));
+      v1 = _mm_shuffle_epi32(v1, _MM_SHUFFLE(3, 1, 2, 0));
+    }
+    top = _mm_unpacklo_epi64(v0, v1);
+    bottom = _mm_unpackhi_epi64(v0, v1);
+
+    ButterfliesSSE2(&top, &bottom, w_real, w_imag, round2, count);
+
+    if (l == 1) {
+      v0 = _mm_unpacklo_epi32(top, bottom);
+      v1 = _mm_unpackhi_epi32(top, bottom);
+    } else {
+      v0 = _mm_unpacklo_epi64(top, bottom);
+      v1 = _mm_unpackhi_epi64(top, bottom);
+    }
+    _mm_storeu_si128(data, v0);
+    _mm_storeu_si128(data + 1, v1);
+  }
+}
+
+// Runs stage |l| with the widest SSE2 code it allows.
+SSE2_TARGET
+static void ComplexFFTAnyStageSSE2(int16_t* frfi, int n, int l, int k,
+                                   int inverse, int shift) {
+  if (l >= 4) {
+    ComplexFFTStageSSE2(frfi, n, l, k, inverse, shift);
+  } else if (n >= 8) {
+    ComplexFFTShortStageSSE2(frfi, n, l, k, inverse, shift);
+  } else {
+    ComplexFFTStage(frfi, n, l, k, inverse, shift);
+  }
+}
+
+// Returns the shift of an inverse stage and adds it to |scale|, as
+// WebRtcSpl_ComplexIFFT() does.
+static int InverseStageShift(const int16_t* frfi, int n, int* scale) {
+  const int32_t max_abs = WebRtcSpl_MaxAbsValueW16(frfi, 2 * n);
+  int shift = 0;
+
+  if (max_abs > 13573) {
+    shift++;
+  }
+  if (max_abs > 27146) {
+    shift++;
+  }
+  *scale += shift;
+  return shift;
+}
+
+// Same as WebRtcSpl_ComplexFFT() or, with |inverse|, WebRtcSpl_ComplexIFFT()
+// in mode 1.
+SSE2_TARGET
+static int ComplexFFTSSE2(int16_t* frfi, int stages, int inverse) {
+  const int n = 1 << stages;
+  int l, k = 10 - 1;
+  int scale = 0;
+  int shift = 1;
+
+  if (n > 1024) {
+    return -1;
+  }
+  for (l = 1; l < n; l <<= 1, --k) {
+    if (inverse) {
+      shift = InverseStageShift(frfi, n, &scale);
+    }
+    ComplexFFTAnyStageSSE2(frfi, n, l, k, inverse, shift);
+  }
+  return inverse ? scale : 0;
+}
+
+SSE2_TARGET
+int WebRtcSpl_RealForwardFFTSSE2(struct RealFFT* self,
+                                 const int16_t* data_in,
+                                 int16_t* data_out) {
+  memcpy(data_out, data_in, sizeof(int16_t) * (1 << (self->order + 1)));
+  WebRtcSpl_ComplexBitReverse(data_out, self->order);
+  return ComplexFFTSSE2(data_out, self->order, 0);
+}
+
+SSE2_TARGET
+int WebRtcSpl_RealInverseFFTSSE2(struct RealFFT* self,
+                                 const int16_t* data_in,
+                                 int16_t* data_out) {
+  memcpy(data_out, data_in, sizeof(int16_t) * (1 << (self->order + 1)));
+  WebRtcSpl_ComplexBitReverse(data_out, self->order);
+  return ComplexFFTSSE2(data_out, self->order, 1);
+}
+#endif
+
+#if defined(WEBRTC_SPL_AVX2)
+#include <immintrin.h>
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+// The SSE2 stage with eight butterflies at a time.
+AVX2_TARGET
+static void ComplexFFTStageAVX2(int16_t* frfi, int n, int l, int k,
+                                int inverse, int shift) {
+  const int istep = l << 1;
+  const __m256i one = _mm256_set1_epi32(CFFTRND);
+  const __m256i round2 = _mm256_set1_epi32(8192 << shift);
+  const __m128i count = _mm_cvtsi32_si128(shift + CFFTSFT);
+  const __m256i low_mask = _mm256_set1_epi32(0xFFFF);
+  int16_t w[32];
+  int i, m, t;
+
+  for (m = 0; m < l; m += 8) {
+    __m256i w_real, w_imag;
+
+    for (t = 0; t < 8; t++) {
+      const int j = (m + t) << k;
+      const int16_t wr = kSinTable1024[j + 256];
+      const int16_t wi = inverse ? kSinTable1024[j] : -kSinTable1024[j];
+
+      w[2 * t] = wr;
+      w[2 * t + 1] = -wi;
+      w[16 + 2 * t] = wi;
+      w[16 + 2 * t + 1] = wr;
+    }
+    w_real = _mm256_loadu_si256((const __m256i*) &w[0]);
+    w_imag = _mm256_loadu_si256((const __m256i*) &w[16]);
+
+    for (i = m; i < n; i += istep) {
+      int16_t* top = &frfi[2 * i];
+      int16_t* bottom = &frfi[2 * (i + l)];
+      const __m256i x = _mm256_loadu_si256((const __m256i*) bottom);
+      const __m256i a = _mm256_loadu_si256((const __m256i*) top);
+      __m256i tr = _mm256_madd_epi16(x, w_real);
+      __m256i ti = _mm256_madd_epi16(x, w_imag);
+      __m256i qr = _mm256_slli_epi32(
+          _mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16), CFFTSFT);
+      __m256i qi = _mm256_slli_epi32(_mm256_srai_epi32(a, 16), CFFTSFT);
+      __m256i out_r, out_i;
+
+      tr = _mm256_srai_epi32(_mm256_add_epi32(tr, one), 15 - CFFTSFT);
+      ti = _mm256_srai_epi32(_mm256_add_epi32(ti, one), 15 - CFFTSFT);
+      qr = _mm256_add_epi32(qr, round2);
+      qi = _mm256_add_epi32(qi, round2);
+
+      out_r = _mm256_sra_epi32(_mm256_sub_epi32(qr, tr), count);
+      out_i = _mm256_sra_epi32(_mm256_sub_epi32(qi, ti), count);
+      _mm256_storeu_si256((__m256i*) bottom,
+                          _mm256_or_si256(_mm256_and_si256(out_r, low_mask),
+                                          _mm256_slli_epi32(out_i, 16)));
+      out_r = _mm256_sra_epi32(_mm256_add_epi32(qr, tr), count);
+      out_i = _mm256_sra_epi32(_mm256_add_epi32(qi, ti), count);
+      _mm256_storeu_si256((__m256i*) top,
+                          _mm256_or_si256(_mm256_and_si256(out_r, low_mask),
+                                          _mm256_slli_epi32(out_i, 16)));
+    }
+  }
+}
+
+AVX2_TARGET
+static int ComplexFFTAVX2(int16_t* frfi, int stages, int inverse) {
+  const int n = 1 << stages;
+  int l, k = 10 - 1;
+  int scale = 0;
+  int shift = 1;
+
+  if (n > 1024) {
+    return -1;
+  }
+  for (l = 1; l < n; l <<= 1, --k) {
+    if (inverse) {
+      shift = InverseStageShift(frfi, n, &scale);
+    }
+    if (l >= 8) {
+      ComplexFFTStageAVX2(frfi, n, l, k, inverse, shift);
+    } else {
+      ComplexFFTAnyStageSSE2(frfi, n, l, k, inverse, shift);
+    }
+  }
+  return inverse ? scale : 0;
+}
+
+// Copies the 2^|stages| complex values of |in| to |out| in bit-reversed
+// order, the same permutation as WebRtcSpl_ComplexBitReverse(). Out of place
+// it is a gather: the bit-reversed indexes are computed eight at a time
+// (bits within each byte by a nibble table, then the byte order) and the
+// complex values, one 32-bit word each, are gathered with them.
+AVX2_TARGET
+static void BitReverseCopyAVX2(const int16_t* in, int16_t* out, int stages) {
+  const int n = 1 << stages;
+  const __m256i nibble_reversed = _mm256_setr_epi8(
+      0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15,
+      0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15);
+  const __m256i byte_order_reversed = _mm256_setr_epi8(
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  const __m256i low_nibbles = _mm256_set1_epi8(0x0F);
+  const __m256i step = _mm256_set1_epi32(8);
+  __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  int m;
+
+  if (n < 8) {
+    memcpy(out, in, sizeof(int16_t) * 2 * n);
+    WebRtcSpl_ComplexBitReverse(out, stages);
+    return;
+  }
+
+  for (m = 0; m < n; m += 8) {
+    const __m256i low = _mm256_and_si256(index, low_nibbles);
+    const __m256i high = _mm256_and_si256(_mm256_srli_epi16(index, 4),
+                                          low_nibbles);
+    __m256i reversed = _mm256_or_si256(
+        _mm256_slli_epi16(_mm256_shuffle_epi8(nibble_reversed, low), 4),
+        _mm256_shuffle_epi8(nibble_reversed, high));
+
+    reversed = _mm256_shuffle_epi8(reversed, byte_order_reversed);
+    reversed = _mm256_srli_epi32(reversed, 32 - stages);
+    _mm256_storeu_si256((__m256i*) &out[2 * m],
+                        _mm256_i32gather_epi32((const int*) in, reversed, 4));
+    index = _mm256_add_epi32(index, step);
+  }
+}
+
+AVX2_TARGET
+int WebRtcSpl_RealForwardFFTAVX2(struct RealFFT* self,
+                                 const int16_t* data_in,
+                                 int16_t* data_out) {
+  BitReverseCopyAVX2(data_in, data_out, self->order);
+  return ComplexFFTAVX2(data_out, self->order, 0);
+}
+
+AVX2_TARGET
+int WebRtcSpl_RealInverseFFTAVX2(struct RealFFT* self,
+                                 const int16_t* data_in,
+                                 int16_t* data_out) {
+  BitReverseCopyAVX2(data_in, data_out, self->order);
+  return ComplexFFTAVX2(data_out, self->order, 1);
+}
+
+// Sixteen G.711 codes at a time. The shift by the exponent is a multiply with
+// a power of two looked up per byte; the upper byte of every word indexes
+// with bit 7 set, which reads 0.
+AVX2_TARGET
+void WebRtcSpl_MuLawToW16AVX2(const uint8_t* in, int length, int16_t* out) {
+  const __m256i powers = _mm256_setr_epi8(
+      1, 2, 4, 8, 16, 32, 64, (char) 128, 0, 0, 0, 0, 0, 0, 0, 0,
+      1, 2, 4, 8, 16, 32, 64, (char) 128, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i upper_index = _mm256_set1_epi16((short) 0x8000);
+  const __m256i bias = _mm256_set1_epi16(0x84);
+  int i;
+
+  for (i = 0; i + 16 <= length; i += 16) {
+    const __m256i code = _mm256_xor_si256(
+        _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) &in[i])),
+        _mm256_set1_epi16(0xFF));
+    const __m256i exponent = _mm256_and_si256(_mm256_srli_epi16(code, 4),
+                                              _mm256_set1_epi16(7));
+    const __m256i power = _mm256_shuffle_epi8(
+        powers, _mm256_or_si256(exponent, upper_index));
+    const __m256i mantissa = _mm256_add_epi16(
+        _mm256_slli_epi16(_mm256_and_si256(code, _mm256_set1_epi16(0x0F)), 3),
+        bias);
+    const __m256i magnitude = _mm256_sub_epi16(
+        _mm256_mullo_epi16(mantissa, power), bias);
+    const __m256i negative = _mm256_cmpeq_epi16(
+        _mm256_and_si256(code, _mm256_set1_epi16(0x80)),
+        _mm256_set1_epi16(0x80));
+
+    _mm256_storeu_si256((__m256i*) &out[i], _mm256_sub_epi16(
+        _mm256_xor_si256(magnitude, negative), negative));
+  }
+  WebRtcSpl_MuLawToW16C(&in[i], length - i, &out[i]);
+}
+
+// As WebRtcSpl_MuLawToW16AVX2(), the segments above 0 are shifted by one less
+// and get 256 added first.
+AVX2_TARGET
+void WebRtcSpl_ALawToW16AVX2(const uint8_t* in, int length, int16_t* out) {
+  const __m256i powers = _mm256_setr_epi8(
+      1, 1, 2, 4, 8, 16, 32, 64, 0, 0, 0, 0, 0, 0, 0, 0,
+      1, 1, 2, 4, 8, 16, 32, 64, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i upper_index = _mm256_set1_epi16((short) 0x8000);
+  const __m256i zero = _mm256_setzero_si256();
+  int i;
+
+  for (i = 0; i + 16 <= length; i += 16) {
+    const __m256i code = _mm256_xor_si256(
+        _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) &in[i])),
+        _mm256_set1_epi16(0x55));
+    const __m256i segment = _mm256_and_si256(_mm256_srli_epi16(code, 4),
+                                             _mm256_set1_epi16(7));
+    const __m256i power = _mm256_shuffle_epi8(
+        powers, _mm256_or_si256(segment, upper_index));
+    const __m256i offset = _mm256_andnot_si256(
+        _mm256_cmpeq_epi16(segment, zero), _mm256_set1_epi16(0x100));
+    const __m256i mantissa = _mm256_add_epi16(
+        _mm256_slli_epi16(_mm256_and_si256(code, _mm256_set1_epi16(0x0F)), 4),
+        _mm256_add_epi16(offset, _mm256_set1_epi16(8)));
+    const __m256i magnitude = _mm256_mullo_epi16(mantissa, power);
+    const __m256i negative = _mm256_cmpeq_epi16(
+        _mm256_and_si256(code, _mm256_set1_epi16(0x80)), zero);
+
+    _mm256_storeu_si256((__m256i*) &out[i], _mm256_sub_epi16(
+        _mm256_xor_si256(magnitude, negative), negative));
+  }
+  WebRtcSpl_ALawToW16C(&in[i], length - i, &out[i]);
+}
+#endif
+
 #if defined(WEBRTC_DETECT_ARM_NEON) || defined(WEBRTC_ARCH_ARM_NEON)
 // TODO(kma): Replace the following function bodies into optimized functions
 // for ARM Neon.
@@ -1185,15 +2781,22 @@ void WebRtcSpl_ResetResample16khzTo48khz(WebRtcSpl_State16khzTo48khz* state)
 ///// 48 kHz ->  8 kHz /////
 ////////////////////////////
 
-// 48 -> 8 resampler
-void WebRtcSpl_Resample48khzTo8khz(const WebRtc_Word16* in, WebRtc_Word16* out,
-                                   WebRtcSpl_State48khzTo8khz* state, WebRtc_Word32* tmpmem)
+static void DownBy2ShortToIntStrided(const WebRtc_Word16 *in, int in_stride,
+                                     WebRtc_Word32 len, WebRtc_Word32 *out,
+                                     WebRtc_Word32 *state);
+
+// 48 -> 8 resampler of every |in_stride|th sample of |in|, i.e., of one
+// channel of interleaved input. Only the first stage reads |in|.
+static void Resample48khzTo8khzStrided(const WebRtc_Word16* in, int in_stride,
+                                       WebRtc_Word16* out,
+                                       WebRtcSpl_State48khzTo8khz* state,
+                                       WebRtc_Word32* tmpmem)
 {
     ///// 48 --> 24 /////
     // WebRtc_Word16  in[480]
     // WebRtc_Word32 out[240]
     /////
-    WebRtcSpl_DownBy2ShortToInt(in, 480, tmpmem + 256, state->S_48_24);
+    DownBy2ShortToIntStrided(in, in_stride, 480, tmpmem + 256, state->S_48_24);
 
     ///// 24 --> 24(LP) /////
     // WebRtc_Word32  in[240]
@@ -1217,6 +2820,13 @@ void WebRtcSpl_Resample48khzTo8khz(const WebRtc_Word16* in, WebRtc_Word16* out,
     WebRtcSpl_DownBy2IntToShort(tmpmem, 160, out, state->S_16_8);
 }
 
+// 48 -> 8 resampler
+void WebRtcSpl_Resample48khzTo8khz(const WebRtc_Word16* in, WebRtc_Word16* out,
+                                   WebRtcSpl_State48khzTo8khz* state, WebRtc_Word32* tmpmem)
+{
+    Resample48khzTo8khzStrided(in, 1, out, state, tmpmem);
+}
+
 // initialize state of 48 -> 8 resampler
 void WebRtcSpl_ResetResample48khzTo8khz(WebRtcSpl_State48khzTo8khz* state)
 {
@@ -1376,10 +2986,13 @@ void WebRtcSpl_DownBy2IntToShort(WebRtc_Word32 *in, WebRtc_Word32 len, WebRtc_Wo
 // output: WebRtc_Word32 (shifted 15 positions to the left, + offset 16384) (of length len/2)
 // state:  filter state array; length = 8
 
-void WebRtcSpl_DownBy2ShortToInt(const WebRtc_Word16 *in,
-                                  WebRtc_Word32 len,
-                                  WebRtc_Word32 *out,
-                                  WebRtc_Word32 *state)
+// As WebRtcSpl_DownBy2ShortToInt(), on every |in_stride|th sample of |in|,
+// i.e., on one channel of interleaved input.
+static void DownBy2ShortToIntStrided(const WebRtc_Word16 *in,
+                                     int in_stride,
+                                     WebRtc_Word32 len,
+                                     WebRtc_Word32 *out,
+                                     WebRtc_Word32 *state)
 {
     WebRtc_Word32 tmp0, tmp1, diff;
     WebRtc_Word32 i;
@@ -1389,7 +3002,7 @@ void WebRtcSpl_DownBy2ShortToInt(const WebRtc_Word16 *in,
     // lower allpass filter (operates on even input samples)
     for (i = 0; i < len; i++)
     {
-        tmp0 = ((WebRtc_Word32)in[i << 1] << 15) + (1 << 14);
+        tmp0 = ((WebRtc_Word32)in[(i << 1) * in_stride] << 15) + (1 << 14);
         diff = tmp0 - state[1];
         // scale down and round
         diff = (diff + (1 << 13)) >> 14;
@@ -1414,12 +3027,12 @@ void WebRtcSpl_DownBy2ShortToInt(const WebRtc_Word16 *in,
         out[i] = (state[3] >> 1);
     }
 
-    in++;
+    in += in_stride;
 
     // upper allpass filter (operates on odd input samples)
     for (i = 0; i < len; i++)
     {
-        tmp0 = ((WebRtc_Word32)in[i << 1] << 15) + (1 << 14);
+        tmp0 = ((WebRtc_Word32)in[(i << 1) * in_stride] << 15) + (1 << 14);
         diff = tmp0 - state[5];
         // scale down and round
         diff = (diff + (1 << 13)) >> 14;
@@ -1444,7 +3057,14 @@ void WebRtcSpl_DownBy2ShortToInt(const WebRtc_Word16 *in,
         out[i] += (state[7] >> 1);
     }
 
-    in--;
+}
+
+void WebRtcSpl_DownBy2ShortToInt(const WebRtc_Word16 *in,
+                                  WebRtc_Word32 len,
+                                  WebRtc_Word32 *out,
+                                  WebRtc_Word32 *state)
+{
+    DownBy2ShortToIntStrided(in, 1, len, out, state);
 }
 
 //
@@ -2158,6 +3778,7 @@ void WebRtcSpl_Resample44khzTo32khz(const WebRtc_Word32 *In, WebRtc_Word32 *Out,
 }
 
 
+#if defined(WEBRTC_SPL_POINTER_DISPATCH)
 /* Declare function pointers. */
 MaxAbsValueW16 WebRtcSpl_MaxAbsValueW16;
 MaxAbsValueW32 WebRtcSpl_MaxAbsValueW32;
@@ -2170,6 +3791,8 @@ DownsampleFast WebRtcSpl_DownsampleFast;
 ScaleAndAddVectorsWithRound WebRtcSpl_ScaleAndAddVectorsWithRound;
 RealForwardFFT WebRtcSpl_RealForwardFFT;
 RealInverseFFT WebRtcSpl_RealInverseFFT;
+MuLawToW16 WebRtcSpl_MuLawToW16;
+ALawToW16 WebRtcSpl_ALawToW16;
 
 #if defined(WEBRTC_DETECT_ARM_NEON) || !defined(WEBRTC_ARCH_ARM_NEON)
 /* Initialize function pointers to the generic C version. */
@@ -2186,6 +3809,8 @@ static void InitPointersToC() {
       WebRtcSpl_ScaleAndAddVectorsWithRoundC;
   WebRtcSpl_RealForwardFFT = WebRtcSpl_RealForwardFFTC;
   WebRtcSpl_RealInverseFFT = WebRtcSpl_RealInverseFFTC;
+  WebRtcSpl_MuLawToW16 = WebRtcSpl_MuLawToW16C;
+  WebRtcSpl_ALawToW16 = WebRtcSpl_ALawToW16C;
 }
 #endif
 
@@ -2204,6 +3829,18 @@ static void InitPointersToNeon() {
       WebRtcSpl_ScaleAndAddVectorsWithRoundNeon;
   WebRtcSpl_RealForwardFFT = WebRtcSpl_RealForwardFFTNeon;
   WebRtcSpl_RealInverseFFT = WebRtcSpl_RealInverseFFTNeon;
+  WebRtcSpl_MuLawToW16 = WebRtcSpl_MuLawToW16C;
+  WebRtcSpl_ALawToW16 = WebRtcSpl_ALawToW16C;
+}
+#endif
+
+#if defined(WEBRTC_USE_SSE2) || defined(WEBRTC_SPL_SSE2_IFUNC)
+/* Initialize function pointers to the SSE2 version, where there is one. */
+static void InitPointersToSSE2() {
+  InitPointersToC();
+  WebRtcSpl_MaxAbsValueW16 = WebRtcSpl_MaxAbsValueW16SSE2;
+  WebRtcSpl_RealForwardFFT = WebRtcSpl_RealForwardFFTSSE2;
+  WebRtcSpl_RealInverseFFT = WebRtcSpl_RealInverseFFTSSE2;
 }
 #endif
 
@@ -2216,9 +3853,27 @@ static void InitFunctionPointers(void) {
   }
 #elif defined(WEBRTC_ARCH_ARM_NEON)
   InitPointersToNeon();
+#elif defined(WEBRTC_USE_SSE2)
+  InitPointersToSSE2();
+#elif defined(WEBRTC_SPL_SSE2_IFUNC)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2")) {
+    InitPointersToSSE2();
+  } else {
+    InitPointersToC();
+  }
 #else
   InitPointersToC();
 #endif  /* WEBRTC_DETECT_ARM_NEON */
+#if defined(WEBRTC_SPL_AVX2)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    WebRtcSpl_RealForwardFFT = WebRtcSpl_RealForwardFFTAVX2;
+    WebRtcSpl_RealInverseFFT = WebRtcSpl_RealInverseFFTAVX2;
+    WebRtcSpl_MuLawToW16 = WebRtcSpl_MuLawToW16AVX2;
+    WebRtcSpl_ALawToW16 = WebRtcSpl_ALawToW16AVX2;
+  }
+#endif
 }
 
 #if defined(WEBRTC_POSIX)
@@ -2260,6 +3915,203 @@ static void once(void (*func)(void)) {
 void WebRtcSpl_Init() {
   once(InitFunctionPointers);
 }
+#else  /* WEBRTC_SPL_POINTER_DISPATCH */
+
+/* Kernels bound to their implementation for the build target, see
+ * WebRtcSpl_Init() in vad.h.
+ */
+#if defined(WEBRTC_ARCH_ARM_NEON)
+#define SPL_KERNEL(name) name##Neon
+#else
+#define SPL_KERNEL(name) name##C
+#endif
+
+/* Resolvers run while the dynamic loader relocates, before a sanitizer runtime
+ * is set up, so they must not be instrumented.
+ */
+#define IFUNC_RESOLVER __attribute__((no_sanitize_address))
+
+#if defined(WEBRTC_SPL_SSE2_IFUNC)
+/* Resolved by the dynamic loader, before any constructor has run. */
+IFUNC_RESOLVER
+static MaxAbsValueW16 ResolveMaxAbsValueW16(void) {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse2") ? WebRtcSpl_MaxAbsValueW16SSE2 :
+      WebRtcSpl_MaxAbsValueW16C;
+}
+
+int16_t WebRtcSpl_MaxAbsValueW16(const int16_t* vector, int length)
+    __attribute__((ifunc("ResolveMaxAbsValueW16")));
+#else
+int16_t WebRtcSpl_MaxAbsValueW16(const int16_t* vector, int length) {
+#if defined(WEBRTC_USE_SSE2)
+  return WebRtcSpl_MaxAbsValueW16SSE2(vector, length);
+#else
+  return SPL_KERNEL(WebRtcSpl_MaxAbsValueW16)(vector, length);
+#endif
+}
+#endif
+
+int32_t WebRtcSpl_MaxAbsValueW32(const int32_t* vector, int length) {
+  return SPL_KERNEL(WebRtcSpl_MaxAbsValueW32)(vector, length);
+}
+
+int16_t WebRtcSpl_MaxValueW16(const int16_t* vector, int length) {
+  return SPL_KERNEL(WebRtcSpl_MaxValueW16)(vector, length);
+}
+
+int32_t WebRtcSpl_MaxValueW32(const int32_t* vector, int length) {
+  return SPL_KERNEL(WebRtcSpl_MaxValueW32)(vector, length);
+}
+
+int16_t WebRtcSpl_MinValueW16(const int16_t* vector, int length) {
+  return SPL_KERNEL(WebRtcSpl_MinValueW16)(vector, length);
+}
+
+int32_t WebRtcSpl_MinValueW32(const int32_t* vector, int length) {
+  return SPL_KERNEL(WebRtcSpl_MinValueW32)(vector, length);
+}
+
+void WebRtcSpl_CrossCorrelation(int32_t* cross_correlation,
+                                const int16_t* seq1,
+                                const int16_t* seq2,
+                                int16_t dim_seq,
+                                int16_t dim_cross_correlation,
+                                int16_t right_shifts,
+                                int16_t step_seq2) {
+  SPL_KERNEL(WebRtcSpl_CrossCorrelation)(cross_correlation, seq1, seq2,
+                                         dim_seq, dim_cross_correlation,
+                                         right_shifts, step_seq2);
+}
+
+int WebRtcSpl_DownsampleFast(const int16_t* data_in,
+                             int data_in_length,
+                             int16_t* data_out,
+                             int data_out_length,
+                             const int16_t* __restrict coefficients,
+                             int coefficients_length,
+                             int factor,
+                             int delay) {
+  return SPL_KERNEL(WebRtcSpl_DownsampleFast)(data_in, data_in_length,
+                                              data_out, data_out_length,
+                                              coefficients,
+                                              coefficients_length, factor,
+                                              delay);
+}
+
+int WebRtcSpl_ScaleAndAddVectorsWithRound(const int16_t* in_vector1,
+                                          int16_t in_vector1_scale,
+                                          const int16_t* in_vector2,
+                                          int16_t in_vector2_scale,
+                                          int right_shifts,
+                                          int16_t* out_vector,
+                                          int length) {
+  return SPL_KERNEL(WebRtcSpl_ScaleAndAddVectorsWithRound)(in_vector1,
+                                                           in_vector1_scale,
+                                                           in_vector2,
+                                                           in_vector2_scale,
+                                                           right_shifts,
+                                                           out_vector,
+                                                           length);
+}
+
+#if defined(WEBRTC_SPL_AVX2) && !defined(__AVX2__)
+IFUNC_RESOLVER
+static RealForwardFFT ResolveRealForwardFFT(void) {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return WebRtcSpl_RealForwardFFTAVX2;
+  }
+#if defined(WEBRTC_SPL_SSE2_IFUNC)
+  if (!__builtin_cpu_supports("sse2")) {
+    return WebRtcSpl_RealForwardFFTC;
+  }
+#endif
+  return WebRtcSpl_RealForwardFFTSSE2;
+}
+
+IFUNC_RESOLVER
+static RealInverseFFT ResolveRealInverseFFT(void) {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return WebRtcSpl_RealInverseFFTAVX2;
+  }
+#if defined(WEBRTC_SPL_SSE2_IFUNC)
+  if (!__builtin_cpu_supports("sse2")) {
+    return WebRtcSpl_RealInverseFFTC;
+  }
+#endif
+  return WebRtcSpl_RealInverseFFTSSE2;
+}
+
+int WebRtcSpl_RealForwardFFT(struct RealFFT* self, const int16_t* data_in,
+                             int16_t* data_out)
+    __attribute__((ifunc("ResolveRealForwardFFT")));
+int WebRtcSpl_RealInverseFFT(struct RealFFT* self, const int16_t* data_in,
+                             int16_t* data_out)
+    __attribute__((ifunc("ResolveRealInverseFFT")));
+#else
+int WebRtcSpl_RealForwardFFT(struct RealFFT* self, const int16_t* data_in,
+                             int16_t* data_out) {
+#if defined(WEBRTC_SPL_AVX2)
+  return WebRtcSpl_RealForwardFFTAVX2(self, data_in, data_out);
+#else
+  return SPL_KERNEL(WebRtcSpl_RealForwardFFT)(self, data_in, data_out);
+#endif
+}
+
+int WebRtcSpl_RealInverseFFT(struct RealFFT* self, const int16_t* data_in,
+                             int16_t* data_out) {
+#if defined(WEBRTC_SPL_AVX2)
+  return WebRtcSpl_RealInverseFFTAVX2(self, data_in, data_out);
+#else
+  return SPL_KERNEL(WebRtcSpl_RealInverseFFT)(self, data_in, data_out);
+#endif
+}
+#endif
+
+// The G.711 expansion has no Neon version.
+#if defined(WEBRTC_SPL_AVX2) && !defined(__AVX2__)
+IFUNC_RESOLVER
+static MuLawToW16 ResolveMuLawToW16(void) {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? WebRtcSpl_MuLawToW16AVX2 :
+      WebRtcSpl_MuLawToW16C;
+}
+
+IFUNC_RESOLVER
+static ALawToW16 ResolveALawToW16(void) {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? WebRtcSpl_ALawToW16AVX2 :
+      WebRtcSpl_ALawToW16C;
+}
+
+void WebRtcSpl_MuLawToW16(const uint8_t* in, int length, int16_t* out)
+    __attribute__((ifunc("ResolveMuLawToW16")));
+void WebRtcSpl_ALawToW16(const uint8_t* in, int length, int16_t* out)
+    __attribute__((ifunc("ResolveALawToW16")));
+#else
+void WebRtcSpl_MuLawToW16(const uint8_t* in, int length, int16_t* out) {
+#if defined(WEBRTC_SPL_AVX2)
+  WebRtcSpl_MuLawToW16AVX2(in, length, out);
+#else
+  WebRtcSpl_MuLawToW16C(in, length, out);
+#endif
+}
+
+void WebRtcSpl_ALawToW16(const uint8_t* in, int length, int16_t* out) {
+#if defined(WEBRTC_SPL_AVX2)
+  WebRtcSpl_ALawToW16AVX2(in, length, out);
+#else
+  WebRtcSpl_ALawToW16C(in, length, out);
+#endif
+}
+#endif
+
+/* Nothing to initialize, the kernels are bound already. */
+void WebRtcSpl_Init() {
+}
+#endif  /* WEBRTC_SPL_POINTER_DISPATCH */
 
 
 // Spectrum Weighting
@@ -2310,30 +4162,29 @@ static const int16_t kMinStd = 384;
 // Default aggressiveness mode.
 static const short kDefaultMode = 0;
 
-// Constants used in WebRtcVad_set_mode_core().
-//
-// Thresholds for different frame lengths (10 ms, 20 ms and 30 ms).
+// Constants used in WebRtcVad_set_mode_core() and GmmProbability().
 //
-// Mode 0, Quality.
-static const int16_t kOverHangMax1Q[3] = { 8, 4, 3 };
-static const int16_t kOverHangMax2Q[3] = { 14, 7, 5 };
-static const int16_t kLocalThresholdQ[3] = { 24, 21, 24 };
-static const int16_t kGlobalThresholdQ[3] = { 57, 48, 57 };
-// Mode 1, Low bitrate.
-static const int16_t kOverHangMax1LBR[3] = { 8, 4, 3 };
-static const int16_t kOverHangMax2LBR[3] = { 14, 7, 5 };
-static const int16_t kLocalThresholdLBR[3] = { 37, 32, 37 };
-static const int16_t kGlobalThresholdLBR[3] = { 100, 80, 100 };
-// Mode 2, Aggressive.
-static const int16_t kOverHangMax1AGG[3] = { 6, 3, 2 };
-static const int16_t kOverHangMax2AGG[3] = { 9, 5, 3 };
-static const int16_t kLocalThresholdAGG[3] = { 82, 78, 82 };
-static const int16_t kGlobalThresholdAGG[3] = { 285, 260, 285 };
-// Mode 3, Very aggressive.
-static const int16_t kOverHangMax1VAG[3] = { 6, 3, 2 };
-static const int16_t kOverHangMax2VAG[3] = { 9, 5, 3 };
-static const int16_t kLocalThresholdVAG[3] = { 94, 94, 94 };
-static const int16_t kGlobalThresholdVAG[3] = { 1100, 1050, 1100 };
+// Thresholds for the different aggressiveness modes, indexed by
+// |VadInstT::mode|. Each array holds the value for 10 ms, 20 ms and 30 ms
+// frames. The tables are shared by all instances.
+typedef struct {
+  int16_t over_hang_max_1[3];
+  int16_t over_hang_max_2[3];
+  int16_t individual[3];
+  int16_t total[3];
+} VadModeTable;
+
+static const VadModeTable kModeTables[] = {
+  // Mode 0, Quality.
+  { { 8, 4, 3 }, { 14, 7, 5 }, { 24, 21, 24 }, { 57, 48, 57 } },
+  // Mode 1, Low bitrate.
+  { { 8, 4, 3 }, { 14, 7, 5 }, { 37, 32, 37 }, { 100, 80, 100 } },
+  // Mode 2, Aggressive.
+  { { 6, 3, 2 }, { 9, 5, 3 }, { 82, 78, 82 }, { 285, 260, 285 } },
+  // Mode 3, Very aggressive.
+  { { 6, 3, 2 }, { 9, 5, 3 }, { 94, 94, 94 }, { 1100, 1050, 1100 } }
+};
+static const int kNumModes = sizeof(kModeTables) / sizeof(*kModeTables);
 
 // Calculates the weighted average w.r.t. number of Gaussians. The |data| are
 // updated with an |offset| before averaging.
@@ -2355,379 +4206,534 @@ static int32_t WeightedAverage(int16_t* data, int16_t offset,
   return weighted_average;
 }
 
-// Calculates the probabilities for both speech and background noise using
-// Gaussian Mixture Models (GMM). A hypothesis-test is performed to decide which
-// type of signal is most probable.
+// Updates the noise and speech GMM parameters of |self| with respect to the
+// decision |vadflag| for the current frame.
 //
 // - self           [i/o] : Pointer to VAD instance
 // - features       [i]   : Feature vector of length |kNumChannels|
-//                          = log10(energy in frequency band)
-// - total_power    [i]   : Total power in audio frame.
-// - frame_length   [i]   : Number of input samples
-//
-// - returns              : the VAD decision (0 - noise, 1 - speech).
-static int16_t GmmProbability(VadInstT* self, int16_t* features,
-                              int16_t total_power, int frame_length) {
+// - vadflag        [i]   : The VAD decision of the current frame.
+// - deltaN         [i]   : Noise model deltas, from GaussianProbability().
+// - deltaS         [i]   : Speech model deltas, from GaussianProbability().
+// - ngprvec        [i]   : Conditional noise probabilities per Gaussian.
+// - sgprvec        [i]   : Conditional speech probabilities per Gaussian.
+static void UpdateModel(VadInstT* self, const int16_t* features,
+                        int16_t vadflag, const int16_t* deltaN,
+                        const int16_t* deltaS, const int16_t* ngprvec,
+                        const int16_t* sgprvec) {
   int channel, k;
   int16_t feature_minimum;
-  int16_t h0, h1;
-  int16_t log_likelihood_ratio;
-  int16_t vadflag = 0;
-  int16_t shifts_h0, shifts_h1;
   int16_t tmp_s16, tmp1_s16, tmp2_s16;
   int16_t diff;
   int gaussian;
   int16_t nmk, nmk2, nmk3, smk, smk2, nsk, ssk;
   int16_t delt, ndelt;
   int16_t maxspe, maxmu;
-  int16_t deltaN[kTableSize], deltaS[kTableSize];
-  int16_t ngprvec[kTableSize] = { 0 };  // Conditional probability = 0.
-  int16_t sgprvec[kTableSize] = { 0 };  // Conditional probability = 0.
-  int32_t h0_test, h1_test;
   int32_t tmp1_s32, tmp2_s32;
-  int32_t sum_log_likelihood_ratios = 0;
   int32_t noise_global_mean, speech_global_mean;
-  int32_t noise_probability[kNumGaussians], speech_probability[kNumGaussians];
-  int16_t overhead1, overhead2, individualTest, totalTest;
-
-  // Set various thresholds based on frame lengths (80, 160 or 240 samples).
-  if (frame_length == 80) {
-    overhead1 = self->over_hang_max_1[0];
-    overhead2 = self->over_hang_max_2[0];
-    individualTest = self->individual[0];
-    totalTest = self->total[0];
-  } else if (frame_length == 160) {
-    overhead1 = self->over_hang_max_1[1];
-    overhead2 = self->over_hang_max_2[1];
-    individualTest = self->individual[1];
-    totalTest = self->total[1];
-  } else {
-    overhead1 = self->over_hang_max_1[2];
-    overhead2 = self->over_hang_max_2[2];
-    individualTest = self->individual[2];
-    totalTest = self->total[2];
-  }
 
-  if (total_power > kMinEnergy) {
-    // The signal power of current frame is large enough for processing. The
-    // processing consists of two parts:
-    // 1) Calculating the likelihood of speech and thereby a VAD decision.
-    // 2) Updating the underlying model, w.r.t., the decision made.
 
-    // The detection scheme is an LRT with hypothesis
-    // H0: Noise
-    // H1: Speech
-    //
-    // We combine a global LRT with local tests, for each frequency sub-band,
-    // here defined as |channel|.
-    for (channel = 0; channel < kNumChannels; channel++) {
-      // For each channel we model the probability with a GMM consisting of
-      // |kNumGaussians|, with different means and standard deviations depending
-      // on H0 or H1.
-      h0_test = 0;
-      h1_test = 0;
-      for (k = 0; k < kNumGaussians; k++) {
-        gaussian = channel + k * kNumChannels;
-        // Probability under H0, that is, probability of frame being noise.
-        // Value given in Q27 = Q7 * Q20.
-        tmp1_s32 = WebRtcVad_GaussianProbability(features[channel],
-                                                 self->noise_means[gaussian],
-                                                 self->noise_stds[gaussian],
-                                                 &deltaN[gaussian]);
-        noise_probability[k] = kNoiseDataWeights[gaussian] * tmp1_s32;
-        h0_test += noise_probability[k];  // Q27
-
-        // Probability under H1, that is, probability of frame being speech.
-        // Value given in Q27 = Q7 * Q20.
-        tmp1_s32 = WebRtcVad_GaussianProbability(features[channel],
-                                                 self->speech_means[gaussian],
-                                                 self->speech_stds[gaussian],
-                                                 &deltaS[gaussian]);
-        speech_probability[k] = kSpeechDataWeights[gaussian] * tmp1_s32;
-        h1_test += speech_probability[k];  // Q27
+  maxspe = 12800;
+  for (channel = 0; channel < kNumChannels; channel++) {
+
+    // Get minimum value in past which is used for long term correction in Q4.
+    feature_minimum = WebRtcVad_FindMinimum(self, features[channel], channel);
+
+    // Compute the "global" mean, that is the sum of the two means weighted.
+    noise_global_mean = WeightedAverage(&self->noise_means[channel], 0,
+                                        &kNoiseDataWeights[channel]);
+    tmp1_s16 = (int16_t) (noise_global_mean >> 6);  // Q8
+
+    for (k = 0; k < kNumGaussians; k++) {
+      gaussian = channel + k * kNumChannels;
+
+      nmk = self->noise_means[gaussian];
+      smk = self->speech_means[gaussian];
+      nsk = self->noise_stds[gaussian];
+      ssk = self->speech_stds[gaussian];
+
+      // Update noise mean vector if the frame consists of noise only.
+      nmk2 = nmk;
+      if (!vadflag) {
+        // deltaN = (x-mu)/sigma^2
+        // ngprvec[k] = |noise_probability[k]| /
+        //   (|noise_probability[0]| + |noise_probability[1]|)
+
+        // (Q14 * Q11 >> 11) = Q14.
+        delt = (int16_t) WEBRTC_SPL_MUL_16_16_RSFT(ngprvec[gaussian],
+                                                   deltaN[gaussian],
+                                                   11);
+        // Q7 + (Q14 * Q15 >> 22) = Q7.
+        nmk2 = nmk + (int16_t) WEBRTC_SPL_MUL_16_16_RSFT(delt,
+                                                         kNoiseUpdateConst,
+                                                         22);
       }
 
-      // Calculate the log likelihood ratio: log2(Pr{X|H1} / Pr{X|H1}).
-      // Approximation:
-      // log2(Pr{X|H1} / Pr{X|H1}) = log2(Pr{X|H1}*2^Q) - log2(Pr{X|H1}*2^Q)
-      //                           = log2(h1_test) - log2(h0_test)
-      //                           = log2(2^(31-shifts_h1)*(1+b1))
-      //                             - log2(2^(31-shifts_h0)*(1+b0))
-      //                           = shifts_h0 - shifts_h1
-      //                             + log2(1+b1) - log2(1+b0)
-      //                          ~= shifts_h0 - shifts_h1
-      //
-      // Note that b0 and b1 are values less than 1, hence, 0 <= log2(1+b0) < 1.
-      // Further, b0 and b1 are independent and on the average the two terms
-      // cancel.
-      shifts_h0 = WebRtcSpl_NormW32(h0_test);
-      shifts_h1 = WebRtcSpl_NormW32(h1_test);
-      if (h0_test == 0) {
-        shifts_h0 = 31;
+      // Long term correction of the noise mean.
+      // Q8 - Q8 = Q8.
+      ndelt = (feature_minimum << 4) - tmp1_s16;
+      // Q7 + (Q8 * Q8) >> 9 = Q7.
+      nmk3 = nmk2 + (int16_t) WEBRTC_SPL_MUL_16_16_RSFT(ndelt, kBackEta, 9);
+
+      // Control that the noise mean does not drift to much.
+      tmp_s16 = (int16_t) ((k + 5) << 7);
+      if (nmk3 < tmp_s16) {
+        nmk3 = tmp_s16;
       }
-      if (h1_test == 0) {
-        shifts_h1 = 31;
+      tmp_s16 = (int16_t) ((72 + k - channel) << 7);
+      if (nmk3 > tmp_s16) {
+        nmk3 = tmp_s16;
       }
-      log_likelihood_ratio = shifts_h0 - shifts_h1;
+      self->noise_means[gaussian] = nmk3;
+
+      if (vadflag) {
+        // Update speech mean vector:
+        // |deltaS| = (x-mu)/sigma^2
+        // sgprvec[k] = |speech_probability[k]| /
+        //   (|speech_probability[0]| + |speech_probability[1]|)
+
+        // (Q14 * Q11) >> 11 = Q14.
+        delt = (int16_t) WEBRTC_SPL_MUL_16_16_RSFT(sgprvec[gaussian],
+                                                   deltaS[gaussian],
+                                                   11);
+        // Q14 * Q15 >> 21 = Q8.
+        tmp_s16 = (int16_t) WEBRTC_SPL_MUL_16_16_RSFT(delt,
+                                                      kSpeechUpdateConst,
+                                                      21);
+        // Q7 + (Q8 >> 1) = Q7. With rounding.
+        smk2 = smk + ((tmp_s16 + 1) >> 1);
+
+        // Control that the speech mean does not drift to much.
+        maxmu = maxspe + 640;
+        if (smk2 < kMinimumMean[k]) {
+          smk2 = kMinimumMean[k];
+        }
+        if (smk2 > maxmu) {
+          smk2 = maxmu;
+        }
+        self->speech_means[gaussian] = smk2;  // Q7.
 
-      // Update |sum_log_likelihood_ratios| with spectrum weighting. This is
-      // used for the global VAD decision.
-      sum_log_likelihood_ratios +=
-          (int32_t) (log_likelihood_ratio * kSpectrumWeight[channel]);
+        // (Q7 >> 3) = Q4. With rounding.
+        tmp_s16 = ((smk + 4) >> 3);
 
-      // Local VAD decision.
-      if ((log_likelihood_ratio << 2) > individualTest) {
-        vadflag = 1;
-      }
+        tmp_s16 = features[channel] - tmp_s16;  // Q4
+        // (Q11 * Q4 >> 3) = Q12.
+        tmp1_s32 = WEBRTC_SPL_MUL_16_16_RSFT(deltaS[gaussian], tmp_s16, 3);
+        tmp2_s32 = tmp1_s32 - 4096;
+        tmp_s16 = sgprvec[gaussian] >> 2;
+        // (Q14 >> 2) * Q12 = Q24.
+        tmp1_s32 = tmp_s16 * tmp2_s32;
 
-      // TODO(bjornv): The conditional probabilities below are applied on the
-      // hard coded number of Gaussians set to two. Find a way to generalize.
-      // Calculate local noise probabilities used later when updating the GMM.
-      h0 = (int16_t) (h0_test >> 12);  // Q15
-      if (h0 > 0) {
-        // High probability of noise. Assign conditional probabilities for each
-        // Gaussian in the GMM.
-        tmp1_s32 = (noise_probability[0] & 0xFFFFF000) << 2;  // Q29
-        ngprvec[channel] = (int16_t) WebRtcSpl_DivW32W16(tmp1_s32, h0);  // Q14
-        ngprvec[channel + kNumChannels] = 16384 - ngprvec[channel];
+        tmp2_s32 = tmp1_s32 >> 4;  // Q20
+
+        // 0.1 * Q20 / Q7 = Q13.
+        if (tmp2_s32 > 0) {
+          tmp_s16 = (int16_t) WebRtcSpl_DivW32W16(tmp2_s32, ssk * 10);
+        } else {
+          tmp_s16 = (int16_t) WebRtcSpl_DivW32W16(-tmp2_s32, ssk * 10);
+          tmp_s16 = -tmp_s16;
+        }
+        // Divide by 4 giving an update factor of 0.025 (= 0.1 / 4).
+        // Note that division by 4 equals shift by 2, hence,
+        // (Q13 >> 8) = (Q13 >> 6) / 4 = Q7.
+        tmp_s16 += 128;  // Rounding.
+        ssk += (tmp_s16 >> 8);
+        if (ssk < kMinStd) {
+          ssk = kMinStd;
+        }
+        self->speech_stds[gaussian] = ssk;
       } else {
-        // Low noise probability. Assign conditional probability 1 to the first
-        // Gaussian and 0 to the rest (which is already set at initialization).
-        ngprvec[channel] = 16384;
+        // Update GMM variance vectors.
+        // deltaN * (features[channel] - nmk) - 1
+        // Q4 - (Q7 >> 3) = Q4.
+        tmp_s16 = features[channel] - (nmk >> 3);
+        // (Q11 * Q4 >> 3) = Q12.
+        tmp1_s32 = WEBRTC_SPL_MUL_16_16_RSFT(deltaN[gaussian], tmp_s16, 3);
+        tmp1_s32 -= 4096;
+
+        // (Q14 >> 2) * Q12 = Q24.
+        tmp_s16 = (ngprvec[gaussian] + 2) >> 2;
+        tmp2_s32 = tmp_s16 * tmp1_s32;
+        // Q20  * approx 0.001 (2^-10=0.0009766), hence,
+        // (Q24 >> 14) = (Q24 >> 4) / 2^10 = Q20.
+        tmp1_s32 = tmp2_s32 >> 14;
+
+        // Q20 / Q7 = Q13.
+        if (tmp1_s32 > 0) {
+          tmp_s16 = (int16_t) WebRtcSpl_DivW32W16(tmp1_s32, nsk);
+        } else {
+          tmp_s16 = (int16_t) WebRtcSpl_DivW32W16(-tmp1_s32, nsk);
+          tmp_s16 = -tmp_s16;
+        }
+        tmp_s16 += 32;  // Rounding
+        nsk += tmp_s16 >> 6;  // Q13 >> 6 = Q7.
+        if (nsk < kMinStd) {
+          nsk = kMinStd;
+        }
+        self->noise_stds[gaussian] = nsk;
+      }
+    }
+
+    // Separate models if they are too close.
+    // |noise_global_mean| in Q14 (= Q7 * Q7).
+    noise_global_mean = WeightedAverage(&self->noise_means[channel], 0,
+                                        &kNoiseDataWeights[channel]);
+
+    // |speech_global_mean| in Q14 (= Q7 * Q7).
+    speech_global_mean = WeightedAverage(&self->speech_means[channel], 0,
+                                         &kSpeechDataWeights[channel]);
+
+    // |diff| = "global" speech mean - "global" noise mean.
+    // (Q14 >> 9) - (Q14 >> 9) = Q5.
+    diff = (int16_t) (speech_global_mean >> 9) -
+        (int16_t) (noise_global_mean >> 9);
+    if (diff < kMinimumDifference[channel]) {
+      tmp_s16 = kMinimumDifference[channel] - diff;
+
+      // |tmp1_s16| = ~0.8 * (kMinimumDifference - diff) in Q7.
+      // |tmp2_s16| = ~0.2 * (kMinimumDifference - diff) in Q7.
+      tmp1_s16 = (int16_t) WEBRTC_SPL_MUL_16_16_RSFT(13, tmp_s16, 2);
+      tmp2_s16 = (int16_t) WEBRTC_SPL_MUL_16_16_RSFT(3, tmp_s16, 2);
+
+      // Move Gaussian means for speech model by |tmp1_s16| and update
+      // |speech_global_mean|. Note that |self->speech_means[channel]| is
+      // changed after the call.
+      speech_global_mean = WeightedAverage(&self->speech_means[channel],
+                                           tmp1_s16,
+                                           &kSpeechDataWeights[channel]);
+
+      // Move Gaussian means for noise model by -|tmp2_s16| and update
+      // |noise_global_mean|. Note that |self->noise_means[channel]| is
+      // changed after the call.
+      noise_global_mean = WeightedAverage(&self->noise_means[channel],
+                                          -tmp2_s16,
+                                          &kNoiseDataWeights[channel]);
+    }
+
+    // Control that the speech & noise means do not drift to much.
+    maxspe = kMaximumSpeech[channel];
+    tmp2_s16 = (int16_t) (speech_global_mean >> 7);
+    if (tmp2_s16 > maxspe) {
+      // Upper limit of speech model.
+      tmp2_s16 -= maxspe;
+
+      for (k = 0; k < kNumGaussians; k++) {
+        self->speech_means[channel + k * kNumChannels] -= tmp2_s16;
       }
+    }
 
-      // Calculate local speech probabilities used later when updating the GMM.
-      h1 = (int16_t) (h1_test >> 12);  // Q15
-      if (h1 > 0) {
-        // High probability of speech. Assign conditional probabilities for each
-        // Gaussian in the GMM. Otherwise use the initialized values, i.e., 0.
-        tmp1_s32 = (speech_probability[0] & 0xFFFFF000) << 2;  // Q29
-        sgprvec[channel] = (int16_t) WebRtcSpl_DivW32W16(tmp1_s32, h1);  // Q14
-        sgprvec[channel + kNumChannels] = 16384 - sgprvec[channel];
+    tmp2_s16 = (int16_t) (noise_global_mean >> 7);
+    if (tmp2_s16 > kMaximumNoise[channel]) {
+      tmp2_s16 -= kMaximumNoise[channel];
+
+      for (k = 0; k < kNumGaussians; k++) {
+        self->noise_means[channel + k * kNumChannels] -= tmp2_s16;
       }
     }
+  }
+}
 
-    // Make a global VAD decision.
-    vadflag |= (sum_log_likelihood_ratios >= totalTest);
+// Returns the index of |frame_length| (80, 160 or 240 samples) in the mode
+// tables.
+static int LengthIndex(int frame_length) {
+  if (frame_length == 80) {
+    return 0;
+  } else if (frame_length == 160) {
+    return 1;
+  }
+  return 2;
+}
 
-    // Update the model parameters.
-    maxspe = 12800;
-    for (channel = 0; channel < kNumChannels; channel++) {
+// Returns the largest absolute difference between |a| and |b|.
+static int16_t MaxAbsDifference(const int16_t* a, const int16_t* b,
+                                int length) {
+  int i;
+  int16_t maximum = 0;
 
-      // Get minimum value in past which is used for long term correction in Q4.
-      feature_minimum = WebRtcVad_FindMinimum(self, features[channel], channel);
+  for (i = 0; i < length; i++) {
+    int16_t difference = (int16_t) abs(a[i] - b[i]);
+    if (difference > maximum) {
+      maximum = difference;
+    }
+  }
+  return maximum;
+}
 
-      // Compute the "global" mean, that is the sum of the two means weighted.
-      noise_global_mean = WeightedAverage(&self->noise_means[channel], 0,
-                                          &kNoiseDataWeights[channel]);
-      tmp1_s16 = (int16_t) (noise_global_mean >> 6);  // Q8
+// Decides whether the GMM should be adapted for the current frame. With the
+// default |adapt_interval| of one every frame is used. Otherwise updates are
+// skipped on stationary channels, that is, as long as the decision equals
+// the one of the last update and (if |adapt_drift_threshold| is set) the
+// last update moved the noise means less than the threshold. At least every
+// |adapt_interval|th frame updates the model.
+static int ModelUpdateDue(const VadInstT* self, int16_t vadflag) {
+  if (self->adapt_interval <= 1) {
+    return 1;
+  }
+  if (vadflag != self->last_update_vad) {
+    return 1;
+  }
+  if (self->frames_since_update + 1 >= self->adapt_interval) {
+    return 1;
+  }
+  if (self->adapt_drift_threshold > 0 &&
+      self->last_update_drift > self->adapt_drift_threshold) {
+    return 1;
+  }
+  return 0;
+}
 
-      for (k = 0; k < kNumGaussians; k++) {
-        gaussian = channel + k * kNumChannels;
-
-        nmk = self->noise_means[gaussian];
-        smk = self->speech_means[gaussian];
-        nsk = self->noise_stds[gaussian];
-        ssk = self->speech_stds[gaussian];
-
-        // Update noise mean vector if the frame consists of noise only.
-        nmk2 = nmk;
-        if (!vadflag) {
-          // deltaN = (x-mu)/sigma^2
-          // ngprvec[k] = |noise_probability[k]| /
-          //   (|noise_probability[0]| + |noise_probability[1]|)
-
-          // (Q14 * Q11 >> 11) = Q14.
-          delt = (int16_t) WEBRTC_SPL_MUL_16_16_RSFT(ngprvec[gaussian],
-                                                     deltaN[gaussian],
-                                                     11);
-          // Q7 + (Q14 * Q15 >> 22) = Q7.
-          nmk2 = nmk + (int16_t) WEBRTC_SPL_MUL_16_16_RSFT(delt,
-                                                           kNoiseUpdateConst,
-                                                           22);
-        }
+// Calculates the probabilities for both speech and background noise using
+// Gaussian Mixture Models (GMM). A hypothesis-test is performed to decide which
+// type of signal is most probable.
+//
+// - self           [i]   : Pointer to VAD instance
+// - features       [i]   : Feature vector of length |kNumChannels|
+//                          = log10(energy in frequency band)
+// - frame_length   [i]   : Number of input samples
+// - deltaN         [o]   : Noise model deltas, for UpdateModel().
+// - deltaS         [o]   : Speech model deltas, for UpdateModel().
+// - ngprvec        [o]   : Conditional noise probabilities per Gaussian.
+// - sgprvec        [o]   : Conditional speech probabilities per Gaussian.
+//
+// - returns              : the raw VAD decision (0 - noise, 1 - speech).
+static int16_t EvaluateGmm(const VadInstT* self, const int16_t* features,
+                           int frame_length, int16_t* deltaN, int16_t* deltaS,
+                           int16_t* ngprvec, int16_t* sgprvec) {
+  int channel, k;
+  int16_t h0, h1;
+  int16_t log_likelihood_ratio;
+  int16_t vadflag = 0;
+  int16_t shifts_h0, shifts_h1;
+  int gaussian;
+  int32_t h0_test, h1_test;
+  int32_t tmp1_s32;
+  int32_t sum_log_likelihood_ratios = 0;
+  int32_t noise_probability[kNumGaussians], speech_probability[kNumGaussians];
+  int16_t individualTest, totalTest;
+  const VadModeTable* thresholds = &kModeTables[self->mode];
+  const int length_index = LengthIndex(frame_length);
 
-        // Long term correction of the noise mean.
-        // Q8 - Q8 = Q8.
-        ndelt = (feature_minimum << 4) - tmp1_s16;
-        // Q7 + (Q8 * Q8) >> 9 = Q7.
-        nmk3 = nmk2 + (int16_t) WEBRTC_SPL_MUL_16_16_RSFT(ndelt, kBackEta, 9);
+  // Set various thresholds based on frame lengths (80, 160 or 240 samples).
+  individualTest = thresholds->individual[length_index];
+  totalTest = thresholds->total[length_index];
+
+  // Conditional probability = 0.
+  memset(ngprvec, 0, kTableSize * sizeof(*ngprvec));
+  memset(sgprvec, 0, kTableSize * sizeof(*sgprvec));
+
+  // The detection scheme is an LRT with hypothesis
+  // H0: Noise
+  // H1: Speech
+  //
+  // We combine a global LRT with local tests, for each frequency sub-band,
+  // here defined as |channel|.
+  for (channel = 0; channel < kNumChannels; channel++) {
+    // For each channel we model the probability with a GMM consisting of
+    // |kNumGaussians|, with different means and standard deviations depending
+    // on H0 or H1.
+    h0_test = 0;
+    h1_test = 0;
+    for (k = 0; k < kNumGaussians; k++) {
+      gaussian = channel + k * kNumChannels;
+      // Probability under H0, that is, probability of frame being noise.
+      // Value given in Q27 = Q7 * Q20.
+      tmp1_s32 = WebRtcVad_GaussianProbability(features[channel],
+                                               self->noise_means[gaussian],
+                                               self->noise_stds[gaussian],
+                                               &deltaN[gaussian]);
+      noise_probability[k] = kNoiseDataWeights[gaussian] * tmp1_s32;
+      h0_test += noise_probability[k];  // Q27
+
+      // Probability under H1, that is, probability of frame being speech.
+      // Value given in Q27 = Q7 * Q20.
+      tmp1_s32 = WebRtcVad_GaussianProbability(features[channel],
+                                               self->speech_means[gaussian],
+                                               self->speech_stds[gaussian],
+                                               &deltaS[gaussian]);
+      speech_probability[k] = kSpeechDataWeights[gaussian] * tmp1_s32;
+      h1_test += speech_probability[k];  // Q27
+    }
 
-        // Control that the noise mean does not drift to much.
-        tmp_s16 = (int16_t) ((k + 5) << 7);
-        if (nmk3 < tmp_s16) {
-          nmk3 = tmp_s16;
-        }
-        tmp_s16 = (int16_t) ((72 + k - channel) << 7);
-        if (nmk3 > tmp_s16) {
-          nmk3 = tmp_s16;
-        }
-        self->noise_means[gaussian] = nmk3;
-
-        if (vadflag) {
-          // Update speech mean vector:
-          // |deltaS| = (x-mu)/sigma^2
-          // sgprvec[k] = |speech_probability[k]| /
-          //   (|speech_probability[0]| + |speech_probability[1]|)
-
-          // (Q14 * Q11) >> 11 = Q14.
-          delt = (int16_t) WEBRTC_SPL_MUL_16_16_RSFT(sgprvec[gaussian],
-                                                     deltaS[gaussian],
-                                                     11);
-          // Q14 * Q15 >> 21 = Q8.
-          tmp_s16 = (int16_t) WEBRTC_SPL_MUL_16_16_RSFT(delt,
-                                                        kSpeechUpdateConst,
-                                                        21);
-          // Q7 + (Q8 >> 1) = Q7. With rounding.
-          smk2 = smk + ((tmp_s16 + 1) >> 1);
-
-          // Control that the speech mean does not drift to much.
-          maxmu = maxspe + 640;
-          if (smk2 < kMinimumMean[k]) {
-            smk2 = kMinimumMean[k];
-          }
-          if (smk2 > maxmu) {
-            smk2 = maxmu;
-          }
-          self->speech_means[gaussian] = smk2;  // Q7.
-
-          // (Q7 >> 3) = Q4. With rounding.
-          tmp_s16 = ((smk + 4) >> 3);
-
-          tmp_s16 = features[channel] - tmp_s16;  // Q4
-          // (Q11 * Q4 >> 3) = Q12.
-          tmp1_s32 = WEBRTC_SPL_MUL_16_16_RSFT(deltaS[gaussian], tmp_s16, 3);
-          tmp2_s32 = tmp1_s32 - 4096;
-          tmp_s16 = sgprvec[gaussian] >> 2;
-          // (Q14 >> 2) * Q12 = Q24.
-          tmp1_s32 = tmp_s16 * tmp2_s32;
-
-          tmp2_s32 = tmp1_s32 >> 4;  // Q20
-
-          // 0.1 * Q20 / Q7 = Q13.
-          if (tmp2_s32 > 0) {
-            tmp_s16 = (int16_t) WebRtcSpl_DivW32W16(tmp2_s32, ssk * 10);
-          } else {
-            tmp_s16 = (int16_t) WebRtcSpl_DivW32W16(-tmp2_s32, ssk * 10);
-            tmp_s16 = -tmp_s16;
-          }
-          // Divide by 4 giving an update factor of 0.025 (= 0.1 / 4).
-          // Note that division by 4 equals shift by 2, hence,
-          // (Q13 >> 8) = (Q13 >> 6) / 4 = Q7.
-          tmp_s16 += 128;  // Rounding.
-          ssk += (tmp_s16 >> 8);
-          if (ssk < kMinStd) {
-            ssk = kMinStd;
-          }
-          self->speech_stds[gaussian] = ssk;
-        } else {
-          // Update GMM variance vectors.
-          // deltaN * (features[channel] - nmk) - 1
-          // Q4 - (Q7 >> 3) = Q4.
-          tmp_s16 = features[channel] - (nmk >> 3);
-          // (Q11 * Q4 >> 3) = Q12.
-          tmp1_s32 = WEBRTC_SPL_MUL_16_16_RSFT(deltaN[gaussian], tmp_s16, 3);
-          tmp1_s32 -= 4096;
-
-          // (Q14 >> 2) * Q12 = Q24.
-          tmp_s16 = (ngprvec[gaussian] + 2) >> 2;
-          tmp2_s32 = tmp_s16 * tmp1_s32;
-          // Q20  * approx 0.001 (2^-10=0.0009766), hence,
-          // (Q24 >> 14) = (Q24 >> 4) / 2^10 = Q20.
-          tmp1_s32 = tmp2_s32 >> 14;
-
-          // Q20 / Q7 = Q13.
-          if (tmp1_s32 > 0) {
-            tmp_s16 = (int16_t) WebRtcSpl_DivW32W16(tmp1_s32, nsk);
-          } else {
-            tmp_s16 = (int16_t) WebRtcSpl_DivW32W16(-tmp1_s32, nsk);
-            tmp_s16 = -tmp_s16;
-          }
-          tmp_s16 += 32;  // Rounding
-          nsk += tmp_s16 >> 6;  // Q13 >> 6 = Q7.
-          if (nsk < kMinStd) {
-            nsk = kMinStd;
-          }
-          self->noise_stds[gaussian] = nsk;
-        }
-      }
+    // Calculate the log likelihood ratio: log2(Pr{X|H1} / Pr{X|H1}).
+    // Approximation:
+    // log2(Pr{X|H1} / Pr{X|H1}) = log2(Pr{X|H1}*2^Q) - log2(Pr{X|H1}*2^Q)
+    //                           = log2(h1_test) - log2(h0_test)
+    //                           = log2(2^(31-shifts_h1)*(1+b1))
+    //                             - log2(2^(31-shifts_h0)*(1+b0))
+    //                           = shifts_h0 - shifts_h1
+    //                             + log2(1+b1) - log2(1+b0)
+    //                          ~= shifts_h0 - shifts_h1
+    //
+    // Note that b0 and b1 are values less than 1, hence, 0 <= log2(1+b0) < 1.
+    // Further, b0 and b1 are independent and on the average the two terms
+    // cancel.
+    shifts_h0 = WebRtcSpl_NormW32(h0_test);
+    shifts_h1 = WebRtcSpl_NormW32(h1_test);
+    if (h0_test == 0) {
+      shifts_h0 = 31;
+    }
+    if (h1_test == 0) {
+      shifts_h1 = 31;
+    }
+    log_likelihood_ratio = shifts_h0 - shifts_h1;
 
-      // Separate models if they are too close.
-      // |noise_global_mean| in Q14 (= Q7 * Q7).
-      noise_global_mean = WeightedAverage(&self->noise_means[channel], 0,
-                                          &kNoiseDataWeights[channel]);
+    // Update |sum_log_likelihood_ratios| with spectrum weighting. This is
+    // used for the global VAD decision.
+    sum_log_likelihood_ratios +=
+        (int32_t) (log_likelihood_ratio * kSpectrumWeight[channel]);
 
-      // |speech_global_mean| in Q14 (= Q7 * Q7).
-      speech_global_mean = WeightedAverage(&self->speech_means[channel], 0,
-                                           &kSpeechDataWeights[channel]);
+    // Local VAD decision.
+    if ((log_likelihood_ratio << 2) > individualTest) {
+      vadflag = 1;
+    }
 
-      // |diff| = "global" speech mean - "global" noise mean.
-      // (Q14 >> 9) - (Q14 >> 9) = Q5.
-      diff = (int16_t) (speech_global_mean >> 9) -
-          (int16_t) (noise_global_mean >> 9);
-      if (diff < kMinimumDifference[channel]) {
-        tmp_s16 = kMinimumDifference[channel] - diff;
-
-        // |tmp1_s16| = ~0.8 * (kMinimumDifference - diff) in Q7.
-        // |tmp2_s16| = ~0.2 * (kMinimumDifference - diff) in Q7.
-        tmp1_s16 = (int16_t) WEBRTC_SPL_MUL_16_16_RSFT(13, tmp_s16, 2);
-        tmp2_s16 = (int16_t) WEBRTC_SPL_MUL_16_16_RSFT(3, tmp_s16, 2);
-
-        // Move Gaussian means for speech model by |tmp1_s16| and update
-        // |speech_global_mean|. Note that |self->speech_means[channel]| is
-        // changed after the call.
-        speech_global_mean = WeightedAverage(&self->speech_means[channel],
-                                             tmp1_s16,
-                                             &kSpeechDataWeights[channel]);
-
-        // Move Gaussian means for noise model by -|tmp2_s16| and update
-        // |noise_global_mean|. Note that |self->noise_means[channel]| is
-        // changed after the call.
-        noise_global_mean = WeightedAverage(&self->noise_means[channel],
-                                            -tmp2_s16,
-                                            &kNoiseDataWeights[channel]);
-      }
+    // TODO(bjornv): The conditional probabilities below are applied on the
+    // hard coded number of Gaussians set to two. Find a way to generalize.
+    // Calculate local noise probabilities used later when updating the GMM.
+    h0 = (int16_t) (h0_test >> 12);  // Q15
+    if (h0 > 0) {
+      // High probability of noise. Assign conditional probabilities for each
+      // Gaussian in the GMM.
+      tmp1_s32 = (noise_probability[0] & 0xFFFFF000) << 2;  // Q29
+      ngprvec[channel] = (int16_t) WebRtcSpl_DivW32W16(tmp1_s32, h0);  // Q14
+      ngprvec[channel + kNumChannels] = 16384 - ngprvec[channel];
+    } else {
+      // Low noise probability. Assign conditional probability 1 to the first
+      // Gaussian and 0 to the rest (which is already set at initialization).
+      ngprvec[channel] = 16384;
+    }
+
+    // Calculate local speech probabilities used later when updating the GMM.
+    h1 = (int16_t) (h1_test >> 12);  // Q15
+    if (h1 > 0) {
+      // High probability of speech. Assign conditional probabilities for each
+      // Gaussian in the GMM. Otherwise use the initialized values, i.e., 0.
+      tmp1_s32 = (speech_probability[0] & 0xFFFFF000) << 2;  // Q29
+      sgprvec[channel] = (int16_t) WebRtcSpl_DivW32W16(tmp1_s32, h1);  // Q14
+      sgprvec[channel + kNumChannels] = 16384 - sgprvec[channel];
+    }
+  }
 
-      // Control that the speech & noise means do not drift to much.
-      maxspe = kMaximumSpeech[channel];
-      tmp2_s16 = (int16_t) (speech_global_mean >> 7);
-      if (tmp2_s16 > maxspe) {
-        // Upper limit of speech model.
-        tmp2_s16 -= maxspe;
+  // Make a global VAD decision.
+  vadflag |= (sum_log_likelihood_ratios >= totalTest);
 
-        for (k = 0; k < kNumGaussians; k++) {
-          self->speech_means[channel + k * kNumChannels] -= tmp2_s16;
-        }
-      }
+  return vadflag;
+}
 
-      tmp2_s16 = (int16_t) (noise_global_mean >> 7);
-      if (tmp2_s16 > kMaximumNoise[channel]) {
-        tmp2_s16 -= kMaximumNoise[channel];
+// Updates the model parameters for a frame with enough energy, unless the
+// adaptation control allows this frame to be skipped. The arguments are as
+// for UpdateModel().
+static void AdaptModel(VadInstT* self, const int16_t* features,
+                       int16_t vadflag, const int16_t* deltaN,
+                       const int16_t* deltaS, const int16_t* ngprvec,
+                       const int16_t* sgprvec) {
+  int16_t previous_noise_means[kTableSize];
+
+  if (ModelUpdateDue(self, vadflag)) {
+    if (self->adapt_drift_threshold > 0) {
+      memcpy(previous_noise_means, self->noise_means,
+             sizeof(previous_noise_means));
+    }
+    UpdateModel(self, features, vadflag, deltaN, deltaS, ngprvec, sgprvec);
+    if (self->adapt_drift_threshold > 0) {
+      self->last_update_drift = MaxAbsDifference(previous_noise_means,
+                                                 self->noise_means,
+                                                 kTableSize);
+    }
+    self->frames_since_update = 0;
+    self->last_update_vad = vadflag;
+    self->model_updates++;
+    VAD_STATS_ADD(self, model_updates, 1);
+    // Arguments: instance, decision the model adapted to, noise mean drift.
+    VAD_PROBE3(model_update, self, vadflag, self->last_update_drift);
+  } else {
+    self->frames_since_update++;
+    self->model_updates_skipped++;
+    VAD_STATS_ADD(self, model_updates_skipped, 1);
+    VAD_PROBE2(model_update_skipped, self, self->frames_since_update);
+  }
+  self->frame_counter++;
+}
 
-        for (k = 0; k < kNumGaussians; k++) {
-          self->noise_means[channel + k * kNumChannels] -= tmp2_s16;
-        }
-      }
+// Calculates the VAD decision of a frame, adapts the model to it and applies
+// the hangover.
+//
+// - self           [i/o] : Pointer to VAD instance
+// - features       [i]   : Feature vector of length |kNumChannels|
+//                          = log10(energy in frequency band)
+// - total_power    [i]   : Total power in audio frame.
+// - frame_length   [i]   : Number of input samples
+//
+// - returns              : the VAD decision (0 - noise, 1 - speech).
+static int16_t GmmProbability(VadInstT* self, int16_t* features,
+                              int16_t total_power, int frame_length) {
+  int16_t vadflag = 0;
+  int16_t deltaN[kTableSize], deltaS[kTableSize];
+  int16_t ngprvec[kTableSize], sgprvec[kTableSize];
+  VAD_STAGE_TIMER(start);
+
+  if (total_power > kMinEnergy) {
+    // The signal power of current frame is large enough for processing. The
+    // processing consists of two parts:
+    // 1) Calculating the likelihood of speech and thereby a VAD decision.
+    // 2) Updating the underlying model, w.r.t., the decision made.
+    VAD_STAGE_START(start);
+    vadflag = EvaluateGmm(self, features, frame_length, deltaN, deltaS,
+                          ngprvec, sgprvec);
+    VAD_STAGE_STOP(self, kVadStageLikelihood, start);
+    VAD_STAGE_START(start);
+    AdaptModel(self, features, vadflag, deltaN, deltaS, ngprvec, sgprvec);
+    VAD_STAGE_STOP(self, kVadStageUpdate, start);
+  } else {
+    VAD_STATS_ADD(self, low_energy_frames, 1);
+  }
+
+  return WebRtcVad_SmoothDecision(self, vadflag, frame_length);
+}
+
+void WebRtcVad_AdaptToNoise(VadInstT* self, const int16_t* features,
+                            int frame_length) {
+  int16_t deltaN[kTableSize], deltaS[kTableSize];
+  int16_t ngprvec[kTableSize], sgprvec[kTableSize];
+  float features_db[kNumChannels];
+  int i;
+
+  if (self->engine == kVadEngineFloat) {
+    for (i = 0; i < kNumChannels; i++) {
+      features_db[i] = features[i] / 16.f;  // Q4 -> dB.
     }
-    self->frame_counter++;
+    WebRtcVad_AdaptToNoiseFloat(self, features_db, frame_length);
+    return;
   }
 
+  // Only the deltas and conditional probabilities are needed, the decision
+  // is overridden.
+  EvaluateGmm(self, features, frame_length, deltaN, deltaS, ngprvec, sgprvec);
+  AdaptModel(self, features, 0, deltaN, deltaS, ngprvec, sgprvec);
+}
+
+int16_t WebRtcVad_SmoothDecision(VadInstT* self, int16_t vadflag,
+                                 int frame_length) {
+  const VadModeTable* thresholds = &kModeTables[self->mode];
+  const int length_index = LengthIndex(frame_length);
+
   // Smooth with respect to transition hysteresis.
   if (!vadflag) {
     if (self->over_hang > 0) {
       vadflag = 2 + self->over_hang;
       self->over_hang--;
+      VAD_STATS_ADD(self, hangover_frames, 1);
     }
     self->num_of_speech = 0;
   } else {
     self->num_of_speech++;
     if (self->num_of_speech > kMaxSpeechFrames) {
       self->num_of_speech = kMaxSpeechFrames;
-      self->over_hang = overhead2;
+      self->over_hang = thresholds->over_hang_max_2[length_index];
     } else {
-      self->over_hang = overhead1;
+      self->over_hang = thresholds->over_hang_max_1[length_index];
     }
   }
+  self->vad = vadflag;
   return vadflag;
 }
 
@@ -2749,8 +4755,11 @@ int WebRtcVad_InitCore(VadInstT* self) {
   memset(self->downsampling_filter_states, 0,
          sizeof(self->downsampling_filter_states));
 
-  // Initialization of 48 to 8 kHz downsampling.
-  WebRtcSpl_ResetResample48khzTo8khz(&self->state_48_to_8);
+  // Initialization of 48 to 8 kHz downsampling, if this instance has been
+  // used at 48 kHz. Otherwise the state is set up on the first 48 kHz frame.
+  if (self->state_48_to_8 != NULL) {
+    WebRtcSpl_ResetResample48khzTo8khz(self->state_48_to_8);
+  }
 
   // Read initial PDF parameters.
   for (i = 0; i < kTableSize; i++) {
@@ -2778,6 +4787,34 @@ int WebRtcVad_InitCore(VadInstT* self) {
     self->mean_value[i] = 1600;
   }
 
+  // Exact skip of silent frames only.
+  self->silence_skip = 1;
+  self->silence_threshold = 0;
+  self->zero_input_key = 0;
+
+  // Adapt the model on every frame.
+  self->adapt_interval = 1;
+  self->adapt_drift_threshold = 0;
+  self->frames_since_update = 0;
+  self->last_update_vad = 0;
+  self->last_update_drift = 0;
+  self->model_updates = 0;
+  self->model_updates_skipped = 0;
+
+  // Filter bank features.
+  self->feature_mode = kVadFeaturesFilterBank;
+  self->num_high_bands = 0;
+  memset(self->high_band_features, 0, sizeof(self->high_band_features));
+
+  // Fixed point arithmetic.
+  self->engine = kVadEngineFixed;
+  if (self->float_state != NULL) {
+    memset(self->float_state, 0, sizeof(*self->float_state));
+  }
+#if defined(WEBRTC_VAD_STATS)
+  memset(&self->stats, 0, sizeof(self->stats));
+#endif
+
   // Set aggressiveness mode to default (=|kDefaultMode|).
   if (WebRtcVad_set_mode_core(self, kDefaultMode) != 0) {
     return -1;
@@ -2790,66 +4827,20 @@ int WebRtcVad_InitCore(VadInstT* self) {
 
 // Set aggressiveness mode
 int WebRtcVad_set_mode_core(VadInstT* self, int mode) {
-  int return_value = 0;
-
-  switch (mode) {
-    case 0:
-      // Quality mode.
-      memcpy(self->over_hang_max_1, kOverHangMax1Q,
-             sizeof(self->over_hang_max_1));
-      memcpy(self->over_hang_max_2, kOverHangMax2Q,
-             sizeof(self->over_hang_max_2));
-      memcpy(self->individual, kLocalThresholdQ,
-             sizeof(self->individual));
-      memcpy(self->total, kGlobalThresholdQ,
-             sizeof(self->total));
-      break;
-    case 1:
-      // Low bitrate mode.
-      memcpy(self->over_hang_max_1, kOverHangMax1LBR,
-             sizeof(self->over_hang_max_1));
-      memcpy(self->over_hang_max_2, kOverHangMax2LBR,
-             sizeof(self->over_hang_max_2));
-      memcpy(self->individual, kLocalThresholdLBR,
-             sizeof(self->individual));
-      memcpy(self->total, kGlobalThresholdLBR,
-             sizeof(self->total));
-      break;
-    case 2:
-      // Aggressive mode.
-      memcpy(self->over_hang_max_1, kOverHangMax1AGG,
-             sizeof(self->over_hang_max_1));
-      memcpy(self->over_hang_max_2, kOverHangMax2AGG,
-             sizeof(self->over_hang_max_2));
-      memcpy(self->individual, kLocalThresholdAGG,
-             sizeof(self->individual));
-      memcpy(self->total, kGlobalThresholdAGG,
-             sizeof(self->total));
-      break;
-    case 3:
-      // Very aggressive mode.
-      memcpy(self->over_hang_max_1, kOverHangMax1VAG,
-             sizeof(self->over_hang_max_1));
-      memcpy(self->over_hang_max_2, kOverHangMax2VAG,
-             sizeof(self->over_hang_max_2));
-      memcpy(self->individual, kLocalThresholdVAG,
-             sizeof(self->individual));
-      memcpy(self->total, kGlobalThresholdVAG,
-             sizeof(self->total));
-      break;
-    default:
-      return_value = -1;
-      break;
+  if (mode < 0 || mode >= kNumModes) {
+    return -1;
   }
 
-  return return_value;
+  self->mode = (int16_t) mode;
+
+  return 0;
 }
 
 // Calculate VAD decision by first extracting feature values and then calculate
 // probability for both speech and background noise.
 
-int WebRtcVad_CalcVad48khz(VadInstT* inst, int16_t* speech_frame,
-                           int frame_length) {
+int WebRtcVad_CalcVad48khz(VadInstT* inst, const int16_t* speech_frame,
+                           int stride, int frame_length) {
   int vad;
   int i;
   int16_t speech_nb[240];  // 30 ms in 8 kHz.
@@ -2859,66 +4850,103 @@ int WebRtcVad_CalcVad48khz(VadInstT* inst, int16_t* speech_frame,
   const int kFrameLen10ms48khz = 480;
   const int kFrameLen10ms8khz = 80;
   int num_10ms_frames = frame_length / kFrameLen10ms48khz;
+  VAD_STAGE_TIMER(start);
 
+  if (inst->state_48_to_8 == NULL) {
+    inst->state_48_to_8 = (WebRtcSpl_State48khzTo8khz*)
+        malloc(sizeof(WebRtcSpl_State48khzTo8khz));
+    if (inst->state_48_to_8 == NULL) {
+      return -1;
+    }
+    WebRtcSpl_ResetResample48khzTo8khz(inst->state_48_to_8);
+  }
+
+  VAD_STAGE_START(start);
   for (i = 0; i < num_10ms_frames; i++) {
-    WebRtcSpl_Resample48khzTo8khz(speech_frame,
-                                  &speech_nb[i * kFrameLen10ms8khz],
-                                  &inst->state_48_to_8,
-                                  tmp_mem);
+    Resample48khzTo8khzStrided(speech_frame, stride,
+                               &speech_nb[i * kFrameLen10ms8khz],
+                               inst->state_48_to_8, tmp_mem);
   }
+  VAD_STAGE_STOP(inst, kVadStageResample, start);
 
   // Do VAD on an 8 kHz signal
-  vad = WebRtcVad_CalcVad8khz(inst, speech_nb, frame_length / 6);
+  vad = WebRtcVad_CalcVad8khz(inst, speech_nb, 1, frame_length / 6);
 
   return vad;
 }
 
-int WebRtcVad_CalcVad32khz(VadInstT* inst, int16_t* speech_frame,
-                           int frame_length)
+int WebRtcVad_CalcVad32khz(VadInstT* inst, const int16_t* speech_frame,
+                           int stride, int frame_length)
 {
     int len, vad;
     int16_t speechWB[480]; // Downsampled speech frame: 960 samples (30ms in SWB)
     int16_t speechNB[240]; // Downsampled speech frame: 480 samples (30ms in WB)
+    VAD_STAGE_TIMER(start);
 
 
     // Downsample signal 32->16->8 before doing VAD
-    WebRtcVad_Downsampling(speech_frame, speechWB, &(inst->downsampling_filter_states[2]),
+    VAD_STAGE_START(start);
+    WebRtcVad_Downsampling(speech_frame, stride, speechWB,
+                           &(inst->downsampling_filter_states[2]),
                            frame_length);
     len = WEBRTC_SPL_RSHIFT_W16(frame_length, 1);
 
-    WebRtcVad_Downsampling(speechWB, speechNB, inst->downsampling_filter_states, len);
+    WebRtcVad_Downsampling(speechWB, 1, speechNB,
+                           inst->downsampling_filter_states, len);
     len = WEBRTC_SPL_RSHIFT_W16(len, 1);
+    VAD_STAGE_STOP(inst, kVadStageResample, start);
 
     // Do VAD on an 8 kHz signal
-    vad = WebRtcVad_CalcVad8khz(inst, speechNB, len);
+    vad = WebRtcVad_CalcVad8khz(inst, speechNB, 1, len);
 
     return vad;
 }
 
-int WebRtcVad_CalcVad16khz(VadInstT* inst, int16_t* speech_frame,
-                           int frame_length)
+int WebRtcVad_CalcVad16khz(VadInstT* inst, const int16_t* speech_frame,
+                           int stride, int frame_length)
 {
     int len, vad;
     int16_t speechNB[240]; // Downsampled speech frame: 480 samples (30ms in WB)
+    VAD_STAGE_TIMER(start);
 
     // Wideband: Downsample signal before doing VAD
-    WebRtcVad_Downsampling(speech_frame, speechNB, inst->downsampling_filter_states,
-                           frame_length);
+    VAD_STAGE_START(start);
+    WebRtcVad_Downsampling(speech_frame, stride, speechNB,
+                           inst->downsampling_filter_states, frame_length);
+    VAD_STAGE_STOP(inst, kVadStageResample, start);
 
     len = WEBRTC_SPL_RSHIFT_W16(frame_length, 1);
-    vad = WebRtcVad_CalcVad8khz(inst, speechNB, len);
+    vad = WebRtcVad_CalcVad8khz(inst, speechNB, 1, len);
 
     return vad;
 }
 
-int WebRtcVad_CalcVad8khz(VadInstT* inst, int16_t* speech_frame,
-                          int frame_length)
+int WebRtcVad_CalcVad8khz(VadInstT* inst, const int16_t* speech_frame,
+                          int stride, int frame_length)
 {
     int16_t feature_vector[kNumChannels], total_power;
+    float features_db[kNumChannels], total_power_float;
+    VAD_STAGE_TIMER(start);
+
+    if (inst->engine == kVadEngineFloat) {
+      VAD_STAGE_START(start);
+      total_power_float = WebRtcVad_CalculateFeaturesFloat(inst, speech_frame,
+                                                           stride,
+                                                           frame_length,
+                                                           features_db);
+      VAD_STAGE_STOP(inst, kVadStageFeatures, start);
+
+      inst->vad = WebRtcVad_GmmProbabilityFloat(inst, features_db,
+                                                total_power_float,
+                                                frame_length);
+      return inst->vad;
+    }
 
     // Get power in the bands
-    total_power = WebRtcVad_CalculateFeatures(inst, speech_frame, frame_length,
-                                              feature_vector);
+    VAD_STAGE_START(start);
+    total_power = WebRtcVad_CalculateFeatures(inst, speech_frame, stride,
+                                              frame_length, feature_vector);
+    VAD_STAGE_STOP(inst, kVadStageFeatures, start);
 
     // Make a VAD
     inst->vad = GmmProbability(inst, feature_vector, total_power, frame_length);
@@ -2926,6 +4954,35 @@ int WebRtcVad_CalcVad8khz(VadInstT* inst, int16_t* speech_frame,
     return inst->vad;
 }
 
+int WebRtcVad_CalcVadSpectral(VadInstT* inst, int fs,
+                              const int16_t* speech_frame, int stride,
+                              int frame_length) {
+  int16_t feature_vector[kNumChannels], total_power;
+  float features_db[kNumChannels];
+  int i;
+  VAD_STAGE_TIMER(start);
+
+  VAD_STAGE_START(start);
+  total_power = WebRtcVad_CalculateSpectralFeatures(inst, fs, speech_frame,
+                                                    stride, frame_length,
+                                                    feature_vector);
+  VAD_STAGE_STOP(inst, kVadStageFeatures, start);
+
+  // The GMM works on frame lengths at 8 kHz.
+  if (inst->engine == kVadEngineFloat) {
+    for (i = 0; i < kNumChannels; i++) {
+      features_db[i] = feature_vector[i] / 16.f;  // Q4 -> dB.
+    }
+    inst->vad = WebRtcVad_GmmProbabilityFloat(inst, features_db, total_power,
+                                              frame_length / (fs / 8000));
+  } else {
+    inst->vad = GmmProbability(inst, feature_vector, total_power,
+                               frame_length / (fs / 8000));
+  }
+
+  return inst->vad;
+}
+
 
 #include <assert.h>
 
@@ -2985,102 +5042,99 @@ static void HighPassFilter(const int16_t* data_in, int data_length,
   }
 }
 
-// All pass filtering of |data_in|, used before splitting the signal into two
-// frequency bands (low pass vs high pass).
-// Note that |data_in| and |data_out| can NOT correspond to the same address.
+// One sample of a first order all pass section in the look-ahead form, see
+// SplitFilter(). |*previous| is the previous input in Q15 and is replaced by
+// |in|, |output| is the previous output.
 //
-// - data_in            [i]   : Input audio signal given in Q0.
-// - data_length        [i]   : Length of input and output data.
-// - filter_coefficient [i]   : Given in Q15.
-// - filter_state       [i/o] : State of the filter given in Q(-1).
-// - data_out           [o]   : Output audio signal given in Q(-1).
-static void AllPassFilter(const int16_t* data_in, int data_length,
-                          int16_t filter_coefficient, int16_t* filter_state,
-                          int16_t* data_out) {
-  // The filter can only cause overflow (in the w16 output variable)
-  // if more than 4 consecutive input numbers are of maximum value and
-  // has the the same sign as the impulse responses first taps.
-  // First 6 taps of the impulse response:
-  // 0.6399 0.5905 -0.3779 0.2418 -0.1547 0.0990
+// returns : The output for |in|.
+static __inline int32_t AllPassStep(int32_t coefficient, int16_t in,
+                                    uint32_t* previous, int32_t output) {
+  const uint32_t sum = *previous + (uint32_t) (coefficient * in);
 
-  int i;
-  int16_t tmp16 = 0;
-  int32_t tmp32 = 0;
-  int32_t state32 = ((int32_t) (*filter_state) << 16);  // Q15
-
-  for (i = 0; i < data_length; i++) {
-    tmp32 = state32 + WEBRTC_SPL_MUL_16_16(filter_coefficient, *data_in);
-    tmp16 = (int16_t) (tmp32 >> 16);  // Q(-1)
-    *data_out++ = tmp16;
-    state32 = (((int32_t) (*data_in)) << 14); // Q14
-    state32 -= WEBRTC_SPL_MUL_16_16(filter_coefficient, tmp16);  // Q14
-    state32 <<= 1;  // Q15.
-    data_in += 2;
-  }
+  *previous = (uint32_t) in << 15;
+  return (int32_t) (sum - (uint32_t) (2 * coefficient * output)) >> 16;
+}
 
-  *filter_state = (int16_t) (state32 >> 16);  // Q(-1)
+// The state in Q(-1) of an all pass section after AllPassStep() returned
+// |output|.
+static __inline int16_t AllPassState(int32_t coefficient, uint32_t previous,
+                                     int32_t output) {
+  return (int16_t) ((int32_t) (previous -
+      (uint32_t) (2 * coefficient * output)) >> 16);
 }
 
 // Splits |data_in| into |hp_data_out| and |lp_data_out| corresponding to
-// an upper (high pass) part and a lower (low pass) part respectively.
+// an upper (high pass) part and a lower (low pass) part respectively. The
+// even samples are all pass filtered by the upper branch and the odd ones by
+// the lower branch, the outputs are their difference and sum.
+//
+// Each branch is a first order all pass section, with the coefficient c in
+// Q15 and the state in Q(-1):
+//   y[n] = (state[n - 1] * 2^16 + c * x[n]) >> 16
+//   state[n] = ((x[n] * 2^14 - c * y[n]) * 2) >> 16
+// in 32-bit arithmetic. As y[n] only feeds back through the product with c,
+// the recurrence is evaluated in the look-ahead form
+//   y[n] = (x[n - 1] * 2^15 + c * x[n] - 2 * c * y[n - 1]) >> 16
+// where all but the last product are known in advance. The 32-bit wraparound
+// of the state is the same. This leaves a multiply, a subtract and a shift on
+// the serial path of each branch, and the two branches run interleaved.
+//
+// The filters can only cause overflow (in the w16 output variable) if more
+// than 4 consecutive input numbers are of maximum value and has the the same
+// sign as the impulse responses first taps.
+// First 6 taps of the impulse response of the upper branch:
+// 0.6399 0.5905 -0.3779 0.2418 -0.1547 0.0990
 //
 // - data_in      [i]   : Input audio data to be split into two frequency bands.
-// - data_length  [i]   : Length of |data_in|.
+// - in_stride    [i]   : Distance between the samples of |data_in|, 1 unless
+//                        it is a channel of interleaved input.
+// - data_length  [i]   : Number of samples of |data_in|.
 // - upper_state  [i/o] : State of the upper filter, given in Q(-1).
 // - lower_state  [i/o] : State of the lower filter, given in Q(-1).
 // - hp_data_out  [o]   : Output audio data of the upper half of the spectrum.
 //                        The length is |data_length| / 2.
 // - lp_data_out  [o]   : Output audio data of the lower half of the spectrum.
 //                        The length is |data_length| / 2.
-static void SplitFilter(const int16_t* data_in, int data_length,
-                        int16_t* upper_state, int16_t* lower_state,
-                        int16_t* hp_data_out, int16_t* lp_data_out) {
+static void SplitFilter(const int16_t* data_in, int in_stride,
+                        int data_length, int16_t* upper_state,
+                        int16_t* lower_state, int16_t* hp_data_out,
+                        int16_t* lp_data_out) {
+  const int32_t upper_coefficient = kAllPassCoefsQ15[0];
+  const int32_t lower_coefficient = kAllPassCoefsQ15[1];
   int i;
   int half_length = data_length >> 1;  // Downsampling by 2.
-  int16_t tmp_out;
+  int32_t upper = 0;  // Q(-1)
+  int32_t lower = 0;  // Q(-1)
+  // The previous input in Q15, before the first sample the filter state.
+  uint32_t upper_previous = (uint32_t) *upper_state << 16;
+  uint32_t lower_previous = (uint32_t) *lower_state << 16;
 
-  // All-pass filtering upper branch.
-  AllPassFilter(&data_in[0], half_length, kAllPassCoefsQ15[0], upper_state,
-                hp_data_out);
-
-  // All-pass filtering lower branch.
-  AllPassFilter(&data_in[1], half_length, kAllPassCoefsQ15[1], lower_state,
-                lp_data_out);
-
-  // Make LP and HP signals.
   for (i = 0; i < half_length; i++) {
-    tmp_out = *hp_data_out;
-    *hp_data_out++ -= *lp_data_out;
-    *lp_data_out++ += tmp_out;
+    upper = AllPassStep(upper_coefficient, data_in[2 * i * in_stride],
+                        &upper_previous, upper);
+    lower = AllPassStep(lower_coefficient, data_in[(2 * i + 1) * in_stride],
+                        &lower_previous, lower);
+
+    // Make LP and HP signals.
+    hp_data_out[i] = (int16_t) (upper - lower);
+    lp_data_out[i] = (int16_t) (upper + lower);
   }
+
+  *upper_state = AllPassState(upper_coefficient, upper_previous, upper);
+  *lower_state = AllPassState(lower_coefficient, lower_previous, lower);
 }
 
-// Calculates the energy of |data_in| in dB, and also updates an overall
-// |total_energy| if necessary.
+// Converts an energy of |energy| * 2^|tot_rshifts| to dB, and also updates an
+// overall |total_energy| if necessary, see LogOfEnergy().
 //
-// - data_in      [i]   : Input audio data for energy calculation.
-// - data_length  [i]   : Length of input data.
+// - energy       [i]   : Energy, in Q(-|tot_rshifts|).
+// - tot_rshifts  [i]   : Number of right shifts performed on |energy|.
 // - offset       [i]   : Offset value added to |log_energy|.
-// - total_energy [i/o] : An external energy updated with the energy of
-//                        |data_in|.
-//                        NOTE: |total_energy| is only updated if
-//                        |total_energy| <= |kMinEnergy|.
-// - log_energy   [o]   : 10 * log10("energy of |data_in|") given in Q4.
-static void LogOfEnergy(const int16_t* data_in, int data_length,
-                        int16_t offset, int16_t* total_energy,
-                        int16_t* log_energy) {
-  // |tot_rshifts| accumulates the number of right shifts performed on |energy|.
-  int tot_rshifts = 0;
-  // The |energy| will be normalized to 15 bits. We use unsigned integer because
-  // we eventually will mask out the fractional part.
-  uint32_t energy = 0;
-
-  assert(data_in != NULL);
-  assert(data_length > 0);
-
-  energy = (uint32_t) WebRtcSpl_Energy((int16_t*) data_in, data_length,
-                                       &tot_rshifts);
-
+// - total_energy [i/o] : An external energy updated with the energy.
+// - log_energy   [o]   : 10 * log10("energy") given in Q4.
+static void LogOfScaledEnergy(uint32_t energy, int tot_rshifts,
+                              int16_t offset, int16_t* total_energy,
+                              int16_t* log_energy) {
   if (energy != 0) {
     // By construction, normalizing to 15 bits is equivalent with 17 leading
     // zeros of an unsigned 32 bit value.
@@ -3152,14 +5206,46 @@ static void LogOfEnergy(const int16_t* data_in, int data_length,
       // By construction |energy| is represented by 15 bits, hence any number of
       // right shifted |energy| will fit in an int16_t. In addition, adding the
       // value to |total_energy| is wrap around safe as long as
-      // |kMinEnergy| < 8192.
-      *total_energy += (int16_t) (energy >> -tot_rshifts);  // Q0.
+      // |kMinEnergy| < 8192. Spectral energies can be scaled down by more
+      // than the width of |energy|.
+      if (tot_rshifts > -32) {
+        *total_energy += (int16_t) (energy >> -tot_rshifts);  // Q0.
+      }
     }
   }
 }
 
+// Calculates the energy of |data_in| in dB, and also updates an overall
+// |total_energy| if necessary.
+//
+// - data_in      [i]   : Input audio data for energy calculation.
+// - data_length  [i]   : Length of input data.
+// - offset       [i]   : Offset value added to |log_energy|.
+// - total_energy [i/o] : An external energy updated with the energy of
+//                        |data_in|.
+//                        NOTE: |total_energy| is only updated if
+//                        |total_energy| <= |kMinEnergy|.
+// - log_energy   [o]   : 10 * log10("energy of |data_in|") given in Q4.
+static void LogOfEnergy(const int16_t* data_in, int data_length,
+                        int16_t offset, int16_t* total_energy,
+                        int16_t* log_energy) {
+  // |tot_rshifts| accumulates the number of right shifts performed on |energy|.
+  int tot_rshifts = 0;
+  // The |energy| will be normalized to 15 bits. We use unsigned integer because
+  // we eventually will mask out the fractional part.
+  uint32_t energy = 0;
+
+  assert(data_in != NULL);
+  assert(data_length > 0);
+
+  energy = (uint32_t) WebRtcSpl_Energy((int16_t*) data_in, data_length,
+                                       &tot_rshifts);
+  LogOfScaledEnergy(energy, tot_rshifts, offset, total_energy, log_energy);
+}
+
 int16_t WebRtcVad_CalculateFeatures(VadInstT* self, const int16_t* data_in,
-                                    int data_length, int16_t* features) {
+                                    int stride, int data_length,
+                                    int16_t* features) {
   int16_t total_energy = 0;
   // We expect |data_length| to be 80, 160 or 240 samples, which corresponds to
   // 10, 20 or 30 ms in 8 kHz. Therefore, the intermediate downsampled data will
@@ -3182,7 +5268,7 @@ int16_t WebRtcVad_CalculateFeatures(VadInstT* self, const int16_t* data_in,
   assert(4 < kNumChannels - 1);  // Checking maximum |frequency_band|.
 
   // Split at 2000 Hz and downsample.
-  SplitFilter(in_ptr, data_length, &self->upper_state[frequency_band],
+  SplitFilter(in_ptr, stride, data_length, &self->upper_state[frequency_band],
               &self->lower_state[frequency_band], hp_out_ptr, lp_out_ptr);
 
   // For the upper band (2000 Hz - 4000 Hz) split at 3000 Hz and downsample.
@@ -3190,7 +5276,7 @@ int16_t WebRtcVad_CalculateFeatures(VadInstT* self, const int16_t* data_in,
   in_ptr = hp_120;  // [2000 - 4000] Hz.
   hp_out_ptr = hp_60;  // [3000 - 4000] Hz.
   lp_out_ptr = lp_60;  // [2000 - 3000] Hz.
-  SplitFilter(in_ptr, length, &self->upper_state[frequency_band],
+  SplitFilter(in_ptr, 1, length, &self->upper_state[frequency_band],
               &self->lower_state[frequency_band], hp_out_ptr, lp_out_ptr);
 
   // Energy in 3000 Hz - 4000 Hz.
@@ -3207,7 +5293,7 @@ int16_t WebRtcVad_CalculateFeatures(VadInstT* self, const int16_t* data_in,
   hp_out_ptr = hp_60;  // [1000 - 2000] Hz.
   lp_out_ptr = lp_60;  // [0 - 1000] Hz.
   length = half_data_length;  // |data_length| / 2 <=> bandwidth = 2000 Hz.
-  SplitFilter(in_ptr, length, &self->upper_state[frequency_band],
+  SplitFilter(in_ptr, 1, length, &self->upper_state[frequency_band],
               &self->lower_state[frequency_band], hp_out_ptr, lp_out_ptr);
 
   // Energy in 1000 Hz - 2000 Hz.
@@ -3219,7 +5305,7 @@ int16_t WebRtcVad_CalculateFeatures(VadInstT* self, const int16_t* data_in,
   in_ptr = lp_60;  // [0 - 1000] Hz.
   hp_out_ptr = hp_120;  // [500 - 1000] Hz.
   lp_out_ptr = lp_120;  // [0 - 500] Hz.
-  SplitFilter(in_ptr, length, &self->upper_state[frequency_band],
+  SplitFilter(in_ptr, 1, length, &self->upper_state[frequency_band],
               &self->lower_state[frequency_band], hp_out_ptr, lp_out_ptr);
 
   // Energy in 500 Hz - 1000 Hz.
@@ -3231,7 +5317,7 @@ int16_t WebRtcVad_CalculateFeatures(VadInstT* self, const int16_t* data_in,
   in_ptr = lp_120;  // [0 - 500] Hz.
   hp_out_ptr = hp_60;  // [250 - 500] Hz.
   lp_out_ptr = lp_60;  // [0 - 250] Hz.
-  SplitFilter(in_ptr, length, &self->upper_state[frequency_band],
+  SplitFilter(in_ptr, 1, length, &self->upper_state[frequency_band],
               &self->lower_state[frequency_band], hp_out_ptr, lp_out_ptr);
 
   // Energy in 250 Hz - 500 Hz.
@@ -3247,6 +5333,207 @@ int16_t WebRtcVad_CalculateFeatures(VadInstT* self, const int16_t* data_in,
   return total_energy;
 }
 
+// Band edges of the spectral features in Hz: the |kNumChannels| bands of
+// WebRtcVad_CalculateFeatures() followed by the |kVadNumHighBands| bands above
+// 4 kHz.
+static const int kSpectralBandEdges[kNumChannels + kVadNumHighBands + 1] = {
+  80, 250, 500, 1000, 2000, 3000, 4000, 6000, 8000, 12000, 16000, 24000
+};
+
+// Number of times the filter bank halves the rate of each band at 8 kHz,
+// i.e., its energy relative to that of the band limited 8 kHz signal. The
+// bands above 4 kHz are put on the scale of the 1 kHz wide ones.
+static const int16_t kSpectralBandSplits[kNumChannels + kVadNumHighBands] = {
+  4, 4, 3, 2, 2, 2, 2, 2, 2, 2, 2
+};
+
+// Adds the powers of bins |first| up to |last| of the two blocks in |spectrum|,
+// the FFT of one block as real and one as imaginary part, to |band_power|. With
+// Z = FFT(a + jb), |A[k]|^2 + |B[k]|^2 = (|Z[k]|^2 + |Z[N - k]|^2) / 2, so the
+// spectra need not be separated.
+static void AddPairedBandPowers(const int16_t* spectrum, int order,
+                                const int* band_start, int num_bands,
+                                int64_t* band_power) {
+  const int16_t* upper;
+  int band = 0;
+  int k;
+
+  for (k = band_start[0]; k < band_start[num_bands]; k++) {
+    while (k >= band_start[band + 1]) {
+      band++;
+    }
+    upper = &spectrum[2 * ((1 << order) - k)];
+    band_power[band] +=
+        (int64_t) WEBRTC_SPL_MUL_16_16(spectrum[2 * k], spectrum[2 * k]) +
+        WEBRTC_SPL_MUL_16_16(spectrum[2 * k + 1], spectrum[2 * k + 1]) +
+        WEBRTC_SPL_MUL_16_16(upper[0], upper[0]) +
+        WEBRTC_SPL_MUL_16_16(upper[1], upper[1]);
+  }
+}
+
+// As AddPairedBandPowers() for a single block of 2^(|order| + 1) samples, of
+// which the even ones were the real and the odd ones the imaginary part of the
+// FFT in |spectrum|. The even and odd spectra E and O are separated and
+// combined to the block spectrum X[k] = E[k] + W^k * O[k]. The powers are on
+// the scale of AddPairedBandPowers() for an FFT of twice the size.
+static void AddSingleBandPowers(const int16_t* spectrum, int order,
+                                const int* band_start, int num_bands,
+                                int64_t* band_power) {
+  const int half_length = 1 << order;
+  // W^k = exp(-2 * pi * j * k / 2^(order + 1)) steps through |kSinTable1024|.
+  const int twiddle_step = 512 >> order;
+  int band = 0;
+  int k;
+
+  for (k = band_start[0]; k < band_start[num_bands]; k++) {
+    const int16_t* lower = &spectrum[2 * k];
+    const int16_t* upper = &spectrum[2 * (half_length - k)];
+    // 2 * E[k] and 2 * O[k].
+    const int32_t even_re = lower[0] + upper[0];
+    const int32_t even_im = lower[1] - upper[1];
+    const int32_t odd_re = lower[1] + upper[1];
+    const int32_t odd_im = upper[0] - lower[0];
+    const int32_t w_re = kSinTable1024[k * twiddle_step + 256];  // Q15
+    const int32_t w_im = -kSinTable1024[k * twiddle_step];  // Q15
+    // |O[k]| is at most twice the largest input, so the products fit.
+    const int32_t re =
+        even_re + ((w_re * odd_re - w_im * odd_im + 16384) >> 15);
+    const int32_t im =
+        even_im + ((w_re * odd_im + w_im * odd_re + 16384) >> 15);
+
+    while (k >= band_start[band + 1]) {
+      band++;
+    }
+    // The FFT of half the size is scaled by 2 / N, so |re + j * im| is
+    // 4 / N * |X[k]|, and the paired FFT has a power of 2 / N^2 * |X[k]|^2.
+    band_power[band] += ((int64_t) re * re + (int64_t) im * im) >> 3;
+  }
+}
+
+int16_t WebRtcVad_CalculateSpectralFeatures(VadInstT* self, int fs,
+                                            const int16_t* data_in,
+                                            int stride, int data_length,
+                                            int16_t* features) {
+  enum { kNumBands = kNumChannels + kVadNumHighBands };
+  enum { kMaxOrder = 9 };  // 10 ms at 48 kHz, 480 samples, in 512 points.
+  int16_t fft_in[2 << kMaxOrder];
+  int16_t fft_out[2 << kMaxOrder];
+  int64_t band_power[kNumBands] = { 0 };
+  int band_start[kNumBands + 1];
+  // 10 ms blocks of 80, 160, 320 or 480 samples.
+  const int block_length = fs / 100;
+  const int order = fs == 8000 ? 7 : (fs == 16000 ? 8 : kMaxOrder);
+  const int fft_length = 1 << order;
+  struct RealFFT fft;
+  int16_t total_energy = 0;
+  int16_t high_band_energy = 0;
+  int scaling, num_bands, block, band, i, k;
+
+  assert(fs == 8000 || fs == 16000 || fs == 32000 || fs == 48000);
+  assert(data_length > 0);
+  assert(data_length <= 3 * block_length);
+
+  // Bins from |band_start[band]| up to |band_start[band + 1]| make up |band|.
+  // Only bands below half the rate are used.
+  num_bands = 0;
+  band_start[0] = (kSpectralBandEdges[0] * fft_length + fs / 2) / fs;
+  while (num_bands < kNumBands &&
+         kSpectralBandEdges[num_bands + 1] <= fs / 2) {
+    num_bands++;
+    band_start[num_bands] =
+        (kSpectralBandEdges[num_bands] * fft_length + fs / 2) / fs;
+  }
+
+  // Block floating point: the mean removed samples are at most twice
+  // |max_abs|, which is scaled to 13 bits. That leaves one bit of headroom for
+  // the rounding in the FFT stages.
+  scaling = WebRtcSpl_NormW16(MaxAbsValueStrided(data_in, stride,
+                                                 data_length)) - 2;
+
+  // Two blocks per FFT, as real and imaginary part. A block left over is
+  // transformed in an FFT of half the size instead.
+  for (block = 0; block * block_length < data_length; block += 2) {
+    const int paired = (block + 1) * block_length < data_length;
+
+    memset(fft_in, 0, sizeof(int16_t) * (paired ? 2 : 1) * fft_length);
+    for (k = 0; k < (paired ? 2 : 1); k++) {
+      const int16_t* samples = &data_in[(block + k) * block_length * stride];
+      int16_t* out = &fft_in[k];
+      int32_t mean = 0;
+      // Position in |kSinTable1024| of sin(pi * (i + 0.5) / |block_length|),
+      // in Q16.
+      int32_t position = (256 << 16) / block_length;
+
+      // The filter bank has a high pass at 80 Hz. A 10 ms block cannot
+      // resolve that, so at least the DC is removed before it leaks into the
+      // lowest band.
+      for (i = 0; i < block_length; i++) {
+        mean += samples[i * stride];
+      }
+      mean /= block_length;
+
+      // Sine window against leakage from the strong low bands.
+      for (i = 0; i < block_length; i++) {
+        const int32_t windowed = (samples[i * stride] - mean) *
+            kSinTable1024[(position + (1 << 15)) >> 16];  // Q15
+        *out = (int16_t) ((windowed + (1 << (14 - scaling))) >>
+                          (15 - scaling));
+        out += paired ? 2 : 1;
+        position += (512 << 16) / block_length;
+      }
+    }
+
+    if (paired) {
+      fft.order = order;
+      WebRtcSpl_RealForwardFFT(&fft, fft_in, fft_out);
+      AddPairedBandPowers(fft_out, order, band_start, num_bands, band_power);
+    } else {
+      fft.order = order - 1;
+      WebRtcSpl_RealForwardFFT(&fft, fft_in, fft_out);
+      AddSingleBandPowers(fft_out, order - 1, band_start, num_bands,
+                          band_power);
+    }
+  }
+
+  // The forward FFT is scaled by 1 / N, and by Parseval the energy of a band
+  // of one block is 2 / N * sum(|A[k]|^2), so the block energies of the band
+  // are N * |band_power|, times two for the window. The filter bank works on
+  // the 8 kHz signal, which has 8000 / |fs| of the samples, and halves the
+  // rate |kSpectralBandSplits| times. 48 kHz is the only rate that is not a
+  // power of two of 8 kHz.
+  for (band = 0; band < num_bands; band++) {
+    int64_t power = band_power[band];
+    int rshifts = order + 1 - 2 * scaling - kSpectralBandSplits[band];
+    uint32_t energy;
+
+    if (fs == 48000) {
+      power /= 3;
+      rshifts -= 1;
+    } else if (fs == 32000) {
+      rshifts -= 2;
+    } else if (fs == 16000) {
+      rshifts -= 1;
+    }
+    while (power > (int64_t) WEBRTC_SPL_WORD32_MAX) {
+      power >>= 1;
+      rshifts++;
+    }
+    energy = (uint32_t) power;
+
+    if (band < kNumChannels) {
+      LogOfScaledEnergy(energy, rshifts, kOffsetVector[band], &total_energy,
+                        &features[band]);
+    } else {
+      LogOfScaledEnergy(energy, rshifts, kOffsetVector[kNumChannels - 1],
+                        &high_band_energy,
+                        &self->high_band_features[band - kNumChannels]);
+    }
+  }
+  self->num_high_bands = (int16_t) (num_bands - kNumChannels);
+
+  return total_energy;
+}
+
 static const int32_t kCompVar = 22005;
 static const int16_t kLog2Exp = 5909;  // log2(exp(1)) in Q12.
 
@@ -3326,7 +5613,8 @@ static const int16_t kSmoothingUp = 32439;  // 0.99 in Q15.
 
 // TODO(bjornv): Move this function to vad_filterbank.c.
 // Downsampling filter based on splitting filter and allpass functions.
-void WebRtcVad_Downsampling(int16_t* signal_in,
+void WebRtcVad_Downsampling(const int16_t* signal_in,
+                            int in_stride,
                             int16_t* signal_out,
                             int32_t* filter_state,
                             int in_length) {
@@ -3342,15 +5630,17 @@ void WebRtcVad_Downsampling(int16_t* signal_in,
     tmp16_1 = (int16_t) ((tmp32_1 >> 1) +
         WEBRTC_SPL_MUL_16_16_RSFT(kAllPassCoefsQ13[0], *signal_in, 14));
     *signal_out = tmp16_1;
-    tmp32_1 = (int32_t) (*signal_in++) -
+    tmp32_1 = (int32_t) (*signal_in) -
         WEBRTC_SPL_MUL_16_16_RSFT(kAllPassCoefsQ13[0], tmp16_1, 12);
+    signal_in += in_stride;
 
     // All-pass filtering lower branch.
     tmp16_2 = (int16_t) ((tmp32_2 >> 1) +
         WEBRTC_SPL_MUL_16_16_RSFT(kAllPassCoefsQ13[1], *signal_in, 14));
     *signal_out++ += tmp16_2;
-    tmp32_2 = (int32_t) (*signal_in++) -
+    tmp32_2 = (int32_t) (*signal_in) -
         WEBRTC_SPL_MUL_16_16_RSFT(kAllPassCoefsQ13[1], tmp16_2, 12);
+    signal_in += in_stride;
   }
   // Store the filter states.
   filter_state[0] = tmp32_1;
@@ -3372,7 +5662,7 @@ int16_t WebRtcVad_FindMinimum(VadInstT* self,
   int32_t tmp32 = 0;
   // Pointer to memory for the 16 minimum values and the age of each value of
   // the |channel|.
-  int16_t* age = &self->index_vector[offset];
+  uint8_t* age = &self->index_vector[offset];
   int16_t* smallest_values = &self->low_value_vector[offset];
 
   assert(channel < kNumChannels);
@@ -3384,6 +5674,8 @@ int16_t WebRtcVad_FindMinimum(VadInstT* self,
       age[i]++;
     } else {
       // Too old value. Remove from memory and shift larger values downwards.
+      // Arguments: instance, channel, expired value.
+      VAD_PROBE3(minimum_expired, self, channel, smallest_values[i]);
       for (j = i; j < 16; j++) {
         smallest_values[j] = smallest_values[j + 1];
         age[j] = age[j + 1];
@@ -3480,6 +5772,504 @@ int16_t WebRtcVad_FindMinimum(VadInstT* self,
   return self->mean_value[channel];
 }
 
+#include <math.h>
+
+// The float engine, see WebRtcVad_set_engine(). The filter bank and the GMM
+// follow the fixed point code step by step, with the Q-format constants
+// converted, so that the two engines only differ in rounding. Features, means
+// and standard deviations are in dB, probabilities are not scaled.
+
+// Probability of a band below which the fixed point sums are zero, half an
+// LSB in Q27. The log likelihood ratio is limited by it as in EvaluateGmm().
+static const float kMinProbabilityFloat = 1.f / (1 << 28);
+// Probability of a band below which the fixed point sums are too small for
+// the conditional probabilities of the Gaussians, one LSB in Q15.
+static const float kMinConditionalFloat = 1.f / (1 << 15);
+// Exponent of GaussianProbabilityFloat() from which the probability is zero,
+// 10 * log(2).
+static const float kMaxExponentFloat = 6.931472f;
+
+// Converts a Q7 model parameter to dB.
+static float FromQ7(int16_t value) {
+  return value / 128.f;
+}
+
+// Converts |value| in dB to Q7, with saturation.
+static int16_t ToQ7(float value) {
+  return (int16_t) lrintf(fmaxf(fminf(value * 128.f, WEBRTC_SPL_WORD16_MAX),
+                                WEBRTC_SPL_WORD16_MIN));
+}
+
+// Converts a filter state to int16_t, with saturation.
+static int16_t ToState(float value) {
+  return (int16_t) lrintf(fmaxf(fminf(value, WEBRTC_SPL_WORD16_MAX),
+                                WEBRTC_SPL_WORD16_MIN));
+}
+
+void WebRtcVad_ConvertEngineState(VadInstT* self, int engine) {
+  VadFloatState* state = self->float_state;
+  int i;
+
+  if (engine == kVadEngineFloat) {
+    for (i = 0; i < kTableSize; i++) {
+      state->noise_means[i] = FromQ7(self->noise_means[i]);
+      state->speech_means[i] = FromQ7(self->speech_means[i]);
+      state->noise_stds[i] = FromQ7(self->noise_stds[i]);
+      state->speech_stds[i] = FromQ7(self->speech_stds[i]);
+    }
+    for (i = 0; i < 5; i++) {
+      state->upper_state[i] = self->upper_state[i];
+      state->lower_state[i] = self->lower_state[i];
+    }
+    for (i = 0; i < 4; i++) {
+      state->hp_filter_state[i] = self->hp_filter_state[i];
+    }
+  } else {
+    for (i = 0; i < kTableSize; i++) {
+      self->noise_means[i] = ToQ7(state->noise_means[i]);
+      self->speech_means[i] = ToQ7(state->speech_means[i]);
+      self->noise_stds[i] = ToQ7(state->noise_stds[i]);
+      self->speech_stds[i] = ToQ7(state->speech_stds[i]);
+    }
+    for (i = 0; i < 5; i++) {
+      self->upper_state[i] = ToState(state->upper_state[i]);
+      self->lower_state[i] = ToState(state->lower_state[i]);
+    }
+    for (i = 0; i < 4; i++) {
+      self->hp_filter_state[i] = ToState(state->hp_filter_state[i]);
+    }
+  }
+}
+
+// Float version of HighPassFilter().
+static void HighPassFilterFloat(const float* data_in, int data_length,
+                                float* filter_state, float* data_out) {
+  const float zero_0 = kHpZeroCoefs[0] / 16384.f;
+  const float zero_1 = kHpZeroCoefs[1] / 16384.f;
+  const float zero_2 = kHpZeroCoefs[2] / 16384.f;
+  const float pole_1 = kHpPoleCoefs[1] / 16384.f;
+  const float pole_2 = kHpPoleCoefs[2] / 16384.f;
+  int i;
+
+  for (i = 0; i < data_length; i++) {
+    const float out = zero_0 * data_in[i] + zero_1 * filter_state[0] +
+        zero_2 * filter_state[1] - pole_1 * filter_state[2] -
+        pole_2 * filter_state[3];
+    filter_state[1] = filter_state[0];
+    filter_state[0] = data_in[i];
+    filter_state[3] = filter_state[2];
+    filter_state[2] = out;
+    data_out[i] = out;
+  }
+}
+
+// Float version of SplitFilter(). With the coefficient c in Q15 converted,
+// each all pass section is
+//   y[n] = state[n - 1] + c / 2 * x[n]
+//   state[n] = x[n] / 2 - c * y[n]
+// which is the fixed point recurrence without the truncations.
+static void SplitFilterFloat(const float* data_in, int data_length,
+                             float* upper_state, float* lower_state,
+                             float* hp_data_out, float* lp_data_out) {
+  const float upper_coefficient = kAllPassCoefsQ15[0] / 32768.f;
+  const float lower_coefficient = kAllPassCoefsQ15[1] / 32768.f;
+  const int half_length = data_length >> 1;  // Downsampling by 2.
+  float upper_previous = *upper_state;
+  float lower_previous = *lower_state;
+  int i;
+
+  for (i = 0; i < half_length; i++) {
+    const float upper = upper_previous +
+        0.5f * upper_coefficient * data_in[2 * i];
+    const float lower = lower_previous +
+        0.5f * lower_coefficient * data_in[2 * i + 1];
+
+    upper_previous = 0.5f * data_in[2 * i] - upper_coefficient * upper;
+    lower_previous = 0.5f * data_in[2 * i + 1] - lower_coefficient * lower;
+
+    // Make LP and HP signals.
+    hp_data_out[i] = upper - lower;
+    lp_data_out[i] = upper + lower;
+  }
+
+  *upper_state = upper_previous;
+  *lower_state = lower_previous;
+}
+
+// Float version of LogOfEnergy(). Adds the energy of |data_in| to
+// |total_energy| and returns 10 * log10(energy) in dB, limited at zero as in
+// the fixed point code, plus |offset| in Q4.
+static float LogOfEnergyFloat(const float* data_in, int data_length,
+                              int16_t offset, float* total_energy) {
+  float energy = 0;
+  float log_energy = 0;
+  int i;
+
+  for (i = 0; i < data_length; i++) {
+    energy += data_in[i] * data_in[i];
+  }
+  *total_energy += energy;
+
+  if (energy > 1.f) {
+    log_energy = 10.f * log10f(energy);
+  }
+  return log_energy + offset / 16.f;
+}
+
+float WebRtcVad_CalculateFeaturesFloat(VadInstT* self, const int16_t* data_in,
+                                       int stride, int data_length,
+                                       float* features) {
+  VadFloatState* state = self->float_state;
+  float total_energy = 0;
+  // As in WebRtcVad_CalculateFeatures(), the frame is at most 240 samples.
+  float in[240];
+  float hp_120[120], lp_120[120];
+  float hp_60[60], lp_60[60];
+  const int half_data_length = data_length >> 1;
+  int length = half_data_length;
+  int i;
+
+  assert(data_length >= 0);
+  assert(data_length <= 240);
+
+  for (i = 0; i < data_length; i++) {
+    in[i] = data_in[i * stride];
+  }
+
+  // Split at 2000 Hz and downsample.
+  SplitFilterFloat(in, data_length, &state->upper_state[0],
+                   &state->lower_state[0], hp_120, lp_120);
+
+  // For the upper band (2000 Hz - 4000 Hz) split at 3000 Hz and downsample.
+  SplitFilterFloat(hp_120, length, &state->upper_state[1],
+                   &state->lower_state[1], hp_60, lp_60);
+
+  // Energy in 3000 Hz - 4000 Hz and in 2000 Hz - 3000 Hz.
+  length >>= 1;
+  features[5] = LogOfEnergyFloat(hp_60, length, kOffsetVector[5],
+                                 &total_energy);
+  features[4] = LogOfEnergyFloat(lp_60, length, kOffsetVector[4],
+                                 &total_energy);
+
+  // For the lower band (0 Hz - 2000 Hz) split at 1000 Hz and downsample.
+  length = half_data_length;
+  SplitFilterFloat(lp_120, length, &state->upper_state[2],
+                   &state->lower_state[2], hp_60, lp_60);
+
+  // Energy in 1000 Hz - 2000 Hz.
+  length >>= 1;
+  features[3] = LogOfEnergyFloat(hp_60, length, kOffsetVector[3],
+                                 &total_energy);
+
+  // For the lower band (0 Hz - 1000 Hz) split at 500 Hz and downsample.
+  SplitFilterFloat(lp_60, length, &state->upper_state[3],
+                   &state->lower_state[3], hp_120, lp_120);
+
+  // Energy in 500 Hz - 1000 Hz.
+  length >>= 1;
+  features[2] = LogOfEnergyFloat(hp_120, length, kOffsetVector[2],
+                                 &total_energy);
+
+  // For the lower band (0 Hz - 500 Hz) split at 250 Hz and downsample.
+  SplitFilterFloat(lp_120, length, &state->upper_state[4],
+                   &state->lower_state[4], hp_60, lp_60);
+
+  // Energy in 250 Hz - 500 Hz.
+  length >>= 1;
+  features[1] = LogOfEnergyFloat(hp_60, length, kOffsetVector[1],
+                                 &total_energy);
+
+  // Remove 0 Hz - 80 Hz, by high pass filtering the lower band.
+  HighPassFilterFloat(lp_60, length, state->hp_filter_state, hp_120);
+
+  // Energy in 80 Hz - 250 Hz.
+  features[0] = LogOfEnergyFloat(hp_120, length, kOffsetVector[0],
+                                 &total_energy);
+
+  return total_energy;
+}
+
+// Float version of WebRtcVad_GaussianProbability(). Returns
+// 1 / s * exp(-(x - m)^2 / (2 * s^2)) and writes (x - m) / s^2 to |delta|.
+static float GaussianProbabilityFloat(float input, float mean, float std,
+                                      float* delta) {
+  const float inv_std = 1.f / std;
+  const float difference = input - mean;
+  float exponent;
+
+  *delta = difference * inv_std * inv_std;
+  exponent = 0.5f * *delta * difference;
+  // The fixed point exponential is in Q10 and vanishes below 2^-10. The mode
+  // thresholds are tuned to the likelihood ratios this gives, where a zero
+  // probability counts as the limit of the Q27 sums.
+  if (exponent >= kMaxExponentFloat) {
+    return 0;
+  }
+  return inv_std * expf(-exponent);
+}
+
+// Float version of EvaluateGmm(). The conditional probabilities are in the
+// range [0, 1].
+static int16_t EvaluateGmmFloat(const VadInstT* self, const float* features,
+                                int frame_length, float* deltaN, float* deltaS,
+                                float* ngprvec, float* sgprvec) {
+  const VadFloatState* state = self->float_state;
+  const VadModeTable* thresholds = &kModeTables[self->mode];
+  const int length_index = LengthIndex(frame_length);
+  const float individual_test = thresholds->individual[length_index];
+  const float total_test = thresholds->total[length_index];
+  float noise_probability[kNumGaussians], speech_probability[kNumGaussians];
+  float h0, h1;
+  float log_likelihood_ratio;
+  float sum_log_likelihood_ratios = 0;
+  int16_t vadflag = 0;
+  int channel, k, gaussian;
+
+  memset(ngprvec, 0, kTableSize * sizeof(*ngprvec));
+  memset(sgprvec, 0, kTableSize * sizeof(*sgprvec));
+
+  for (channel = 0; channel < kNumChannels; channel++) {
+    h0 = 0;
+    h1 = 0;
+    for (k = 0; k < kNumGaussians; k++) {
+      gaussian = channel + k * kNumChannels;
+      noise_probability[k] = kNoiseDataWeights[gaussian] / 128.f *
+          GaussianProbabilityFloat(features[channel],
+                                   state->noise_means[gaussian],
+                                   state->noise_stds[gaussian],
+                                   &deltaN[gaussian]);
+      h0 += noise_probability[k];
+      speech_probability[k] = kSpeechDataWeights[gaussian] / 128.f *
+          GaussianProbabilityFloat(features[channel],
+                                   state->speech_means[gaussian],
+                                   state->speech_stds[gaussian],
+                                   &deltaS[gaussian]);
+      h1 += speech_probability[k];
+    }
+
+    // log2(Pr{X|H1} / Pr{X|H0}) as the difference of the integer parts of
+    // the logarithms of the Q27 sums, like the fixed point approximation the
+    // mode thresholds are tuned to.
+    log_likelihood_ratio =
+        floorf(log2f(fmaxf(h1, kMinProbabilityFloat)) + 27) -
+        floorf(log2f(fmaxf(h0, kMinProbabilityFloat)) + 27);
+    sum_log_likelihood_ratios += log_likelihood_ratio *
+        kSpectrumWeight[channel];
+
+    // Local VAD decision.
+    if (4 * log_likelihood_ratio > individual_test) {
+      vadflag = 1;
+    }
+
+    // Conditional probabilities for the model update, see EvaluateGmm().
+    if (h0 >= kMinConditionalFloat) {
+      ngprvec[channel] = noise_probability[0] / h0;
+      ngprvec[channel + kNumChannels] = 1 - ngprvec[channel];
+    } else {
+      ngprvec[channel] = 1;
+    }
+    if (h1 >= kMinConditionalFloat) {
+      sgprvec[channel] = speech_probability[0] / h1;
+      sgprvec[channel + kNumChannels] = 1 - sgprvec[channel];
+    }
+  }
+
+  // Make a global VAD decision.
+  vadflag |= (sum_log_likelihood_ratios >= total_test);
+
+  return vadflag;
+}
+
+// Float version of WeightedAverage().
+static float WeightedAverageFloat(float* data, float offset,
+                                  const int16_t* weights) {
+  float weighted_average = 0;
+  int k;
+
+  for (k = 0; k < kNumGaussians; k++) {
+    data[k * kNumChannels] += offset;
+    weighted_average += data[k * kNumChannels] * weights[k * kNumChannels] /
+        128.f;
+  }
+  return weighted_average;
+}
+
+// Float version of UpdateModel(). The step sizes are the Q-format constants
+// converted, the comments give the fixed point expressions.
+static void UpdateModelFloat(VadInstT* self, const float* features,
+                             int16_t vadflag, const float* deltaN,
+                             const float* deltaS, const float* ngprvec,
+                             const float* sgprvec) {
+  VadFloatState* state = self->float_state;
+  const float noise_update = kNoiseUpdateConst / 32768.f;
+  const float speech_update = kSpeechUpdateConst / 32768.f;
+  const float back_eta = kBackEta / 256.f;
+  const float min_std = FromQ7(kMinStd);
+  int channel, k, gaussian;
+  int16_t feature_q4;
+  float feature_minimum;
+  float noise_global_mean, speech_global_mean;
+  float nmk, nmk2, nmk3, smk, smk2, nsk, ssk;
+  float difference, maxspe;
+
+  maxspe = FromQ7(12800);
+  for (channel = 0; channel < kNumChannels; channel++) {
+    // The minimum tracking is shared with the fixed point engine, in Q4.
+    feature_q4 = (int16_t) lrintf(fmaxf(fminf(features[channel] * 16.f,
+                                              WEBRTC_SPL_WORD16_MAX), 0.f));
+    feature_minimum = WebRtcVad_FindMinimum(self, feature_q4, channel) / 16.f;
+
+    noise_global_mean = WeightedAverageFloat(&state->noise_means[channel], 0,
+                                             &kNoiseDataWeights[channel]);
+
+    for (k = 0; k < kNumGaussians; k++) {
+      gaussian = channel + k * kNumChannels;
+
+      nmk = state->noise_means[gaussian];
+      smk = state->speech_means[gaussian];
+      nsk = state->noise_stds[gaussian];
+      ssk = state->speech_stds[gaussian];
+
+      // Update the noise mean if the frame consists of noise only.
+      nmk2 = nmk;
+      if (!vadflag) {
+        nmk2 = nmk + noise_update * ngprvec[gaussian] * deltaN[gaussian];
+      }
+
+      // Long term correction of the noise mean, limited to
+      // [k + 5, 72 + k - channel] dB.
+      nmk3 = nmk2 + back_eta * (feature_minimum - noise_global_mean);
+      nmk3 = fmaxf(nmk3, (float) (k + 5));
+      nmk3 = fminf(nmk3, (float) (72 + k - channel));
+      state->noise_means[gaussian] = nmk3;
+
+      if (vadflag) {
+        // Update the speech mean, limited as in UpdateModel().
+        smk2 = smk + speech_update * sgprvec[gaussian] * deltaS[gaussian];
+        smk2 = fmaxf(smk2, FromQ7(kMinimumMean[k]));
+        smk2 = fminf(smk2, maxspe + FromQ7(640));
+        state->speech_means[gaussian] = smk2;
+
+        // sgprvec * (deltaS * (x - smk) - 1) * 0.1 / ssk, divided by 4.
+        ssk += sgprvec[gaussian] *
+            (deltaS[gaussian] * (features[channel] - smk) - 1) /
+            (40.f * ssk);
+        state->speech_stds[gaussian] = fmaxf(ssk, min_std);
+      } else {
+        // ngprvec * (deltaN * (x - nmk) - 1) * 2^-10 / nsk.
+        nsk += ngprvec[gaussian] *
+            (deltaN[gaussian] * (features[channel] - nmk) - 1) /
+            (1024.f * nsk);
+        state->noise_stds[gaussian] = fmaxf(nsk, min_std);
+      }
+    }
+
+    // Separate models if they are too close.
+    noise_global_mean = WeightedAverageFloat(&state->noise_means[channel], 0,
+                                             &kNoiseDataWeights[channel]);
+    speech_global_mean = WeightedAverageFloat(&state->speech_means[channel], 0,
+                                              &kSpeechDataWeights[channel]);
+    difference = kMinimumDifference[channel] / 32.f -
+        (speech_global_mean - noise_global_mean);
+    if (difference > 0) {
+      // Move the speech model by 13 / 16 and the noise model by 3 / 16 of the
+      // missing difference.
+      speech_global_mean = WeightedAverageFloat(&state->speech_means[channel],
+                                                difference * 13 / 16,
+                                                &kSpeechDataWeights[channel]);
+      noise_global_mean = WeightedAverageFloat(&state->noise_means[channel],
+                                               -difference * 3 / 16,
+                                               &kNoiseDataWeights[channel]);
+    }
+
+    // Control that the speech & noise means do not drift to much.
+    maxspe = FromQ7(kMaximumSpeech[channel]);
+    if (speech_global_mean > maxspe) {
+      for (k = 0; k < kNumGaussians; k++) {
+        state->speech_means[channel + k * kNumChannels] -=
+            speech_global_mean - maxspe;
+      }
+    }
+    if (noise_global_mean > FromQ7(kMaximumNoise[channel])) {
+      for (k = 0; k < kNumGaussians; k++) {
+        state->noise_means[channel + k * kNumChannels] -=
+            noise_global_mean - FromQ7(kMaximumNoise[channel]);
+      }
+    }
+  }
+}
+
+// Float version of AdaptModel(), with the same adaptation control. The drift
+// of the noise means is measured in Q7.
+static void AdaptModelFloat(VadInstT* self, const float* features,
+                            int16_t vadflag, const float* deltaN,
+                            const float* deltaS, const float* ngprvec,
+                            const float* sgprvec) {
+  float previous_noise_means[kTableSize];
+  float drift = 0;
+  int i;
+
+  if (ModelUpdateDue(self, vadflag)) {
+    if (self->adapt_drift_threshold > 0) {
+      memcpy(previous_noise_means, self->float_state->noise_means,
+             sizeof(previous_noise_means));
+    }
+    UpdateModelFloat(self, features, vadflag, deltaN, deltaS, ngprvec,
+                     sgprvec);
+    if (self->adapt_drift_threshold > 0) {
+      for (i = 0; i < kTableSize; i++) {
+        drift = fmaxf(drift, fabsf(self->float_state->noise_means[i] -
+                                   previous_noise_means[i]));
+      }
+      self->last_update_drift = ToQ7(drift);
+    }
+    self->frames_since_update = 0;
+    self->last_update_vad = vadflag;
+    self->model_updates++;
+    VAD_STATS_ADD(self, model_updates, 1);
+    VAD_PROBE3(model_update, self, vadflag, self->last_update_drift);
+  } else {
+    self->frames_since_update++;
+    self->model_updates_skipped++;
+    VAD_STATS_ADD(self, model_updates_skipped, 1);
+    VAD_PROBE2(model_update_skipped, self, self->frames_since_update);
+  }
+  self->frame_counter++;
+}
+
+int16_t WebRtcVad_GmmProbabilityFloat(VadInstT* self, const float* features,
+                                      float total_power, int frame_length) {
+  int16_t vadflag = 0;
+  float deltaN[kTableSize], deltaS[kTableSize];
+  float ngprvec[kTableSize], sgprvec[kTableSize];
+  VAD_STAGE_TIMER(start);
+
+  if (total_power > kMinEnergy) {
+    VAD_STAGE_START(start);
+    vadflag = EvaluateGmmFloat(self, features, frame_length, deltaN, deltaS,
+                               ngprvec, sgprvec);
+    VAD_STAGE_STOP(self, kVadStageLikelihood, start);
+    VAD_STAGE_START(start);
+    AdaptModelFloat(self, features, vadflag, deltaN, deltaS, ngprvec,
+                    sgprvec);
+    VAD_STAGE_STOP(self, kVadStageUpdate, start);
+  } else {
+    VAD_STATS_ADD(self, low_energy_frames, 1);
+  }
+
+  return WebRtcVad_SmoothDecision(self, vadflag, frame_length);
+}
+
+void WebRtcVad_AdaptToNoiseFloat(VadInstT* self, const float* features,
+                                 int frame_length) {
+  float deltaN[kTableSize], deltaS[kTableSize];
+  float ngprvec[kTableSize], sgprvec[kTableSize];
+
+  EvaluateGmmFloat(self, features, frame_length, deltaN, deltaS, ngprvec,
+                   sgprvec);
+  AdaptModelFloat(self, features, 0, deltaN, deltaS, ngprvec, sgprvec);
+}
+
 void WebRtcSpl_VectorBitShiftW16(WebRtc_Word16 *res,
                              WebRtc_Word16 length,
                              G_CONST WebRtc_Word16 *in,
@@ -3628,6 +6418,36 @@ int WebRtcSpl_ScaleAndAddVectorsWithRoundC(const int16_t* in_vector1,
   return 0;
 }
 
+// C version of WebRtcSpl_MuLawToW16() for generic platforms.
+void WebRtcSpl_MuLawToW16C(const uint8_t* in, int length, int16_t* out) {
+  int i;
+
+  for (i = 0; i < length; i++) {
+    // Sign, 3 bits exponent and 4 bits mantissa, all inverted.
+    const int code = ~in[i] & 0xFF;
+    const int magnitude = (((code & 0x0F) << 3) + 0x84) << ((code >> 4) & 7);
+
+    out[i] = (int16_t) ((code & 0x80) ? 0x84 - magnitude : magnitude - 0x84);
+  }
+}
+
+// C version of WebRtcSpl_ALawToW16() for generic platforms.
+void WebRtcSpl_ALawToW16C(const uint8_t* in, int length, int16_t* out) {
+  int i;
+
+  for (i = 0; i < length; i++) {
+    // Sign, 3 bits segment and 4 bits mantissa, even bits inverted.
+    const int code = in[i] ^ 0x55;
+    const int segment = (code >> 4) & 7;
+    int magnitude = ((code & 0x0F) << 4) + 8;
+
+    if (segment > 0) {
+      magnitude = (magnitude + 0x100) << (segment - 1);
+    }
+    out[i] = (int16_t) ((code & 0x80) ? magnitude : -magnitude);
+  }
+}
+
 int32_t WebRtcSpl_Energy(int16_t* vector, int vector_length, int* scale_factor)
 {
     int32_t en = 0;
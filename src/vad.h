@@ -51,6 +51,18 @@
 #define WEBRTC_USE_SSE2
 #endif
 
+// x86 targets without SSE2 still get the SSE2 kernels where GCC can select
+// them once at load time through an ifunc, see WebRtcSpl_Init().
+#if defined(WEBRTC_ARCH_X86_FAMILY) && !defined(WEBRTC_USE_SSE2) && \
+    defined(__GNUC__) && defined(__ELF__)
+#define WEBRTC_SPL_SSE2_IFUNC
+#endif
+
+// AVX2 kernels are built with a target attribute and selected at run time.
+#if defined(WEBRTC_ARCH_X86_FAMILY) && defined(__GNUC__) && defined(__ELF__)
+#define WEBRTC_SPL_AVX2
+#endif
+
 #if !defined(_MSC_VER)
 #include <stdint.h>
 #else
@@ -64,6 +76,7 @@ typedef unsigned short      uint16_t;
 typedef unsigned int        uint32_t;
 typedef unsigned __int64    uint64_t;
 #endif
+#include <stddef.h>
 
 // TODO(andrew): remove WebRtc_ types:
 // http://code.google.com/p/webrtc/issues/detail?id=314
@@ -109,6 +122,41 @@ int WebRtcVad_Free(VadInst* handle);
 //                 -1 - (NULL pointer or Default mode could not be set).
 int WebRtcVad_Init(VadInst* handle);
 
+// Copies the complete state of an initialized |prototype|, including mode,
+// settings, engine and any adapted (warm-started) model, into |handle|. For
+// per-call reuse this replaces WebRtcVad_Init() and WebRtcVad_set_mode() with
+// one memcpy() of the instance, plus one for each state |prototype| has
+// allocated: the 48 kHz resampler and the float engine. |handle| keeps its
+// own copies of those, allocated on the first clone that needs them.
+//
+// The rest of |handle| is not taken from |prototype|:
+//   - the latency histograms set with WebRtcVad_set_latency_histograms()
+//     stay those of |handle|,
+//   - the counters of WebRtcVad_get_adaptation_stats() and, built with
+//     WEBRTC_VAD_STATS, WebRtcVad_get_stats() start at zero, as after
+//     WebRtcVad_Init(); they count the work of |handle| only.
+//
+// - handle    [o] : Instance created by WebRtcVad_Create().
+// - prototype [i] : Initialized instance to copy from.
+//
+// returns         : 0 - (OK),
+//                  -1 - (NULL pointer, |prototype| not initialized or the
+//                        48 kHz resampler or float engine state could not be
+//                        allocated).
+int WebRtcVad_Clone(VadInst* handle, const VadInst* prototype);
+
+// Resets |num_handles| instances to the state of |prototype|. If |prototype|
+// is NULL, |handles[0]| is initialized with WebRtcVad_Init() and cloned into
+// the remaining instances.
+//
+// - handles     [o] : Array of instances created by WebRtcVad_Create().
+// - num_handles [i] : Number of instances in |handles|.
+// - prototype   [i] : Initialized instance to copy from, or NULL.
+//
+// returns           : 0 - (OK), -1 - (Error, see WebRtcVad_Clone()).
+int WebRtcVad_InitBatch(VadInst** handles, int num_handles,
+                        const VadInst* prototype);
+
 // Sets the VAD operating mode. A more aggressive (higher mode) VAD is more
 // restrictive in reporting speech. Put in other words the probability of being
 // speech when the VAD returns 1 is increased with increasing mode. As a
@@ -122,6 +170,289 @@ int WebRtcVad_Init(VadInst* handle);
 //                       has not been initialized).
 int WebRtcVad_set_mode(VadInst* handle, int mode);
 
+// Enables a low-cost mode for stationary channels, in which the adaptation of
+// the noise and speech models (the second half of the GMM processing) is only
+// run when needed. A model update is skipped as long as
+//   - the decision equals the one of the last update,
+//   - fewer than |interval| frames have passed since the last update, and
+//   - if |drift_threshold| > 0, the last update moved no noise mean by more
+//     than |drift_threshold|.
+// Updates resume automatically as soon as one of the conditions fails. Note
+// that skipped frames also don't age the values of the minimum tracking, so
+// decisions may deviate from the default mode. WebRtcVad_Init() restores the
+// default of adapting on every frame (|interval| = 1).
+//
+// - handle          [i/o] : VAD instance.
+// - interval        [i]   : Maximum distance in frames between two updates,
+//                           1 - 32767. 1 disables skipping.
+// - drift_threshold [i]   : Noise mean drift threshold in dB, Q7,
+//                           0 disables the drift condition.
+//
+// returns                 : 0 - (OK),
+//                          -1 - (NULL pointer, invalid parameter or the VAD
+//                                instance has not been initialized).
+int WebRtcVad_set_adaptation(VadInst* handle, int interval,
+                             int drift_threshold);
+
+// Controls the shortcuts for silent frames, which skip the resampler, the
+// filter bank and the GMM and only run the hangover logic.
+//
+// Exact skip (|enable| = 1, the default): An all-zero frame is skipped if a
+// previous all-zero frame of the same rate and length left all filter states
+// unchanged without reaching |kMinEnergy|. The full path is a deterministic
+// function of the state and the input, so the result is bit-exact. After
+// active audio this happens as soon as the filter states have decayed to
+// their zero-input fixed point.
+//
+// Approximate skip (|threshold| > 0, off by default): Frames with a largest
+// absolute sample value of at most |threshold| are treated as if they were
+// below |kMinEnergy|, without advancing the filter states. This is not
+// bit-exact and can change decisions for low-level speech.
+//
+// - handle    [i/o] : VAD instance.
+// - enable    [i]   : 1 - exact skip of all-zero frames, 0 - off.
+// - threshold [i]   : Sample magnitude for the approximate skip, 0 - off.
+//
+// returns           : 0 - (OK),
+//                    -1 - (NULL pointer, invalid parameter or the VAD
+//                          instance has not been initialized).
+int WebRtcVad_set_silence_skip(VadInst* handle, int enable, int threshold);
+
+// Feature extractors, see WebRtcVad_set_feature_mode().
+enum {
+  kVadFeaturesFilterBank = 0,  // Split filter bank at 8 kHz, the default.
+  kVadFeaturesSpectral = 1     // FFT at the native rate.
+};
+// Bands above 4 kHz of the spectral features: 4-6, 6-8, 8-12, 12-16 and
+// 16-24 kHz.
+enum { kVadNumHighBands = 5 };
+
+// Selects how the six band energies fed to the GMM are computed.
+//
+// Filter bank (the default): The frame is resampled to 8 kHz and split into
+// bands by the allpass QMF tree of WebRtcVad_CalculateFeatures().
+//
+// Spectral: The frame is taken in 10 ms blocks at the native rate, two blocks
+// per FFT (as real and imaginary part), and the bin powers are summed per
+// band and scaled to the filter bank energies. The resampler and the filter
+// states are not used, which mostly pays off at 32 and 48 kHz. The features
+// approximate the filter bank ones, so decisions are not bit-exact with the
+// default. Energies above 4 kHz are computed as well, see
+// WebRtcVad_get_high_band_features().
+//
+// The mode is reset by WebRtcVad_Init(). Switching modes on a running
+// instance keeps the model, but the filter states pick up where they were
+// left when switching back.
+//
+// - handle [i/o] : VAD instance.
+// - mode   [i]   : kVadFeaturesFilterBank or kVadFeaturesSpectral.
+//
+// returns        : 0 - (OK),
+//                 -1 - (NULL pointer, invalid mode or the VAD instance has
+//                       not been initialized).
+int WebRtcVad_set_feature_mode(VadInst* handle, int mode);
+
+// Reads the energies above 4 kHz of the last frame processed with spectral
+// features, 10 * log10(energy) in Q4 on the scale of the 1 kHz wide bands of
+// WebRtcVad_CalculateFeatures(). Only bands below half the sampling rate are
+// written: none at 8 kHz, two at 16 kHz, four at 32 kHz and all five at
+// 48 kHz.
+//
+// - handle   [i] : VAD instance.
+// - features [o] : |kVadNumHighBands| log energies.
+//
+// returns        : Number of bands written, 0 if no frame has been processed
+//                  with spectral features since WebRtcVad_Init(),
+//                 -1 - (NULL pointer or not initialized).
+int WebRtcVad_get_high_band_features(VadInst* handle, int16_t* features);
+
+// Arithmetic of the feature extractor and the GMM, see WebRtcVad_set_engine().
+enum {
+  kVadEngineFixed = 0,  // Q-format fixed point, the default.
+  kVadEngineFloat = 1   // Single precision floating point.
+};
+
+// Selects the arithmetic of the filter bank features and the GMM.
+//
+// Fixed (the default): The fixed point implementation, bit-exact with the
+// reference.
+//
+// Float: The same filter bank, likelihood test and model update in float,
+// with features, means and standard deviations in dB instead of Q4 and Q7.
+// This avoids the saturating multiplies, divisions and normalizations of the
+// fixed point code. The resampling to 8 kHz and the spectral features stay in
+// fixed point, and the minimum tracking of the noise model is shared. The
+// decisions are not bit-exact with the fixed point engine, vad_difftest
+// reports how often they agree.
+//
+// The model and the filter states are converted when switching engines on a
+// running instance. The engine is reset by WebRtcVad_Init(), and kept by
+// WebRtcVad_Clone().
+//
+// - handle [i/o] : VAD instance.
+// - engine [i]   : kVadEngineFixed or kVadEngineFloat.
+//
+// returns        : 0 - (OK),
+//                 -1 - (NULL pointer, invalid engine or the VAD instance has
+//                       not been initialized).
+int WebRtcVad_set_engine(VadInst* handle, int engine);
+
+// Reads the number of model updates performed and skipped since
+// WebRtcVad_Init(), see WebRtcVad_set_adaptation().
+//
+// - handle  [i] : VAD instance.
+// - updates [o] : Number of frames the model was adapted on.
+// - skipped [o] : Number of frames the model update was skipped on.
+//
+// returns       : 0 - (OK), -1 - (NULL pointer or not initialized).
+int WebRtcVad_get_adaptation_stats(VadInst* handle, uint32_t* updates,
+                                   uint32_t* skipped);
+
+// Processing statistics. They are only collected when the library is built
+// with WEBRTC_VAD_STATS defined, which must then also be defined for every
+// file including this header, as it changes VadInstT.
+enum { kVadStatsNumRates = 4 };  // 8000, 16000, 32000 and 48000 Hz.
+
+typedef enum {
+  kVadStageResample = 0,  // 48, 32 and 16 kHz down to 8 kHz.
+  kVadStageFeatures,      // Filter bank or spectrum, and log energies.
+  kVadStageLikelihood,    // GMM probabilities and raw decision.
+  kVadStageUpdate,        // Model update.
+  kVadNumStages
+} VadStage;
+
+typedef struct {
+  // Frames passed to WebRtcVad_Process(), per rate.
+  uint64_t frames[kVadStatsNumRates];
+  uint64_t speech_frames;
+  uint64_t non_speech_frames;
+  // Frames with too little energy to run the GMM.
+  uint64_t low_energy_frames;
+  // Speech decisions coming from the hangover only.
+  uint64_t hangover_frames;
+  // Frames resolved by WebRtcVad_set_silence_skip() without the filter bank.
+  uint64_t silent_frames_skipped;
+  uint64_t model_updates;
+  uint64_t model_updates_skipped;
+  // Time per stage, in time stamp counter ticks on x86, nanoseconds
+  // elsewhere.
+  uint64_t ticks[kVadNumStages];
+} VadStats;
+
+// Reads the statistics of an instance since WebRtcVad_Init() or the last
+// reset.
+//
+// - handle [i/o] : VAD instance.
+// - stats  [o]   : Snapshot of the statistics.
+// - reset  [i]   : 1 - clear the statistics after reading them.
+//
+// returns        : 0 - (OK), -1 - (NULL pointer, not initialized or not
+//                  built with WEBRTC_VAD_STATS)
+int WebRtcVad_get_stats(VadInst* handle, VadStats* stats, int reset);
+
+// Reads the statistics of all instances processed on the calling thread.
+//
+// - stats  [o]   : Snapshot of the statistics.
+// - reset  [i]   : 1 - clear the statistics after reading them.
+//
+// returns        : 0 - (OK), -1 - (NULL pointer or not built with
+//                  WEBRTC_VAD_STATS)
+int WebRtcVad_get_thread_stats(VadStats* stats, int reset);
+
+// Timeline tracing for offline runs, built with WEBRTC_VAD_TRACE. While a
+// trace is running, every frame and each of its stages (see VadStage) is
+// recorded as a span of the calling thread into a bounded buffer; spans
+// beyond it are dropped and counted. Applications add their own spans,
+// e.g., for I/O and scheduling. WebRtcVad_TraceStop() writes the spans as
+// Chrome trace event JSON, for chrome://tracing or Perfetto.
+//
+// Start and stop a trace while no other thread processes or traces.
+
+// Starts a trace.
+//
+// - max_events [i] : Capacity of the span buffer.
+//
+// returns          : 0 - (OK), -1 - (already running, out of memory or not
+//                    built with WEBRTC_VAD_TRACE)
+int WebRtcVad_TraceStart(size_t max_events);
+
+// Names the calling thread in the trace, e.g., "worker 3". The name is
+// copied and truncated to 31 characters.
+//
+// returns          : 0 - (OK), -1 - (no trace running or NULL name)
+int WebRtcVad_TraceThreadName(const char* name);
+
+// Returns the trace clock, in nanoseconds.
+uint64_t WebRtcVad_TraceNow(void);
+
+// Records a span of the calling thread.
+//
+// - name       [i] : Span name, must stay valid until WebRtcVad_TraceStop().
+// - category   [i] : Span category, same lifetime as |name|.
+// - start_ns   [i] : Start, from WebRtcVad_TraceNow().
+// - end_ns     [i] : End, from WebRtcVad_TraceNow().
+//
+// returns          : 0 - (OK), -1 - (no trace running or buffer full)
+int WebRtcVad_TraceSpan(const char* name, const char* category,
+                        uint64_t start_ns, uint64_t end_ns);
+
+// Stops the trace and writes it to |path|.
+//
+// - path       [i] : Output JSON file, or NULL to discard the trace.
+//
+// returns          : Number of dropped spans (>= 0) - (OK), -1 - (no trace
+//                    running or |path| cannot be written)
+int64_t WebRtcVad_TraceStop(const char* path);
+
+// Latency histogram of WebRtcVad_Process() calls, in nanoseconds. Buckets
+// are logarithmic with 16 linear sub-buckets per power of two, so any value
+// is placed within 1/16 (6.25%) of its true value, up to 2^36 ns (68 s);
+// larger values go to the last bucket. A zero initialized histogram is empty.
+// Recording is lock-free, so a histogram may be shared by all instances of a
+// worker thread and read by a monitoring thread at the same time.
+enum { kVadLatencySubBuckets = 16 };
+enum { kVadLatencyBuckets = 33 * kVadLatencySubBuckets };
+
+typedef struct {
+  uint64_t counts[kVadLatencyBuckets];
+  uint64_t count;
+  uint64_t sum_ns;
+  uint64_t max_ns;
+} VadLatencyHistogram;
+
+// Attaches histograms to an instance. Every subsequent WebRtcVad_Process()
+// call is timed and recorded into both. They stay attached across
+// WebRtcVad_Init() and are not copied by WebRtcVad_Clone().
+//
+// - handle [i/o] : VAD instance.
+// - stream [i]   : Histogram of this instance only, or NULL.
+// - worker [i]   : Histogram shared with other instances, or NULL.
+//
+// returns        : 0 - (OK), -1 - (NULL handle or not initialized)
+int WebRtcVad_set_latency_histograms(VadInst* handle,
+                                     VadLatencyHistogram* stream,
+                                     VadLatencyHistogram* worker);
+
+// Records one latency value. Lock-free, may be called from any thread.
+void WebRtcVad_RecordLatency(VadLatencyHistogram* histogram, uint64_t ns);
+
+// Copies |histogram| into |snapshot| while it may be recorded into. With
+// |reset| the copied counts are removed from |histogram|, so that no record
+// is lost or counted twice.
+void WebRtcVad_SnapshotLatency(VadLatencyHistogram* histogram,
+                               VadLatencyHistogram* snapshot, int reset);
+
+// Adds the snapshot |source| to the snapshot |target|, e.g., to combine the
+// streams of a worker or the workers of a process.
+void WebRtcVad_MergeLatency(VadLatencyHistogram* target,
+                            const VadLatencyHistogram* source);
+
+// Returns the latency at |percentile| (0 - 100) of a snapshot, as the upper
+// bound of the bucket it falls into, but at most |max_ns|. Returns 0 if the
+// histogram is empty.
+uint64_t WebRtcVad_LatencyPercentile(const VadLatencyHistogram* snapshot,
+                                     double percentile);
+
 // Calculates a VAD decision for the |audio_frame|. For valid sampling rates
 // frame lengths, see the description of WebRtcVad_ValidRatesAndFrameLengths().
 //
@@ -137,6 +468,111 @@ int WebRtcVad_set_mode(VadInst* handle, int mode);
 int WebRtcVad_Process(VadInst* handle, int fs, int16_t* audio_frame,
                       int frame_length);
 
+// Runs WebRtcVad_Process() on |num_frames| consecutive frames of |audio|,
+// e.g., a whole file. The samples are only read, so |audio| may point into a
+// read-only mapping.
+//
+// - handle       [i/o] : VAD Instance. Needs to be initialized by
+//                        WebRtcVad_Init() before call.
+// - fs           [i]   : Sampling frequency (Hz): 8000, 16000, 32000 or 48000
+// - audio        [i]   : |num_frames| * |frame_length| samples.
+// - frame_length [i]   : Length of each frame in number of samples.
+// - num_frames   [i]   : Number of frames in |audio|.
+// - decisions    [o]   : Decision per frame, 1 - (Active Voice),
+//                        0 - (Non-active Voice).
+//
+// returns              : 0 - (OK), -1 - (NULL pointer, not initialized,
+//                        invalid rate or frame length)
+int WebRtcVad_ProcessBatch(VadInst* handle, int fs, const int16_t* audio,
+                           int frame_length, size_t num_frames,
+                           uint8_t* decisions);
+
+// Runs one instance per channel on interleaved audio, e.g., stereo or
+// 8-channel recordings, without deinterleaving into scratch buffers. Sample
+// n of channel c in frame i is audio[(i * frame_length + n) * stride + c].
+// The first filter stage of each instance reads its channel directly, and
+// the channels of a frame are processed one after the other, so every frame
+// is brought into the cache once. Each instance keeps its own configuration.
+//
+// - handles      [i/o] : |num_channels| VAD instances, initialized by
+//                        WebRtcVad_Init().
+// - num_channels [i]   : Number of channels to process, > 0.
+// - stride       [i]   : Number of interleaved channels in |audio|, at least
+//                        |num_channels|. Channels from |num_channels| on
+//                        are skipped.
+// - fs           [i]   : Sampling frequency (Hz): 8000, 16000, 32000 or 48000
+// - audio        [i]   : |num_frames| * |frame_length| * |stride| samples.
+// - frame_length [i]   : Length of each frame, in samples per channel.
+// - num_frames   [i]   : Number of frames in |audio|.
+// - decisions    [o]   : |num_frames| * |num_channels| decisions, frame by
+//                        frame, 1 - (Active Voice), 0 - (Non-active Voice).
+//
+// returns              : 0 - (OK), -1 - (NULL pointer, not initialized,
+//                        invalid channel count, stride, rate or frame
+//                        length)
+int WebRtcVad_ProcessInterleaved(VadInst* const* handles, int num_channels,
+                                 int stride, int fs, const int16_t* audio,
+                                 int frame_length, size_t num_frames,
+                                 uint8_t* decisions);
+
+// Sample formats of WebRtcVad_ProcessFormat().
+enum {
+  kVadFormatS16 = 0,    // int16_t, as for WebRtcVad_Process().
+  kVadFormatMuLaw = 1,  // G.711 mu-law, one byte per sample.
+  kVadFormatALaw = 2,   // G.711 A-law, one byte per sample.
+  kVadFormatFloat = 3,  // float, full scale at -1.0 and 1.0.
+  kVadFormatS24LE = 4,  // Packed 24-bit little endian, 3 bytes per sample.
+  kVadFormatS32LE = 5   // 32-bit little endian.
+};
+
+// WebRtcVad_Process() on a frame in another sample format, e.g., G.711 as
+// received or float from a neural network, without a conversion pass and
+// buffer in the caller. The frame is expanded to 16 bits inside the call,
+// into a buffer on the stack that the first filter stage then reads from the
+// L1 cache; G.711 is expanded with vector table lookups where the CPU has
+// AVX2. Float samples are scaled by 32768, rounded and saturated, 24 and
+// 32-bit samples are truncated to their upper 16 bits. Decisions on 16-bit
+// samples converted losslessly to any of the formats are the same as
+// WebRtcVad_Process() on the 16-bit samples.
+//
+// - handle       [i/o] : VAD Instance. Needs to be initialized by
+//                        WebRtcVad_Init() before call.
+// - fs           [i]   : Sampling frequency (Hz): 8000, 16000, 32000 or 48000
+// - format       [i]   : Sample format of |audio_frame|, kVadFormatS16 etc.
+// - audio_frame  [i]   : Audio frame buffer, |frame_length| samples of
+//                        |format|.
+// - frame_length [i]   : Length of audio frame buffer in number of samples.
+//
+// returns              : 1 - (Active Voice),
+//                        0 - (Non-active Voice),
+//                       -1 - (Error)
+int WebRtcVad_ProcessFormat(VadInst* handle, int fs, int format,
+                            const void* audio_frame, int frame_length);
+
+// Advances the VAD by |num_frames| frames known to be non-speech, e.g.,
+// comfort noise or DTX periods signalled by a codec, without any audio. The
+// hangover runs as if WebRtcVad_Process() had returned non-speech for every
+// frame. If |features| is given, the noise model is also adapted to it on
+// every frame and the frame counter advances, as for an audible noise frame.
+// Otherwise the frames are treated like digital silence and only the hangover
+// changes. The filter states are not touched, so the next call to
+// WebRtcVad_Process() continues from the last real frame.
+//
+// - handle       [i/o] : VAD Instance. Needs to be initialized by
+//                        WebRtcVad_Init() before call.
+// - fs           [i]   : Sampling frequency (Hz) of the skipped frames.
+// - frame_length [i]   : Length of each skipped frame in number of samples.
+// - num_frames   [i]   : Number of frames to skip, > 0.
+// - features     [i]   : Background noise level, 10 * log10(energy) in Q4
+//                        for each of the 6 frequency bands of
+//                        WebRtcVad_CalculateFeatures(), or NULL.
+//
+// returns              : 1 - (Active Voice, hangover of the last frame),
+//                        0 - (Non-active Voice),
+//                       -1 - (Error)
+int WebRtcVad_ProcessNonSpeech(VadInst* handle, int fs, int frame_length,
+                               int num_frames, const int16_t* features);
+
 // Checks for valid combinations of |rate| and |frame_length|. We support 10,
 // 20 and 30 ms frames and the rates 8000, 16000 and 32000 Hz.
 //
@@ -153,8 +589,15 @@ typedef int (*RealInverseFFT)(struct RealFFT* self,
                               const int16_t* data_in,
                               int16_t* data_out);
 
+#if defined(WEBRTC_SPL_POINTER_DISPATCH)
 extern RealForwardFFT WebRtcSpl_RealForwardFFT;
 extern RealInverseFFT WebRtcSpl_RealInverseFFT;
+#else
+int WebRtcSpl_RealForwardFFT(struct RealFFT* self, const int16_t* data_in,
+                             int16_t* data_out);
+int WebRtcSpl_RealInverseFFT(struct RealFFT* self, const int16_t* data_in,
+                             int16_t* data_out);
+#endif
 
 struct RealFFT* WebRtcSpl_CreateRealFFT(int order);
 void WebRtcSpl_FreeRealFFT(struct RealFFT* self);
@@ -182,6 +625,16 @@ int WebRtcSpl_RealForwardFFTNeon(struct RealFFT* self,
                                  const int16_t* data_in,
                                  int16_t* data_out);
 #endif
+#if defined(WEBRTC_USE_SSE2) || defined(WEBRTC_SPL_SSE2_IFUNC)
+int WebRtcSpl_RealForwardFFTSSE2(struct RealFFT* self,
+                                 const int16_t* data_in,
+                                 int16_t* data_out);
+#endif
+#if defined(WEBRTC_SPL_AVX2)
+int WebRtcSpl_RealForwardFFTAVX2(struct RealFFT* self,
+                                 const int16_t* data_in,
+                                 int16_t* data_out);
+#endif
 
 // Compute the inverse FFT for a complex signal of length 2^order.
 // Input Arguments:
@@ -205,6 +658,16 @@ int WebRtcSpl_RealInverseFFTNeon(struct RealFFT* self,
                                  const int16_t* data_in,
                                  int16_t* data_out);
 #endif
+#if defined(WEBRTC_USE_SSE2) || defined(WEBRTC_SPL_SSE2_IFUNC)
+int WebRtcSpl_RealInverseFFTSSE2(struct RealFFT* self,
+                                 const int16_t* data_in,
+                                 int16_t* data_out);
+#endif
+#if defined(WEBRTC_SPL_AVX2)
+int WebRtcSpl_RealInverseFFTAVX2(struct RealFFT* self,
+                                 const int16_t* data_in,
+                                 int16_t* data_out);
+#endif
 
 #ifdef __cplusplus
 }
@@ -428,12 +891,26 @@ extern "C"
    memmove(v1, v2, (length) * sizeof(WebRtc_Word16))
 
 
-// Initialize SPL. Currently it contains only function pointer initialization.
-// If the underlying platform is known to be ARM-Neon (WEBRTC_ARCH_ARM_NEON
-// defined), the pointers will be assigned to code optimized for Neon; otherwise
-// if run-time Neon detection (WEBRTC_DETECT_ARM_NEON) is enabled, the pointers
-// will be assigned to either Neon code or generic C code; otherwise, generic C
-// code will be assigned.
+// Kernels with several implementations (WebRtcSpl_MaxAbsValueW16() and the
+// others declared under WEBRTC_SPL_POINTER_DISPATCH below) are plain
+// functions, bound to the implementation for the build target when the
+// library is compiled, so calls to them are direct and can be inlined. Where
+// the choice depends on the CPU (WEBRTC_SPL_SSE2_IFUNC), an ifunc resolver
+// makes it once when the library is loaded.
+//
+// With run-time Neon detection (WEBRTC_DETECT_ARM_NEON), or when
+// WEBRTC_SPL_POINTER_DISPATCH is defined, e.g., to switch implementations in
+// tests, the kernels are function pointers instead.
+#if defined(WEBRTC_DETECT_ARM_NEON) && !defined(WEBRTC_SPL_POINTER_DISPATCH)
+#define WEBRTC_SPL_POINTER_DISPATCH
+#endif
+
+// Initialize SPL. With WEBRTC_SPL_POINTER_DISPATCH, it assigns the function
+// pointers: if the underlying platform is known to be ARM-Neon
+// (WEBRTC_ARCH_ARM_NEON defined), to code optimized for Neon; otherwise if
+// run-time Neon detection (WEBRTC_DETECT_ARM_NEON) is enabled, to either Neon
+// code or generic C code; otherwise, to SSE2 code where there is some, or
+// generic C code. Without pointers it does nothing.
 // Note that this function MUST be called in any application that uses SPL
 // functions.
 void WebRtcSpl_Init();
@@ -484,11 +961,18 @@ WebRtc_Word16 WebRtcSpl_OnesArrayW32(WebRtc_Word32* vector,
 // Return value  : Maximum absolute value in vector;
 //                 or -1, if (vector == NULL || length <= 0).
 typedef int16_t (*MaxAbsValueW16)(const int16_t* vector, int length);
+#if defined(WEBRTC_SPL_POINTER_DISPATCH)
 extern MaxAbsValueW16 WebRtcSpl_MaxAbsValueW16;
+#else
+int16_t WebRtcSpl_MaxAbsValueW16(const int16_t* vector, int length);
+#endif
 int16_t WebRtcSpl_MaxAbsValueW16C(const int16_t* vector, int length);
 #if (defined WEBRTC_DETECT_ARM_NEON) || (defined WEBRTC_ARCH_ARM_NEON)
 int16_t WebRtcSpl_MaxAbsValueW16Neon(const int16_t* vector, int length);
 #endif
+#if defined(WEBRTC_USE_SSE2) || defined(WEBRTC_SPL_SSE2_IFUNC)
+int16_t WebRtcSpl_MaxAbsValueW16SSE2(const int16_t* vector, int length);
+#endif
 
 // Returns the largest absolute value in a signed 32-bit vector.
 //
@@ -499,7 +983,11 @@ int16_t WebRtcSpl_MaxAbsValueW16Neon(const int16_t* vector, int length);
 // Return value  : Maximum absolute value in vector;
 //                 or -1, if (vector == NULL || length <= 0).
 typedef int32_t (*MaxAbsValueW32)(const int32_t* vector, int length);
+#if defined(WEBRTC_SPL_POINTER_DISPATCH)
 extern MaxAbsValueW32 WebRtcSpl_MaxAbsValueW32;
+#else
+int32_t WebRtcSpl_MaxAbsValueW32(const int32_t* vector, int length);
+#endif
 int32_t WebRtcSpl_MaxAbsValueW32C(const int32_t* vector, int length);
 #if (defined WEBRTC_DETECT_ARM_NEON) || (defined WEBRTC_ARCH_ARM_NEON)
 int32_t WebRtcSpl_MaxAbsValueW32Neon(const int32_t* vector, int length);
@@ -516,7 +1004,11 @@ int32_t WebRtcSpl_MaxAbsValueW32Neon(const int32_t* vector, int length);
 //                 is returned. Note that WEBRTC_SPL_WORD16_MIN is a feasible
 //                 value and we can't catch errors purely based on it.
 typedef int16_t (*MaxValueW16)(const int16_t* vector, int length);
+#if defined(WEBRTC_SPL_POINTER_DISPATCH)
 extern MaxValueW16 WebRtcSpl_MaxValueW16;
+#else
+int16_t WebRtcSpl_MaxValueW16(const int16_t* vector, int length);
+#endif
 int16_t WebRtcSpl_MaxValueW16C(const int16_t* vector, int length);
 #if (defined WEBRTC_DETECT_ARM_NEON) || (defined WEBRTC_ARCH_ARM_NEON)
 int16_t WebRtcSpl_MaxValueW16Neon(const int16_t* vector, int length);
@@ -533,7 +1025,11 @@ int16_t WebRtcSpl_MaxValueW16Neon(const int16_t* vector, int length);
 //                 is returned. Note that WEBRTC_SPL_WORD32_MIN is a feasible
 //                 value and we can't catch errors purely based on it.
 typedef int32_t (*MaxValueW32)(const int32_t* vector, int length);
+#if defined(WEBRTC_SPL_POINTER_DISPATCH)
 extern MaxValueW32 WebRtcSpl_MaxValueW32;
+#else
+int32_t WebRtcSpl_MaxValueW32(const int32_t* vector, int length);
+#endif
 int32_t WebRtcSpl_MaxValueW32C(const int32_t* vector, int length);
 #if (defined WEBRTC_DETECT_ARM_NEON) || (defined WEBRTC_ARCH_ARM_NEON)
 int32_t WebRtcSpl_MaxValueW32Neon(const int32_t* vector, int length);
@@ -550,7 +1046,11 @@ int32_t WebRtcSpl_MaxValueW32Neon(const int32_t* vector, int length);
 //                 is returned. Note that WEBRTC_SPL_WORD16_MAX is a feasible
 //                 value and we can't catch errors purely based on it.
 typedef int16_t (*MinValueW16)(const int16_t* vector, int length);
+#if defined(WEBRTC_SPL_POINTER_DISPATCH)
 extern MinValueW16 WebRtcSpl_MinValueW16;
+#else
+int16_t WebRtcSpl_MinValueW16(const int16_t* vector, int length);
+#endif
 int16_t WebRtcSpl_MinValueW16C(const int16_t* vector, int length);
 #if (defined WEBRTC_DETECT_ARM_NEON) || (defined WEBRTC_ARCH_ARM_NEON)
 int16_t WebRtcSpl_MinValueW16Neon(const int16_t* vector, int length);
@@ -567,7 +1067,11 @@ int16_t WebRtcSpl_MinValueW16Neon(const int16_t* vector, int length);
 //                 is returned. Note that WEBRTC_SPL_WORD32_MAX is a feasible
 //                 value and we can't catch errors purely based on it.
 typedef int32_t (*MinValueW32)(const int32_t* vector, int length);
+#if defined(WEBRTC_SPL_POINTER_DISPATCH)
 extern MinValueW32 WebRtcSpl_MinValueW32;
+#else
+int32_t WebRtcSpl_MinValueW32(const int32_t* vector, int length);
+#endif
 int32_t WebRtcSpl_MinValueW32C(const int32_t* vector, int length);
 #if (defined WEBRTC_DETECT_ARM_NEON) || (defined WEBRTC_ARCH_ARM_NEON)
 int32_t WebRtcSpl_MinValueW32Neon(const int32_t* vector, int length);
@@ -689,7 +1193,17 @@ typedef int (*ScaleAndAddVectorsWithRound)(const int16_t* in_vector1,
                                            int right_shifts,
                                            int16_t* out_vector,
                                            int length);
+#if defined(WEBRTC_SPL_POINTER_DISPATCH)
 extern ScaleAndAddVectorsWithRound WebRtcSpl_ScaleAndAddVectorsWithRound;
+#else
+int WebRtcSpl_ScaleAndAddVectorsWithRound(const int16_t* in_vector1,
+                                          int16_t in_vector1_scale,
+                                          const int16_t* in_vector2,
+                                          int16_t in_vector2_scale,
+                                          int right_shifts,
+                                          int16_t* out_vector,
+                                          int length);
+#endif
 int WebRtcSpl_ScaleAndAddVectorsWithRoundC(const int16_t* in_vector1,
                                            int16_t in_vector1_scale,
                                            const int16_t* in_vector2,
@@ -708,6 +1222,49 @@ int WebRtcSpl_ScaleAndAddVectorsWithRoundNeon(const int16_t* in_vector1,
 #endif
 // End: Vector scaling operations.
 
+// Sample format conversions and their pointers.
+
+// Expands G.711 mu-law to 16-bit linear PCM, the decoder output values of
+// ITU-T G.711 scaled to 16 bits.
+//
+// Input:
+//      - in     : |length| mu-law bytes.
+//      - length : Number of samples.
+//
+// Output:
+//      - out    : |length| samples in [-32124, 32124].
+typedef void (*MuLawToW16)(const uint8_t* in, int length, int16_t* out);
+#if defined(WEBRTC_SPL_POINTER_DISPATCH)
+extern MuLawToW16 WebRtcSpl_MuLawToW16;
+#else
+void WebRtcSpl_MuLawToW16(const uint8_t* in, int length, int16_t* out);
+#endif
+void WebRtcSpl_MuLawToW16C(const uint8_t* in, int length, int16_t* out);
+#if defined(WEBRTC_SPL_AVX2)
+void WebRtcSpl_MuLawToW16AVX2(const uint8_t* in, int length, int16_t* out);
+#endif
+
+// Expands G.711 A-law to 16-bit linear PCM, the decoder output values of
+// ITU-T G.711 scaled to 16 bits.
+//
+// Input:
+//      - in     : |length| A-law bytes.
+//      - length : Number of samples.
+//
+// Output:
+//      - out    : |length| samples in [-32256, 32256].
+typedef void (*ALawToW16)(const uint8_t* in, int length, int16_t* out);
+#if defined(WEBRTC_SPL_POINTER_DISPATCH)
+extern ALawToW16 WebRtcSpl_ALawToW16;
+#else
+void WebRtcSpl_ALawToW16(const uint8_t* in, int length, int16_t* out);
+#endif
+void WebRtcSpl_ALawToW16C(const uint8_t* in, int length, int16_t* out);
+#if defined(WEBRTC_SPL_AVX2)
+void WebRtcSpl_ALawToW16AVX2(const uint8_t* in, int length, int16_t* out);
+#endif
+// End: Sample format conversions.
+
 // iLBC specific functions. Implementations in ilbc_specific_functions.c.
 // Description at bottom of file.
 void WebRtcSpl_ReverseOrderMultArrayElements(WebRtc_Word16* out_vector,
@@ -860,7 +1417,17 @@ typedef void (*CrossCorrelation)(int32_t* cross_correlation,
                                  int16_t dim_cross_correlation,
                                  int16_t right_shifts,
                                  int16_t step_seq2);
+#if defined(WEBRTC_SPL_POINTER_DISPATCH)
 extern CrossCorrelation WebRtcSpl_CrossCorrelation;
+#else
+void WebRtcSpl_CrossCorrelation(int32_t* cross_correlation,
+                                const int16_t* seq1,
+                                const int16_t* seq2,
+                                int16_t dim_seq,
+                                int16_t dim_cross_correlation,
+                                int16_t right_shifts,
+                                int16_t step_seq2);
+#endif
 void WebRtcSpl_CrossCorrelationC(int32_t* cross_correlation,
                                  const int16_t* seq1,
                                  const int16_t* seq2,
@@ -1000,7 +1567,18 @@ typedef int (*DownsampleFast)(const int16_t* data_in,
                               int coefficients_length,
                               int factor,
                               int delay);
+#if defined(WEBRTC_SPL_POINTER_DISPATCH)
 extern DownsampleFast WebRtcSpl_DownsampleFast;
+#else
+int WebRtcSpl_DownsampleFast(const int16_t* data_in,
+                             int data_in_length,
+                             int16_t* data_out,
+                             int data_out_length,
+                             const int16_t* __restrict coefficients,
+                             int coefficients_length,
+                             int factor,
+                             int delay);
+#endif
 int WebRtcSpl_DownsampleFastC(const int16_t* data_in,
                               int data_in_length,
                               int16_t* data_out,
@@ -1562,34 +2140,95 @@ enum { kNumGaussians = 2 };  // Number of Gaussians per channel in the GMM.
 enum { kTableSize = kNumChannels * kNumGaussians };
 enum { kMinEnergy = 10 };  // Minimum energy required to trigger audio signal.
 
+// Model and filter states of the float engine, see WebRtcVad_set_engine().
+// Means and standard deviations are in dB, the filter states on the scale of
+// the fixed point ones.
+typedef struct {
+    float noise_means[kTableSize];
+    float speech_means[kTableSize];
+    float noise_stds[kTableSize];
+    float speech_stds[kTableSize];
+    float upper_state[5];
+    float lower_state[5];
+    float hp_filter_state[4];
+} VadFloatState;
+
+// The instance is laid out hot-first. Everything read or written by every
+// call of WebRtcVad_Process() at 8 kHz lives in the first three cache lines:
+// the GMM parameters and the splitting filter states fill the first two
+// exactly, the third holds the decision state and the per-frame settings
+// (mode, silence shortcut, adaptation, feature mode, engine and the latency
+// histograms). The fourth starts with what only some frames need (the
+// downsampling filter from 16 kHz up, the float engine and 48 kHz states),
+// followed by the FindMinimum() window, which is only touched by frames above
+// |kMinEnergy|. The counters and the high band features come last. Per-mode
+// thresholds are shared read-only tables referenced by |mode|. The 48 kHz
+// resampler state is only allocated for instances that actually receive
+// 48 kHz audio, the float engine state for instances that select that engine.
 typedef struct VadInstT_
 {
-
-    int vad;
-    int32_t downsampling_filter_states[4];
-    WebRtcSpl_State48khzTo8khz state_48_to_8;
     int16_t noise_means[kTableSize];
     int16_t speech_means[kTableSize];
     int16_t noise_stds[kTableSize];
     int16_t speech_stds[kTableSize];
-    // TODO(bjornv): Change to |frame_count|.
-    int32_t frame_counter;
-    int16_t over_hang; // Over Hang
-    int16_t num_of_speech;
-    // TODO(bjornv): Change to |age_vector|.
-    int16_t index_vector[16 * kNumChannels];
-    int16_t low_value_vector[16 * kNumChannels];
     // TODO(bjornv): Change to |median|.
     int16_t mean_value[kNumChannels];
     int16_t upper_state[5];
     int16_t lower_state[5];
     int16_t hp_filter_state[4];
-    int16_t over_hang_max_1[3];
-    int16_t over_hang_max_2[3];
-    int16_t individual[3];
-    int16_t total[3];
-
+    // TODO(bjornv): Change to |frame_count|.
+    int32_t frame_counter;
+    int16_t over_hang; // Over Hang
+    int16_t num_of_speech;
+    int16_t vad;
+    int16_t mode;  // Aggressiveness mode, index into the shared mode tables.
+    // Silent frame shortcuts, see WebRtcVad_set_silence_skip().
+    int16_t silence_skip;
+    int16_t silence_threshold;
     int init_flag;
+    // Rate and frame length for which an all-zero frame is known to leave
+    // all filter states unchanged, 0 if none.
+    int32_t zero_input_key;
+
+    // Adaptation control, see WebRtcVad_set_adaptation().
+    int16_t adapt_interval;
+    int16_t adapt_drift_threshold;  // Q7
+    int16_t frames_since_update;
+    int16_t last_update_vad;
+    int16_t last_update_drift;  // Q7
+
+    // Feature extraction, see WebRtcVad_set_feature_mode().
+    int16_t feature_mode;
+
+    // Arithmetic, see WebRtcVad_set_engine().
+    int16_t engine;
+
+    // See WebRtcVad_set_latency_histograms(), NULL if not attached.
+    VadLatencyHistogram* latency_stream;
+    VadLatencyHistogram* latency_worker;
+
+    int32_t downsampling_filter_states[4];
+
+    // Allocated when the float engine is first selected, NULL otherwise.
+    VadFloatState* float_state;
+
+    // Allocated on the first 48 kHz frame, NULL otherwise.
+    WebRtcSpl_State48khzTo8khz* state_48_to_8;
+
+    int16_t low_value_vector[16 * kNumChannels];
+    // TODO(bjornv): Change to |age_vector|. Ages never exceed 101.
+    uint8_t index_vector[16 * kNumChannels];
+
+    // See WebRtcVad_get_adaptation_stats().
+    uint32_t model_updates;
+    uint32_t model_updates_skipped;
+
+    int16_t num_high_bands;  // Valid |high_band_features| of the last frame.
+    int16_t high_band_features[kVadNumHighBands];
+
+#if defined(WEBRTC_VAD_STATS)
+    VadStats stats;
+#endif
 
 } VadInstT;
 
@@ -1612,18 +2251,68 @@ int WebRtcVad_set_mode_core(VadInstT* self, int mode);
  * WebRtcVad_CalcVad16khz(...) 
  * WebRtcVad_CalcVad8khz(...) 
  *
+ * The frame is every |stride|th sample of |speech_frame|, |stride| is 1
+ * unless it is a channel of interleaved input.
+ *
  * Return value         : VAD decision
  *                        0 - No active speech
  *                        1-6 - Active speech
+ *                       -1 - Error (48 kHz only: the resampler state could
+ *                            not be allocated)
+ */
+int WebRtcVad_CalcVad48khz(VadInstT* inst, const int16_t* speech_frame,
+                           int stride, int frame_length);
+int WebRtcVad_CalcVad32khz(VadInstT* inst, const int16_t* speech_frame,
+                           int stride, int frame_length);
+int WebRtcVad_CalcVad16khz(VadInstT* inst, const int16_t* speech_frame,
+                           int stride, int frame_length);
+int WebRtcVad_CalcVad8khz(VadInstT* inst, const int16_t* speech_frame,
+                          int stride, int frame_length);
+
+/****************************************************************************
+ * WebRtcVad_CalcVadSpectral(...)
+ *
+ * As the above, with the features of WebRtcVad_CalculateSpectralFeatures()
+ * computed at the native rate |fs|.
+ */
+int WebRtcVad_CalcVadSpectral(VadInstT* inst, int fs,
+                              const int16_t* speech_frame, int stride,
+                              int frame_length);
+
+/****************************************************************************
+ * WebRtcVad_SmoothDecision(...)
+ *
+ * Applies the hangover (transition hysteresis) to a raw decision and stores
+ * the result in |self->vad|.
+ *
+ * Input:
+ *      - self          : VAD instance.
+ *      - vadflag       : Raw decision, 0 - noise, 1 - speech.
+ *      - frame_length  : Frame length in samples at 8 kHz (80, 160 or 240).
+ *
+ * Return value         : VAD decision
+ *                        0 - No active speech
+ *                        1 - Active speech
+ *                        >1 - Active speech during hangover (2 + frames left)
+ */
+int16_t WebRtcVad_SmoothDecision(VadInstT* self, int16_t vadflag,
+                                 int frame_length);
+
+/****************************************************************************
+ * WebRtcVad_AdaptToNoise(...)
+ *
+ * Adapts the GMM to a frame with the given features, as if the frame had
+ * been classified as noise. The adaptation control of
+ * WebRtcVad_set_adaptation() applies. No decision is made.
+ *
+ * Input:
+ *      - self          : VAD instance.
+ *      - features      : Feature vector of length |kNumChannels|, in the
+ *                        format of WebRtcVad_CalculateFeatures().
+ *      - frame_length  : Frame length in samples at 8 kHz (80, 160 or 240).
  */
-int WebRtcVad_CalcVad48khz(VadInstT* inst, int16_t* speech_frame,
-                           int frame_length);
-int WebRtcVad_CalcVad32khz(VadInstT* inst, int16_t* speech_frame,
-                           int frame_length);
-int WebRtcVad_CalcVad16khz(VadInstT* inst, int16_t* speech_frame,
-                           int frame_length);
-int WebRtcVad_CalcVad8khz(VadInstT* inst, int16_t* speech_frame,
-                          int frame_length);
+void WebRtcVad_AdaptToNoise(VadInstT* self, const int16_t* features,
+                            int frame_length);
 
 #endif  // WEBRTC_COMMON_AUDIO_VAD_VAD_CORE_H_
 
@@ -1646,12 +2335,35 @@ int WebRtcVad_CalcVad8khz(VadInstT* inst, int16_t* speech_frame,
 //
 // - self         [i/o] : State information of the VAD.
 // - data_in      [i]   : Input audio data, for feature extraction.
+// - stride       [i]   : Distance between the samples of |data_in|, 1 unless
+//                        it is a channel of interleaved input.
 // - data_length  [i]   : Audio data size, in number of samples.
 // - features     [o]   : 10 * log10(energy in each frequency band), Q4.
 // - returns            : Total energy of the signal (NOTE! This value is not
 //                        exact. It is only used in a comparison.)
 int16_t WebRtcVad_CalculateFeatures(VadInstT* self, const int16_t* data_in,
-                                    int data_length, int16_t* features);
+                                    int stride, int data_length,
+                                    int16_t* features);
+
+// Calculates the same |kNumChannels| log energies as
+// WebRtcVad_CalculateFeatures() from the spectrum of |data_in| at its native
+// rate, without resampling and without touching the filter states. The
+// frame is transformed in 10 ms blocks, two per FFT. The band energies are
+// scaled such that a stationary signal gets about the features of the filter
+// bank. The bands above 4 kHz are written to |self->high_band_features|.
+//
+// - self         [i/o] : State information of the VAD.
+// - fs           [i]   : Sampling rate, 8000, 16000, 32000 or 48000 Hz.
+// - data_in      [i]   : Input audio data, 10, 20 or 30 ms.
+// - stride       [i]   : Distance between the samples of |data_in|.
+// - data_length  [i]   : Audio data size, in number of samples.
+// - features     [o]   : 10 * log10(energy in each frequency band), Q4.
+// - returns            : Total energy of the signal, see
+//                        WebRtcVad_CalculateFeatures().
+int16_t WebRtcVad_CalculateSpectralFeatures(VadInstT* self, int fs,
+                                            const int16_t* data_in,
+                                            int stride, int data_length,
+                                            int16_t* features);
 
 #endif  // WEBRTC_COMMON_AUDIO_VAD_VAD_FILTERBANK_H_
 
@@ -1673,9 +2385,14 @@ int32_t WebRtcVad_GaussianProbability(int16_t input,
 #define WEBRTC_COMMON_AUDIO_VAD_VAD_SP_H_
 
 // Downsamples the signal by a factor 2, eg. 32->16 or 16->8.
+// Input:
+//      - signal_in     : Every |in_stride|th sample is used, |in_length| in
+//                        total. |in_stride| is 1 unless the input is
+//                        interleaved.
 // Output:
 //      - signal_out    : Downsampled signal (of length |in_length| / 2).
-void WebRtcVad_Downsampling(int16_t* signal_in,
+void WebRtcVad_Downsampling(const int16_t* signal_in,
+                            int in_stride,
                             int16_t* signal_out,
                             int32_t* filter_state,
                             int in_length);
@@ -1700,6 +2417,43 @@ int16_t WebRtcVad_FindMinimum(VadInstT* handle,
 
 #endif  // WEBRTC_COMMON_AUDIO_VAD_VAD_SP_H_
 
+
+#ifndef WEBRTC_COMMON_AUDIO_VAD_VAD_FLOAT_H_
+#define WEBRTC_COMMON_AUDIO_VAD_VAD_FLOAT_H_
+
+// Converts the GMM parameters and the filter bank states of |self| from the
+// representation of the current engine to that of |engine|, see
+// WebRtcVad_set_engine(). Does not change |self->engine|.
+void WebRtcVad_ConvertEngineState(VadInstT* self, int engine);
+
+// Float version of WebRtcVad_CalculateFeatures(), using the filter states of
+// |self->float_state|.
+//
+// - self         [i/o] : State information of the VAD.
+// - data_in      [i]   : Input audio data at 8 kHz.
+// - stride       [i]   : Distance between the samples of |data_in|.
+// - data_length  [i]   : Audio data size, in number of samples.
+// - features     [o]   : 10 * log10(energy in each frequency band), in dB.
+// - returns            : Total energy of the signal.
+float WebRtcVad_CalculateFeaturesFloat(VadInstT* self, const int16_t* data_in,
+                                       int stride, int data_length,
+                                       float* features);
+
+// Float versions of the GMM of vad_core.c. WebRtcVad_GmmProbabilityFloat()
+// makes the decision of a frame, adapts the model and applies the hangover,
+// WebRtcVad_AdaptToNoiseFloat() is as WebRtcVad_AdaptToNoise().
+//
+// - self         [i/o] : State information of the VAD.
+// - features     [i]   : Features in dB, see WebRtcVad_CalculateFeaturesFloat().
+// - total_power  [i]   : Total energy of the frame.
+// - frame_length [i]   : Frame length in samples at 8 kHz (80, 160 or 240).
+int16_t WebRtcVad_GmmProbabilityFloat(VadInstT* self, const float* features,
+                                      float total_power, int frame_length);
+void WebRtcVad_AdaptToNoiseFloat(VadInstT* self, const float* features,
+                                 int frame_length);
+
+#endif  // WEBRTC_COMMON_AUDIO_VAD_VAD_FLOAT_H_
+
 /**
  * handle 结果地址
  * kFrameLengths 帧长 { 80, 120, 160, 240, 320, 480, 640, 960 }
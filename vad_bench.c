@@ -0,0 +1,474 @@
+// Throughput benchmark of WebRtcVad_Process().
+//
+// Usage: vad_bench [-d ms] [-k filter] [-o out.json] [-b baseline.json]
+//                  [-T tolerance_percent] [-l] [-f features] [-e engine]
+//                  [file.wav ...]
+//
+// Every signal (the given files, default deb.wav and deb_01.wav, plus
+// synthetic noise, tone and silence) is run at every supported rate, frame
+// length and mode. Each configuration is repeated for at least -d ms
+// (default 100) after one warm-up pass. Reported per configuration:
+//   ns/frame      wall clock time per frame
+//   cycles/frame  CPU cycles from perf_event_open, or the time stamp counter
+//                 where perf events are not available
+//   instr/frame   retired instructions, perf_event_open only
+//   rtf           real-time factor, processing time / audio time
+// The results are written as JSON with -o. With -b they are compared with a
+// saved JSON file and configurations slower than the tolerance (default 5%)
+// are flagged; the exit code is then 2. With -l the latency of every
+// WebRtcVad_Process() call is recorded as well and its p50, p99, p99.9 and
+// max are printed; the clock reads add to ns/frame. -f selects the feature
+// extractor, "filterbank" (the default), "spectral" or "both"; spectral
+// configurations are named with a "/spectral" suffix. -e selects the
+// arithmetic of the features and the GMM likewise, "fixed" (the default),
+// "float" or "both", with a "/float" suffix.
+
+#include <linux/perf_event.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vad.h"
+#include "wav_reader.h"
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+#include <x86intrin.h>
+#endif
+
+enum { kMaxSignals = 16 };
+enum { kMaxResults = 1024 };
+enum { kSyntheticSeconds = 10 };
+enum { kSignalNameLength = 48 };
+enum { kNameLength = 96 };
+
+typedef struct {
+  char name[kSignalNameLength];
+  const int16_t* samples;
+  size_t num_samples;
+} Signal;
+
+typedef struct {
+  char name[kNameLength];
+  int rate;
+  int frame_ms;
+  int mode;
+  double ns_per_frame;
+  double cycles_per_frame;
+  double instructions_per_frame;  // < 0 if not measured.
+  double rtf;
+} Result;
+
+// Hardware counters, a cycle counter leading an instruction counter.
+typedef struct {
+  int cycles_fd;
+  int instructions_fd;
+} PerfCounters;
+
+static double NowNs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t ReadTsc(void) {
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static int OpenCounter(uint64_t config, int group_fd) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = group_fd == -1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int) syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+static void OpenPerfCounters(PerfCounters* counters) {
+  counters->cycles_fd = OpenCounter(PERF_COUNT_HW_CPU_CYCLES, -1);
+  counters->instructions_fd = -1;
+  if (counters->cycles_fd >= 0) {
+    counters->instructions_fd = OpenCounter(PERF_COUNT_HW_INSTRUCTIONS,
+                                            counters->cycles_fd);
+  }
+}
+
+static void ClosePerfCounters(PerfCounters* counters) {
+  if (counters->instructions_fd >= 0) {
+    close(counters->instructions_fd);
+  }
+  if (counters->cycles_fd >= 0) {
+    close(counters->cycles_fd);
+  }
+}
+
+static uint64_t ReadCounter(int fd) {
+  uint64_t value = 0;
+
+  if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) {
+    return 0;
+  }
+  return value;
+}
+
+// Fills |samples| with a deterministic synthetic signal.
+// Writes the name of a configuration, as used for -k and in the JSON file.
+static void ConfigName(char* name, size_t size, const char* signal_name,
+                       int rate, int frame_ms, int mode, int features,
+                       int engine) {
+  snprintf(name, size, "%.47s/%d/%dms/mode%d%s%s", signal_name, rate,
+           frame_ms, mode,
+           features == kVadFeaturesSpectral ? "/spectral" : "",
+           engine == kVadEngineFloat ? "/float" : "");
+}
+
+static void Synthesize(const char* kind, int16_t* samples, size_t length) {
+  uint32_t seed = 12345;
+  size_t i;
+
+  for (i = 0; i < length; i++) {
+    if (strcmp(kind, "noise") == 0) {
+      seed = seed * 1103515245 + 12345;
+      samples[i] = (int16_t) ((int32_t) (seed >> 16) - 32768) / 8;
+    } else if (strcmp(kind, "tone") == 0) {
+      samples[i] = (int16_t) (8000 * sin(2 * M_PI * 440.0 * i / 16000));
+    } else {
+      samples[i] = 0;
+    }
+  }
+}
+
+// Runs |signal| through one instance for at least |min_ns|, in whole passes.
+// The latency of every frame after the warm-up goes to |latency|, if given.
+static int RunConfig(const Signal* signal, int rate, int frame_ms, int mode,
+                     int features, int engine, double min_ns,
+                     PerfCounters* counters,
+                     VadLatencyHistogram* latency, Result* result) {
+  const int frame_length = rate / 1000 * frame_ms;
+  const size_t num_frames = signal->num_samples / frame_length;
+  VadInst* handle = NULL;
+  double frames = 0;
+  double elapsed = 0;
+  double start;
+  uint64_t tsc = 0, cycles = 0, instructions = 0;
+  uint64_t tsc_start;
+  size_t i;
+  int pass;
+
+  if (num_frames == 0) {
+    return -1;
+  }
+  if (WebRtcVad_Create(&handle) != 0 || WebRtcVad_Init(handle) != 0 ||
+      WebRtcVad_set_mode(handle, mode) != 0 ||
+      WebRtcVad_set_feature_mode(handle, features) != 0 ||
+      WebRtcVad_set_engine(handle, engine) != 0) {
+    WebRtcVad_Free(handle);
+    return -1;
+  }
+
+  for (pass = 0; pass == 0 || elapsed < min_ns; pass++) {
+    // Pass 0 warms up caches, branch predictors and the model.
+    if (pass == 1 && latency != NULL) {
+      WebRtcVad_set_latency_histograms(handle, latency, NULL);
+    }
+    if (pass == 1 && counters->cycles_fd >= 0) {
+      ioctl(counters->cycles_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(counters->cycles_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    start = NowNs();
+    tsc_start = ReadTsc();
+    for (i = 0; i < num_frames; i++) {
+      WebRtcVad_Process(handle, rate,
+                        (int16_t*) signal->samples + i * frame_length,
+                        frame_length);
+    }
+    if (pass > 0) {
+      tsc += ReadTsc() - tsc_start;
+      elapsed += NowNs() - start;
+      frames += num_frames;
+    }
+  }
+  if (counters->cycles_fd >= 0) {
+    ioctl(counters->cycles_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    cycles = ReadCounter(counters->cycles_fd);
+    instructions = ReadCounter(counters->instructions_fd);
+  }
+  WebRtcVad_Free(handle);
+
+  ConfigName(result->name, sizeof(result->name), signal->name, rate,
+             frame_ms, mode, features, engine);
+  result->rate = rate;
+  result->frame_ms = frame_ms;
+  result->mode = mode;
+  result->ns_per_frame = elapsed / frames;
+  result->cycles_per_frame = (cycles > 0 ? cycles : tsc) / frames;
+  result->instructions_per_frame =
+      counters->instructions_fd >= 0 ? instructions / frames : -1;
+  result->rtf = result->ns_per_frame / (frame_ms * 1e6);
+  return 0;
+}
+
+static void WriteJson(FILE* file, const Result* results, int num_results,
+                      const char* cycles_source) {
+  int i;
+
+  fprintf(file, "{\n  \"cycles_source\": \"%s\",\n  \"results\": [\n",
+          cycles_source);
+  // One result per line, see BaselineNsPerFrame().
+  for (i = 0; i < num_results; i++) {
+    const Result* r = &results[i];
+    fprintf(file, "    {\"name\": \"%s\", \"rate\": %d, \"frame_ms\": %d, "
+            "\"mode\": %d, \"ns_per_frame\": %.1f, \"cycles_per_frame\": %.1f, "
+            "\"instructions_per_frame\": ", r->name, r->rate, r->frame_ms,
+            r->mode, r->ns_per_frame, r->cycles_per_frame);
+    if (r->instructions_per_frame >= 0) {
+      fprintf(file, "%.1f", r->instructions_per_frame);
+    } else {
+      fprintf(file, "null");
+    }
+    fprintf(file, ", \"rtf\": %.6f}%s\n", r->rtf,
+            i + 1 < num_results ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+}
+
+// Reads the ns/frame of |name| from a file written by WriteJson(). Returns
+// a negative value if the configuration is not in the baseline.
+static double BaselineNsPerFrame(FILE* file, const char* name) {
+  char line[512];
+  char key[kNameLength + 16];
+  const char* field;
+
+  snprintf(key, sizeof(key), "\"name\": \"%.*s\"", kNameLength - 1, name);
+  rewind(file);
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (strstr(line, key) == NULL) {
+      continue;
+    }
+    field = strstr(line, "\"ns_per_frame\": ");
+    if (field != NULL) {
+      return atof(field + strlen("\"ns_per_frame\": "));
+    }
+  }
+  return -1;
+}
+
+// Prints a line of the result table, with the latency percentiles if
+// |latency| is given.
+static void PrintResult(const Result* result,
+                        const VadLatencyHistogram* latency) {
+  printf("%-36s %10.1f %12.1f ", result->name, result->ns_per_frame,
+         result->cycles_per_frame);
+  if (result->instructions_per_frame >= 0) {
+    printf("%12.1f", result->instructions_per_frame);
+  } else {
+    printf("%12s", "-");
+  }
+  printf(" %10.6f", result->rtf);
+  if (latency != NULL) {
+    printf(" %8llu %8llu %8llu %8llu",
+           (unsigned long long) WebRtcVad_LatencyPercentile(latency, 50),
+           (unsigned long long) WebRtcVad_LatencyPercentile(latency, 99),
+           (unsigned long long) WebRtcVad_LatencyPercentile(latency, 99.9),
+           (unsigned long long) latency->max_ns);
+  }
+  printf("\n");
+}
+
+static void Usage(void) {
+  fprintf(stderr, "usage: vad_bench [-d ms] [-k filter] [-o out.json] "
+          "[-b baseline.json] [-T tolerance_percent] [-l] "
+          "[-f filterbank|spectral|both] [-e fixed|float|both] "
+          "[file.wav ...]\n");
+}
+
+int main(int argc, char* argv[]) {
+  static const int kRates[] = { 8000, 16000, 32000, 48000 };
+  static const char* kSynthetic[] = { "noise", "tone", "silence" };
+  static const char* kDefaultFiles[] = { "deb.wav", "deb_01.wav" };
+  static Result results[kMaxResults];
+  Signal signals[kMaxSignals];
+  WavReader readers[kMaxSignals];
+  int16_t* synthetic[3] = { NULL, NULL, NULL };
+  int num_signals = 0, num_readers = 0, num_results = 0;
+  double min_ns = 100e6;
+  double tolerance = 5;
+  const char* filter = NULL;
+  const char* json_path = NULL;
+  const char* baseline_path = NULL;
+  const char** files;
+  int num_files;
+  int regressions = 0;
+  int measure_latency = 0;
+  // Feature extractors to run, kVadFeaturesFilterBank up to |last_features|.
+  int first_features = kVadFeaturesFilterBank;
+  int last_features = kVadFeaturesFilterBank;
+  // Engines to run, likewise.
+  int first_engine = kVadEngineFixed;
+  int last_engine = kVadEngineFixed;
+  PerfCounters counters;
+  int s, r, frame_ms, mode, features, engine, i;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:k:o:b:T:lf:e:")) != -1) {
+    if (opt == 'd') {
+      min_ns = atof(optarg) * 1e6;
+    } else if (opt == 'k') {
+      filter = optarg;
+    } else if (opt == 'o') {
+      json_path = optarg;
+    } else if (opt == 'b') {
+      baseline_path = optarg;
+    } else if (opt == 'T') {
+      tolerance = atof(optarg);
+    } else if (opt == 'l') {
+      measure_latency = 1;
+    } else if (opt == 'f' && strcmp(optarg, "filterbank") == 0) {
+      first_features = last_features = kVadFeaturesFilterBank;
+    } else if (opt == 'f' && strcmp(optarg, "spectral") == 0) {
+      first_features = last_features = kVadFeaturesSpectral;
+    } else if (opt == 'f' && strcmp(optarg, "both") == 0) {
+      first_features = kVadFeaturesFilterBank;
+      last_features = kVadFeaturesSpectral;
+    } else if (opt == 'e' && strcmp(optarg, "fixed") == 0) {
+      first_engine = last_engine = kVadEngineFixed;
+    } else if (opt == 'e' && strcmp(optarg, "float") == 0) {
+      first_engine = last_engine = kVadEngineFloat;
+    } else if (opt == 'e' && strcmp(optarg, "both") == 0) {
+      first_engine = kVadEngineFixed;
+      last_engine = kVadEngineFloat;
+    } else {
+      Usage();
+      return 1;
+    }
+  }
+  files = optind < argc ? (const char**) argv + optind : kDefaultFiles;
+  num_files = optind < argc ? argc - optind : 2;
+
+  for (i = 0; i < num_files && num_readers < kMaxSignals - 3; i++) {
+    if (WavReader_Open(&readers[num_readers], files[i]) != 0) {
+      fprintf(stderr, "%s: %s, skipped\n", files[i],
+              readers[num_readers].error);
+      continue;
+    }
+    // Interleaved channels are benchmarked as one longer mono signal.
+    snprintf(signals[num_signals].name, kSignalNameLength, "%s", files[i]);
+    signals[num_signals].samples = readers[num_readers].samples;
+    signals[num_signals].num_samples =
+        readers[num_readers].num_samples * readers[num_readers].channels;
+    num_signals++;
+    num_readers++;
+  }
+  for (i = 0; i < 3; i++) {
+    const size_t length = (size_t) kSyntheticSeconds * 48000;
+    synthetic[i] = (int16_t*) malloc(length * sizeof(int16_t));
+    if (synthetic[i] == NULL) {
+      fprintf(stderr, "out of memory\n");
+      return 1;
+    }
+    Synthesize(kSynthetic[i], synthetic[i], length);
+    snprintf(signals[num_signals].name, kSignalNameLength, "%s",
+             kSynthetic[i]);
+    signals[num_signals].samples = synthetic[i];
+    signals[num_signals].num_samples = length;
+    num_signals++;
+  }
+
+  OpenPerfCounters(&counters);
+  printf("%-36s %10s %12s %12s %10s", "config", "ns/frame", "cycles/frame",
+         "instr/frame", "rtf");
+  if (measure_latency) {
+    printf(" %8s %8s %8s %8s", "p50", "p99", "p99.9", "max");
+  }
+  printf("\n");
+  for (s = 0; s < num_signals; s++) {
+    for (r = 0; r < 4; r++) {
+      for (frame_ms = 10; frame_ms <= 30; frame_ms += 10) {
+        for (mode = 0; mode < 4; mode++) {
+          for (features = first_features; features <= last_features;
+               features++) {
+            for (engine = first_engine;
+                 engine <= last_engine && num_results < kMaxResults;
+                 engine++) {
+              Result* result = &results[num_results];
+              static VadLatencyHistogram latency;
+              char name[kNameLength];
+
+              ConfigName(name, sizeof(name), signals[s].name, kRates[r],
+                         frame_ms, mode, features, engine);
+              if (filter != NULL && strstr(name, filter) == NULL) {
+                continue;
+              }
+              memset(&latency, 0, sizeof(latency));
+              if (RunConfig(&signals[s], kRates[r], frame_ms, mode, features,
+                            engine, min_ns, &counters,
+                            measure_latency ? &latency : NULL, result) != 0) {
+                fprintf(stderr, "%s: failed\n", name);
+                continue;
+              }
+              PrintResult(result, measure_latency ? &latency : NULL);
+              num_results++;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  if (json_path != NULL) {
+    FILE* file = fopen(json_path, "w");
+    if (file == NULL) {
+      fprintf(stderr, "cannot write %s\n", json_path);
+      return 1;
+    }
+    WriteJson(file, results, num_results,
+              counters.cycles_fd >= 0 ? "perf" : "tsc");
+    fclose(file);
+  }
+
+  if (baseline_path != NULL) {
+    FILE* file = fopen(baseline_path, "r");
+    if (file == NULL) {
+      fprintf(stderr, "cannot read %s\n", baseline_path);
+      return 1;
+    }
+    for (i = 0; i < num_results; i++) {
+      const double base = BaselineNsPerFrame(file, results[i].name);
+      double change;
+      if (base <= 0) {
+        continue;
+      }
+      change = 100 * (results[i].ns_per_frame - base) / base;
+      if (change > tolerance) {
+        printf("REGRESSION %-36s %10.1f -> %10.1f ns/frame (%+.1f%%)\n",
+               results[i].name, base, results[i].ns_per_frame, change);
+        regressions++;
+      }
+    }
+    fclose(file);
+    printf("%d of %d configurations regressed by more than %.1f%%\n",
+           regressions, num_results, tolerance);
+  }
+
+  ClosePerfCounters(&counters);
+  for (i = 0; i < num_readers; i++) {
+    WavReader_Close(&readers[i]);
+  }
+  for (i = 0; i < 3; i++) {
+    free(synthetic[i]);
+  }
+  return regressions > 0 ? 2 : 0;
+}
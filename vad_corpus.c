@@ -0,0 +1,356 @@
+// VAD over a corpus of many short WAV files, see corpus_reader.h.
+//
+// Usage: vad_corpus [-t workers] [-q depth] [-M memory_mb] [-T]
+//                   [-r reader_threads] [-B] [-m mode] [-f frame_ms] [-v]
+//                   (-l list | file.wav ...)
+//
+// Files come from the arguments or from a list with one path per line (-l -
+// reads it from stdin). They are loaded by a CorpusReader, with io_uring
+// unless -T forces the reading threads, and the workers run the batch VAD
+// on the first channel of each one as soon as it is in memory. -B instead
+// has every worker open and map its files itself, for comparison.
+//
+// Prints the throughput in files/s and in hours of audio per second, and
+// with -v the fraction of speech of every file.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "corpus_reader.h"
+#include "vad.h"
+#include "wav_reader.h"
+
+typedef struct {
+  // Settings, shared.
+  CorpusReader* reader;
+  const char* const* paths;
+  size_t num_paths;
+  size_t* next_path;  // For -B.
+  int mode;
+  int frame_ms;
+  int verbose;
+  pthread_mutex_t* print_mutex;
+
+  // Results.
+  size_t files;
+  size_t errors;
+  size_t bytes;
+  double audio_seconds;
+  size_t frames;
+  size_t speech_frames;
+} Worker;
+
+static double NowMs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void ReportError(Worker* worker, const char* path, const char* error) {
+  worker->errors++;
+  pthread_mutex_lock(worker->print_mutex);
+  fprintf(stderr, "%s: %s\n", path, error);
+  pthread_mutex_unlock(worker->print_mutex);
+}
+
+// Runs the VAD on the first channel of |wav|, a file of |bytes|, with
+// |handle| reset first. |decisions| grows as needed.
+static void ProcessFile(Worker* worker, VadInst* handle, const char* path,
+                        const WavReader* wav, size_t bytes,
+                        uint8_t** decisions, size_t* capacity) {
+  const int rate = WavReader_VadRate(wav);
+  int frame_length;
+  size_t num_frames;
+  size_t speech = 0;
+  size_t i;
+
+  if (rate < 0) {
+    ReportError(worker, path, "sample rate not supported by the VAD");
+    return;
+  }
+  frame_length = rate / 1000 * worker->frame_ms;
+  num_frames = wav->num_samples / frame_length;
+  if (num_frames > *capacity) {
+    uint8_t* grown = (uint8_t*) realloc(*decisions, num_frames);
+
+    if (grown == NULL) {
+      worker->errors++;
+      return;
+    }
+    *decisions = grown;
+    *capacity = num_frames;
+  }
+  if (WebRtcVad_Init(handle) != 0 ||
+      WebRtcVad_set_mode(handle, worker->mode) != 0 ||
+      (num_frames > 0 &&
+       WebRtcVad_ProcessInterleaved(&handle, 1, wav->channels, rate,
+                                    wav->samples, frame_length, num_frames,
+                                    *decisions) != 0)) {
+    worker->errors++;
+    return;
+  }
+  for (i = 0; i < num_frames; i++) {
+    speech += (*decisions)[i];
+  }
+  worker->files++;
+  worker->bytes += bytes;
+  worker->audio_seconds += (double) wav->num_samples / wav->sample_rate;
+  worker->frames += num_frames;
+  worker->speech_frames += speech;
+  if (worker->verbose) {
+    pthread_mutex_lock(worker->print_mutex);
+    printf("%s %.3f\n", path,
+           num_frames > 0 ? (double) speech / num_frames : 0.0);
+    pthread_mutex_unlock(worker->print_mutex);
+  }
+}
+
+static void* RunWorker(void* argument) {
+  Worker* worker = (Worker*) argument;
+  VadInst* handle = NULL;
+  uint8_t* decisions = NULL;
+  size_t capacity = 0;
+  WavReader wav;
+
+  if (WebRtcVad_Create(&handle) != 0) {
+    return NULL;
+  }
+  for (;;) {
+    if (worker->reader != NULL) {
+      CorpusFile* file = CorpusReader_Next(worker->reader);
+
+      if (file == NULL) {
+        break;
+      }
+      if (file->error != 0) {
+        ReportError(worker, file->path, strerror(file->error));
+      } else if (WavReader_OpenMemory(&wav, file->data, file->size) != 0) {
+        ReportError(worker, file->path, wav.error);
+      } else {
+        ProcessFile(worker, handle, file->path, &wav, file->size, &decisions,
+                    &capacity);
+        WavReader_Close(&wav);
+      }
+      CorpusReader_Release(worker->reader, file);
+    } else {
+      const size_t index = __atomic_fetch_add(worker->next_path, 1,
+                                              __ATOMIC_RELAXED);
+      const char* path;
+
+      if (index >= worker->num_paths) {
+        break;
+      }
+      path = worker->paths[index];
+      if (WavReader_Open(&wav, path) != 0) {
+        ReportError(worker, path, wav.error);
+      } else {
+        ProcessFile(worker, handle, path, &wav, wav.map_size, &decisions,
+                    &capacity);
+        WavReader_Close(&wav);
+      }
+    }
+  }
+  WebRtcVad_Free(handle);
+  free(decisions);
+  return NULL;
+}
+
+// Reads one path per line of |list| ("-" for stdin) into |*paths|.
+//
+// returns : Number of paths, or -1 - (cannot be read, out of memory)
+static long ReadList(const char* list, char*** paths) {
+  FILE* file = strcmp(list, "-") == 0 ? stdin : fopen(list, "r");
+  char* line = NULL;
+  size_t line_capacity = 0;
+  size_t capacity = 0;
+  long count = 0;
+  ssize_t length;
+
+  *paths = NULL;
+  if (file == NULL) {
+    return -1;
+  }
+  while ((length = getline(&line, &line_capacity, file)) >= 0) {
+    while (length > 0 && (line[length - 1] == '\n' ||
+                          line[length - 1] == '\r')) {
+      line[--length] = '\0';
+    }
+    if (length == 0) {
+      continue;
+    }
+    if ((size_t) count == capacity) {
+      char** grown;
+
+      capacity = capacity > 0 ? 2 * capacity : 1024;
+      grown = (char**) realloc(*paths, capacity * sizeof(char*));
+      if (grown == NULL) {
+        count = -1;
+        break;
+      }
+      *paths = grown;
+    }
+    if (((*paths)[count] = strdup(line)) == NULL) {
+      count = -1;
+      break;
+    }
+    count++;
+  }
+  free(line);
+  if (file != stdin) {
+    fclose(file);
+  }
+  return count;
+}
+
+static void Usage(void) {
+  fprintf(stderr, "usage: vad_corpus [-t workers] [-q depth] [-M memory_mb] "
+          "[-T] [-r reader_threads] [-B] [-m mode] [-f frame_ms] [-v] "
+          "(-l list | file.wav ...)\n");
+}
+
+int main(int argc, char* argv[]) {
+  int num_workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  int mode = 2;
+  int frame_ms = 20;
+  int verbose = 0;
+  int baseline = 0;
+  const char* list = NULL;
+  char** list_paths = NULL;
+  const char* const* paths;
+  size_t num_paths;
+  size_t next_path = 0;
+  CorpusReaderConfig config;
+  CorpusReader* reader = NULL;
+  pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
+  pthread_t* threads;
+  Worker* workers;
+  Worker total;
+  double start, elapsed_s;
+  size_t i;
+  int opt;
+  int w;
+
+  CorpusReader_DefaultConfig(&config);
+  while ((opt = getopt(argc, argv, "t:q:M:Tr:Bm:f:vl:")) != -1) {
+    if (opt == 't') {
+      num_workers = atoi(optarg);
+    } else if (opt == 'q') {
+      config.queue_depth = atoi(optarg);
+    } else if (opt == 'M') {
+      config.memory_limit = (size_t) atol(optarg) << 20;
+    } else if (opt == 'T') {
+      config.use_io_uring = 0;
+    } else if (opt == 'r') {
+      config.num_threads = atoi(optarg);
+    } else if (opt == 'B') {
+      baseline = 1;
+    } else if (opt == 'm') {
+      mode = atoi(optarg);
+    } else if (opt == 'f') {
+      frame_ms = atoi(optarg);
+    } else if (opt == 'v') {
+      verbose = 1;
+    } else if (opt == 'l') {
+      list = optarg;
+    } else {
+      Usage();
+      return 1;
+    }
+  }
+  if (num_workers < 1 || mode < 0 || mode > 3 ||
+      (frame_ms != 10 && frame_ms != 20 && frame_ms != 30) ||
+      (list == NULL) == (optind == argc)) {
+    Usage();
+    return 1;
+  }
+  if (list != NULL) {
+    const long count = ReadList(list, &list_paths);
+
+    if (count < 0) {
+      fprintf(stderr, "cannot read %s\n", list);
+      return 1;
+    }
+    paths = (const char* const*) list_paths;
+    num_paths = (size_t) count;
+  } else {
+    paths = (const char* const*) &argv[optind];
+    num_paths = (size_t) (argc - optind);
+  }
+
+  threads = (pthread_t*) calloc(num_workers, sizeof(pthread_t));
+  workers = (Worker*) calloc(num_workers, sizeof(Worker));
+  if (threads == NULL || workers == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  start = NowMs();
+  if (!baseline) {
+    reader = CorpusReader_Create(paths, num_paths, &config);
+    if (reader == NULL) {
+      fprintf(stderr, "cannot start the corpus reader\n");
+      return 1;
+    }
+  }
+  for (w = 0; w < num_workers; w++) {
+    workers[w].reader = reader;
+    workers[w].paths = paths;
+    workers[w].num_paths = num_paths;
+    workers[w].next_path = &next_path;
+    workers[w].mode = mode;
+    workers[w].frame_ms = frame_ms;
+    workers[w].verbose = verbose;
+    workers[w].print_mutex = &print_mutex;
+    if (pthread_create(&threads[w], NULL, RunWorker, &workers[w]) != 0) {
+      fprintf(stderr, "cannot start worker %d\n", w);
+      return 1;
+    }
+  }
+  memset(&total, 0, sizeof(total));
+  for (w = 0; w < num_workers; w++) {
+    pthread_join(threads[w], NULL);
+    total.files += workers[w].files;
+    total.errors += workers[w].errors;
+    total.bytes += workers[w].bytes;
+    total.audio_seconds += workers[w].audio_seconds;
+    total.frames += workers[w].frames;
+    total.speech_frames += workers[w].speech_frames;
+  }
+  // Every file is counted once, processed or as an error, unless the reader
+  // failed before handing it out.
+  if (total.files + total.errors < num_paths) {
+    fprintf(stderr, "%zu files not read\n",
+            num_paths - total.files - total.errors);
+    total.errors = num_paths - total.files;
+  }
+  elapsed_s = (NowMs() - start) / 1e3;
+
+  fprintf(stderr, "%zu files (%zu errors), %.1f MB, %.2f h of audio in "
+          "%.2f s with %d workers, %s\n",
+          total.files, total.errors, total.bytes / 1e6,
+          total.audio_seconds / 3600, elapsed_s, num_workers,
+          baseline ? "mapped by the workers" :
+          CorpusReader_UsesIoUring(reader) ? "read with io_uring" :
+          "read with threads");
+  fprintf(stderr, "%.0f files/s, %.3f audio-hours/s, %.1f MB/s, "
+          "%.1f%% speech\n",
+          total.files / elapsed_s,
+          total.audio_seconds / 3600 / elapsed_s,
+          total.bytes / 1e6 / elapsed_s,
+          total.frames > 0 ? 100.0 * total.speech_frames / total.frames : 0.0);
+
+  CorpusReader_Free(reader);
+  for (i = 0; list_paths != NULL && i < num_paths; i++) {
+    free(list_paths[i]);
+  }
+  free(list_paths);
+  free(threads);
+  free(workers);
+  return total.errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,83 @@
+// The reference VAD of vad_difftest, see vad_difftest_reference.h.
+//
+// Built with -fvisibility=hidden and then objcopy --localize-hidden, so that
+// only the functions marked below stay global.
+
+#define WEBRTC_SPL_POINTER_DISPATCH
+#include "src/vad.c"
+
+#include "vad_difftest_reference.h"
+
+#define REFERENCE_API __attribute__((visibility("default")))
+
+REFERENCE_API
+int Reference_Create(VadInst** handle, int mode, int engine,
+                     int feature_mode) {
+  if (WebRtcVad_Create(handle) != 0) {
+    return -1;
+  }
+  // After the WebRtcSpl_Init() of WebRtcVad_Create(), which picked the
+  // kernels for this CPU once.
+  InitPointersToC();
+  if (WebRtcVad_Init(*handle) != 0 ||
+      WebRtcVad_set_mode(*handle, mode) != 0 ||
+      WebRtcVad_set_silence_skip(*handle, 0, 0) != 0 ||
+      WebRtcVad_set_engine(*handle, engine) != 0 ||
+      WebRtcVad_set_feature_mode(*handle, feature_mode) != 0) {
+    WebRtcVad_Free(*handle);
+    *handle = NULL;
+    return -1;
+  }
+  return 0;
+}
+
+REFERENCE_API
+int Reference_Process(VadInst* handle, int fs, int16_t* audio_frame,
+                      int frame_length) {
+  return WebRtcVad_Process(handle, fs, audio_frame, frame_length);
+}
+
+REFERENCE_API
+int Reference_Free(VadInst* handle) {
+  return WebRtcVad_Free(handle);
+}
+
+// FNV-1a over the 8 bytes of |value|.
+static uint64_t HashValue(uint64_t hash, int64_t value) {
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    hash = (hash ^ (uint8_t) (value >> (8 * i))) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+#define HASH_SCALAR(field) hash = HashValue(hash, self->field)
+#define HASH_ARRAY(field) \
+  for (i = 0; i < sizeof(self->field) / sizeof(*self->field); i++) { \
+    hash = HashValue(hash, self->field[i]); \
+  }
+
+REFERENCE_API
+uint64_t Reference_HashFrame(uint64_t hash, VadInst* handle, int decision) {
+  const VadInstT* self = (const VadInstT*) handle;
+  size_t i;
+
+  hash = HashValue(hash, decision);
+  HASH_ARRAY(noise_means);
+  HASH_ARRAY(speech_means);
+  HASH_ARRAY(noise_stds);
+  HASH_ARRAY(speech_stds);
+  HASH_ARRAY(mean_value);
+  HASH_ARRAY(upper_state);
+  HASH_ARRAY(lower_state);
+  HASH_ARRAY(hp_filter_state);
+  HASH_ARRAY(downsampling_filter_states);
+  HASH_ARRAY(low_value_vector);
+  HASH_ARRAY(index_vector);
+  HASH_SCALAR(frame_counter);
+  HASH_SCALAR(over_hang);
+  HASH_SCALAR(num_of_speech);
+  HASH_SCALAR(vad);
+  return hash;
+}
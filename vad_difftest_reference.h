@@ -0,0 +1,33 @@
+#ifndef VAD_DIFFTEST_REFERENCE_H_
+#define VAD_DIFFTEST_REFERENCE_H_
+
+#include <stdint.h>
+
+#include "src/vad.h"
+
+// The reference VAD of vad_difftest: a second copy of the library with every
+// kernel dispatched to its plain C version. Its object keeps all symbols
+// local but these, so it links next to the production build the test
+// includes.
+
+// Creates an instance and initializes it with |mode|, |engine| and
+// |feature_mode|, without the silence shortcut.
+//
+// returns : 0 - (OK), -1 - (out of memory, invalid settings)
+int Reference_Create(VadInst** handle, int mode, int engine, int feature_mode);
+
+// As WebRtcVad_Process().
+int Reference_Process(VadInst* handle, int fs, int16_t* audio_frame,
+                      int frame_length);
+
+// As WebRtcVad_Free().
+int Reference_Free(VadInst* handle);
+
+// Extends |hash| with |decision| and the state every version of the library
+// keeps: the GMM, the filter states, the minimum tracking and the hangover.
+// Only values are hashed, not the layout, so the golden results of
+// vad_difftest can be produced by this file built against an older
+// src/vad.c.
+uint64_t Reference_HashFrame(uint64_t hash, VadInst* handle, int decision);
+
+#endif  // VAD_DIFFTEST_REFERENCE_H_
@@ -0,0 +1,431 @@
+// Microbenchmarks of the filter bank, GMM and SPL kernels of the VAD.
+//
+// Usage: vad_kernel_bench [-d ms] [-n cold_samples] [-e evict_mb] [-k filter]
+//                         [file.wav]
+//
+// Each kernel runs at the lengths it sees inside WebRtcVad_Process(), fed
+// with successive blocks of the file (default deb.wav, noise if missing):
+//   warm  back-to-back calls for at least -d ms (default 50), the mean cost
+//   cold  single calls after sweeping an -e MiB buffer (default 32) through
+//         the cache, the median of -n calls (default 200), with the cost of
+//         timing an empty call subtracted
+// Cycles are time stamp counter ticks on x86 and nanoseconds elsewhere.
+//
+// Most kernels are static, so this file is built together with the library
+// source as one translation unit and must not be linked against libvad.a.
+
+#include "src/vad.c"
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wav_reader.h"
+
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+#include <x86intrin.h>
+#endif
+
+enum { kMaxKernelLength = 1440 };
+enum { kMaxLengths = 6 };
+enum { kNoiseSamples = 16000 * 10 };
+
+typedef struct {
+  int16_t out[kMaxKernelLength];
+  int16_t out2[kMaxKernelLength];
+  int16_t state16[8];
+  int32_t state32[8];
+  int32_t tmpmem[496];
+  WebRtcSpl_State48khzTo8khz resampler;
+  VadInstT* vad;
+  int16_t total_energy;
+  int32_t sink;
+  int length;
+} BenchContext;
+
+typedef void (*KernelFunction)(BenchContext* ctx, const int16_t* in);
+
+typedef struct {
+  const char* name;
+  KernelFunction run;
+  int lengths[kMaxLengths];  // Zero terminated.
+} Kernel;
+
+static void RunSplitFilter(BenchContext* ctx, const int16_t* in) {
+  SplitFilter(in, 1, ctx->length, &ctx->state16[0], &ctx->state16[1],
+              ctx->out, ctx->out2);
+}
+
+// One branch of SplitFilter() on its own, the upper all pass section over
+// every other sample, to tell the serial path from the interleaving.
+static void RunAllPassSection(BenchContext* ctx, const int16_t* in) {
+  const int32_t coefficient = kAllPassCoefsQ15[0];
+  uint32_t previous = (uint32_t) ctx->state16[0] << 16;
+  int32_t output = 0;
+  int i;
+
+  for (i = 0; i < ctx->length; i++) {
+    output = AllPassStep(coefficient, in[2 * i], &previous, output);
+    ctx->out[i] = (int16_t) output;
+  }
+  ctx->state16[0] = AllPassState(coefficient, previous, output);
+}
+
+static void RunHighPassFilter(BenchContext* ctx, const int16_t* in) {
+  HighPassFilter(in, ctx->length, ctx->state16, ctx->out);
+}
+
+static void RunLogOfEnergy(BenchContext* ctx, const int16_t* in) {
+  ctx->total_energy = 0;
+  LogOfEnergy(in, ctx->length, kOffsetVector[0], &ctx->total_energy,
+              ctx->out);
+}
+
+static void RunEnergy(BenchContext* ctx, const int16_t* in) {
+  int scale;
+
+  ctx->sink += WebRtcSpl_Energy((int16_t*) in, ctx->length, &scale);
+}
+
+// |length| calls, one GMM evaluation per frame makes 24.
+static void RunGaussianProbability(BenchContext* ctx, const int16_t* in) {
+  int i;
+
+  for (i = 0; i < ctx->length; i++) {
+    ctx->sink += WebRtcVad_GaussianProbability(
+        (int16_t) ((in[i] >> 4) + 1024), kNoiseDataMeans[i % kTableSize],
+        kNoiseDataStds[i % kTableSize], &ctx->out[i]);
+  }
+}
+
+// Feature vectors come from the signal, |length| is the frame length.
+static void RunGmmProbability(BenchContext* ctx, const int16_t* in) {
+  int16_t features[kNumChannels];
+  int i;
+
+  for (i = 0; i < kNumChannels; i++) {
+    features[i] = (int16_t) (((in[i] >> 6) & 0x3FF) + 200);
+  }
+  ctx->sink += GmmProbability(ctx->vad, features, kMinEnergy + 1,
+                              ctx->length);
+}
+
+// As RunGmmProbability(), on the same features in dB.
+static void RunGmmProbabilityFloat(BenchContext* ctx, const int16_t* in) {
+  float features[kNumChannels];
+  int i;
+
+  for (i = 0; i < kNumChannels; i++) {
+    features[i] = (((in[i] >> 6) & 0x3FF) + 200) / 16.f;
+  }
+  ctx->sink += WebRtcVad_GmmProbabilityFloat(ctx->vad, features,
+                                             kMinEnergy + 1, ctx->length);
+}
+
+// One call per channel.
+static void RunFindMinimum(BenchContext* ctx, const int16_t* in) {
+  int i;
+
+  for (i = 0; i < kNumChannels; i++) {
+    ctx->sink += WebRtcVad_FindMinimum(ctx->vad,
+                                       (int16_t) ((in[i] >> 6) & 0x3FF), i);
+  }
+}
+
+static void RunDownsampling(BenchContext* ctx, const int16_t* in) {
+  WebRtcVad_Downsampling(in, 1, ctx->out, ctx->state32, ctx->length);
+}
+
+// The resampler takes 10 ms blocks, |length| is the frame length at 48 kHz.
+static void RunResample48khzTo8khz(BenchContext* ctx, const int16_t* in) {
+  int i;
+
+  for (i = 0; i < ctx->length; i += 480) {
+    WebRtcSpl_Resample48khzTo8khz(in + i, ctx->out + i / 6, &ctx->resampler,
+                                  ctx->tmpmem);
+  }
+}
+
+static void RunCalculateFeatures(BenchContext* ctx, const int16_t* in) {
+  ctx->sink += WebRtcVad_CalculateFeatures(ctx->vad, in, 1, ctx->length,
+                                           ctx->out);
+}
+
+static void RunCalculateFeaturesFloat(BenchContext* ctx, const int16_t* in) {
+  float features[kNumChannels];
+
+  ctx->sink += (int32_t) WebRtcVad_CalculateFeaturesFloat(ctx->vad, in, 1,
+                                                          ctx->length,
+                                                          features);
+  ctx->sink += (int32_t) features[0];
+}
+
+// |length| 16-bit values, i.e., |length| / 2 complex ones.
+static void RunRealForwardFFT(BenchContext* ctx, const int16_t* in) {
+  struct RealFFT fft = { 0 };
+
+  while ((2 << fft.order) < ctx->length) {
+    fft.order++;
+  }
+  ctx->sink += WebRtcSpl_RealForwardFFT(&fft, in, ctx->out);
+}
+
+static void RunRealForwardFFTC(BenchContext* ctx, const int16_t* in) {
+  struct RealFFT fft = { 0 };
+
+  while ((2 << fft.order) < ctx->length) {
+    fft.order++;
+  }
+  ctx->sink += WebRtcSpl_RealForwardFFTC(&fft, in, ctx->out);
+}
+
+// The bytes of the input block as G.711 codes.
+static void RunMuLawToW16(BenchContext* ctx, const int16_t* in) {
+  WebRtcSpl_MuLawToW16((const uint8_t*) in, ctx->length, ctx->out);
+}
+
+static void RunMuLawToW16C(BenchContext* ctx, const int16_t* in) {
+  WebRtcSpl_MuLawToW16C((const uint8_t*) in, ctx->length, ctx->out);
+}
+
+static void RunALawToW16(BenchContext* ctx, const int16_t* in) {
+  WebRtcSpl_ALawToW16((const uint8_t*) in, ctx->length, ctx->out);
+}
+
+static void RunNothing(BenchContext* ctx, const int16_t* in) {
+  (void) ctx;
+  (void) in;
+}
+
+static const Kernel kKernels[] = {
+  { "SplitFilter", RunSplitFilter, { 30, 60, 120, 240, 0 } },
+  { "AllPassSection", RunAllPassSection, { 15, 30, 60, 120, 0 } },
+  { "HighPassFilter", RunHighPassFilter, { 5, 10, 15, 0 } },
+  { "LogOfEnergy", RunLogOfEnergy, { 5, 10, 20, 40, 60, 0 } },
+  { "WebRtcSpl_Energy", RunEnergy, { 5, 10, 20, 40, 60, 240 } },
+  { "WebRtcVad_GaussianProbability", RunGaussianProbability, { 1, 24, 0 } },
+  { "GmmProbability", RunGmmProbability, { 80, 160, 240, 0 } },
+  { "WebRtcVad_GmmProbabilityFloat", RunGmmProbabilityFloat,
+    { 80, 160, 240, 0 } },
+  { "WebRtcVad_FindMinimum", RunFindMinimum, { 6, 0 } },
+  { "WebRtcVad_Downsampling", RunDownsampling, { 160, 320, 480, 640, 960 } },
+  { "WebRtcSpl_Resample48khzTo8khz", RunResample48khzTo8khz,
+    { 480, 960, 1440, 0 } },
+  { "WebRtcVad_CalculateFeatures", RunCalculateFeatures, { 80, 160, 240, 0 } },
+  { "WebRtcVad_CalculateFeaturesFloat", RunCalculateFeaturesFloat,
+    { 80, 160, 240, 0 } },
+  { "WebRtcSpl_RealForwardFFT", RunRealForwardFFT, { 256, 512, 1024, 0 } },
+  { "WebRtcSpl_RealForwardFFTC", RunRealForwardFFTC, { 256, 512, 1024, 0 } },
+  { "WebRtcSpl_MuLawToW16", RunMuLawToW16, { 80, 160, 480, 1440, 0 } },
+  { "WebRtcSpl_MuLawToW16C", RunMuLawToW16C, { 80, 160, 480, 1440, 0 } },
+  { "WebRtcSpl_ALawToW16", RunALawToW16, { 80, 160, 480, 1440, 0 } },
+};
+
+static uint64_t Ticks(void) {
+#if defined(WEBRTC_ARCH_X86_FAMILY)
+  // Keep earlier instructions from drifting past the read.
+  _mm_lfence();
+  return __rdtsc();
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static double NowNs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int CompareTicks(const void* a, const void* b) {
+  const uint64_t x = *(const uint64_t*) a;
+  const uint64_t y = *(const uint64_t*) b;
+  return x < y ? -1 : x > y;
+}
+
+// Writes to every cache line of |evict|, pushing everything else out.
+static void EvictCaches(volatile uint8_t* evict, size_t size) {
+  size_t i;
+
+  for (i = 0; i < size; i += 64) {
+    evict[i]++;
+  }
+}
+
+// Returns the input block for call |call|. Successive calls walk the signal.
+static const int16_t* NextInput(const int16_t* audio, size_t audio_length,
+                                uint64_t call) {
+  const size_t blocks = audio_length / kMaxKernelLength;
+  return audio + (size_t) (call % blocks) * kMaxKernelLength;
+}
+
+static void ResetContext(BenchContext* ctx, int length) {
+  VadInstT* vad = ctx->vad;
+
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->vad = vad;
+  ctx->length = length;
+  WebRtcVad_InitCore(vad);
+  // The float kernels use the converted initial model.
+  WebRtcVad_ConvertEngineState(vad, kVadEngineFloat);
+  WebRtcSpl_ResetResample48khzTo8khz(&ctx->resampler);
+}
+
+// Median cost of single calls after evicting the caches.
+static uint64_t ColdTicks(KernelFunction run, BenchContext* ctx,
+                          const int16_t* audio, size_t audio_length,
+                          uint8_t* evict, size_t evict_size,
+                          uint64_t* samples, int num_samples) {
+  uint64_t start;
+  int i;
+
+  for (i = 0; i < num_samples; i++) {
+    const int16_t* in = NextInput(audio, audio_length, i);
+    EvictCaches(evict, evict_size);
+    start = Ticks();
+    run(ctx, in);
+    samples[i] = Ticks() - start;
+  }
+  qsort(samples, num_samples, sizeof(*samples), CompareTicks);
+  return samples[num_samples / 2];
+}
+
+static void Usage(void) {
+  fprintf(stderr, "usage: vad_kernel_bench [-d ms] [-n cold_samples] "
+          "[-e evict_mb] [-k filter] [file.wav]\n");
+}
+
+int main(int argc, char* argv[]) {
+  const char* path = "deb.wav";
+  const char* filter = NULL;
+  double min_ns = 50e6;
+  int num_samples = 200;
+  size_t evict_size = (size_t) 32 << 20;
+  static BenchContext ctx;
+  WavReader wav;
+  const int16_t* audio;
+  size_t audio_length;
+  int16_t* noise = NULL;
+  uint8_t* evict;
+  uint64_t* samples;
+  uint64_t overhead;
+  VadInst* handle = NULL;
+  size_t k;
+  int l;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:n:e:k:")) != -1) {
+    if (opt == 'd') {
+      min_ns = atof(optarg) * 1e6;
+    } else if (opt == 'n') {
+      num_samples = atoi(optarg);
+    } else if (opt == 'e') {
+      evict_size = (size_t) atoi(optarg) << 20;
+    } else if (opt == 'k') {
+      filter = optarg;
+    } else {
+      Usage();
+      return 1;
+    }
+  }
+  if (optind < argc) {
+    path = argv[optind];
+  }
+  if (num_samples < 1 || evict_size == 0) {
+    Usage();
+    return 1;
+  }
+
+  if (WavReader_Open(&wav, path) == 0 &&
+      wav.num_samples * wav.channels >= 2 * kMaxKernelLength) {
+    audio = wav.samples;
+    audio_length = wav.num_samples * wav.channels;
+  } else {
+    uint32_t seed = 12345;
+    size_t i;
+
+    fprintf(stderr, "%s: not usable, running on noise\n", path);
+    noise = (int16_t*) malloc(kNoiseSamples * sizeof(int16_t));
+    if (noise == NULL) {
+      return 1;
+    }
+    for (i = 0; i < kNoiseSamples; i++) {
+      seed = seed * 1103515245 + 12345;
+      noise[i] = (int16_t) ((int32_t) (seed >> 16) - 32768) / 8;
+    }
+    audio = noise;
+    audio_length = kNoiseSamples;
+  }
+
+  evict = (uint8_t*) malloc(evict_size);
+  samples = (uint64_t*) malloc(num_samples * sizeof(*samples));
+  // Selecting the float engine allocates its state, see ResetContext().
+  if (evict == NULL || samples == NULL || WebRtcVad_Create(&handle) != 0 ||
+      WebRtcVad_Init(handle) != 0 ||
+      WebRtcVad_set_engine(handle, kVadEngineFloat) != 0) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  memset(evict, 0, evict_size);
+  ctx.vad = (VadInstT*) handle;
+
+  ResetContext(&ctx, 1);
+  overhead = ColdTicks(RunNothing, &ctx, audio, audio_length, evict,
+                       evict_size, samples, num_samples);
+
+  printf("%-32s %6s %10s %12s %12s\n", "kernel", "length", "warm ns",
+         "warm cycles", "cold cycles");
+  for (k = 0; k < sizeof(kKernels) / sizeof(*kKernels); k++) {
+    const Kernel* kernel = &kKernels[k];
+
+    if (filter != NULL && strstr(kernel->name, filter) == NULL) {
+      continue;
+    }
+    for (l = 0; l < kMaxLengths && kernel->lengths[l] > 0; l++) {
+      const int length = kernel->lengths[l];
+      uint64_t calls = 0;
+      uint64_t ticks = 0;
+      uint64_t cold;
+      double elapsed = 0;
+      double start;
+      uint64_t tick_start;
+      int i;
+
+      // Warm: first fill caches and predictors, then time batches of calls.
+      ResetContext(&ctx, length);
+      for (i = 0; i < 1000; i++) {
+        kernel->run(&ctx, NextInput(audio, audio_length, i));
+      }
+      while (elapsed < min_ns) {
+        start = NowNs();
+        tick_start = Ticks();
+        for (i = 0; i < 1000; i++) {
+          kernel->run(&ctx, NextInput(audio, audio_length, calls + i));
+        }
+        ticks += Ticks() - tick_start;
+        elapsed += NowNs() - start;
+        calls += 1000;
+      }
+
+      ResetContext(&ctx, length);
+      cold = ColdTicks(kernel->run, &ctx, audio, audio_length, evict,
+                       evict_size, samples, num_samples);
+      cold = cold > overhead ? cold - overhead : 0;
+
+      printf("%-32s %6d %10.1f %12.1f %12llu\n", kernel->name, length,
+             elapsed / calls, (double) ticks / calls,
+             (unsigned long long) cold);
+    }
+  }
+
+  WebRtcVad_Free(handle);
+  WavReader_Close(&wav);
+  free(noise);
+  free(evict);
+  free(samples);
+  return 0;
+}
@@ -0,0 +1,205 @@
+// Offline VAD of one long recording on all cores, see vad_parallel.h.
+//
+// Usage: vad_offline [-t threads] [-m mode] [-f frame_ms] [-w ms[,ms...]]
+//                    [-j trace.json] file.wav
+//
+// Runs the file once sequentially and then in parallel for every given
+// warm-up length, and reports the speedup and the divergence from the
+// sequential decisions. Pick the shortest warm-up without mismatches on the
+// corpus.
+//
+// With -j the whole run is written as a Chrome trace: file reading, the
+// spans of every worker and, per frame, the VAD stages. This needs a
+// library built with WEBRTC_VAD_TRACE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vad.h"
+#include "vad_parallel.h"
+#include "wav_reader.h"
+
+enum { kMaxWarmups = 16 };
+// Spans kept in the trace, about 120 bytes of JSON each.
+enum { kMaxTraceEvents = 4 << 20 };
+
+static double NowMs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void Usage(void) {
+  fprintf(stderr, "usage: vad_offline [-t threads] [-m mode] [-f frame_ms] "
+          "[-w ms[,ms...]] [-j trace.json] file.wav\n");
+}
+
+int main(int argc, char* argv[]) {
+  int num_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  int mode = 2;
+  int frame_ms = 20;
+  int warmups_ms[kMaxWarmups] = { 0, 500, 1000, 2000, 5000 };
+  int num_warmups = 5;
+  const char* trace_path = NULL;
+  uint64_t read_start;
+  int rate, frame_length;
+  size_t num_frames;
+  int16_t* mono = NULL;
+  const int16_t* audio;
+  uint8_t* sequential = NULL;
+  uint8_t* parallel = NULL;
+  VadInst* prototype = NULL;
+  WavReader wav;
+  double start, sequential_ms;
+  int opt;
+  int w;
+
+  while ((opt = getopt(argc, argv, "t:m:f:w:j:")) != -1) {
+    if (opt == 't') {
+      num_threads = atoi(optarg);
+    } else if (opt == 'm') {
+      mode = atoi(optarg);
+    } else if (opt == 'f') {
+      frame_ms = atoi(optarg);
+    } else if (opt == 'w') {
+      char* token = strtok(optarg, ",");
+      num_warmups = 0;
+      while (token != NULL && num_warmups < kMaxWarmups) {
+        warmups_ms[num_warmups++] = atoi(token);
+        token = strtok(NULL, ",");
+      }
+    } else if (opt == 'j') {
+      trace_path = optarg;
+    } else {
+      Usage();
+      return 1;
+    }
+  }
+  if (optind != argc - 1 || num_threads < 1) {
+    Usage();
+    return 1;
+  }
+
+  if (trace_path != NULL) {
+    if (WebRtcVad_TraceStart(kMaxTraceEvents) != 0) {
+      fprintf(stderr, "cannot trace, the library is built without "
+              "WEBRTC_VAD_TRACE\n");
+      return 1;
+    }
+    WebRtcVad_TraceThreadName("main");
+  }
+
+  read_start = WebRtcVad_TraceNow();
+  if (WavReader_Open(&wav, argv[optind]) != 0) {
+    fprintf(stderr, "%s: %s\n", argv[optind], wav.error);
+    return 1;
+  }
+  rate = WavReader_VadRate(&wav);
+  if (rate < 0) {
+    fprintf(stderr, "%s: %d Hz is not supported by the VAD\n", argv[optind],
+            wav.sample_rate);
+    WavReader_Close(&wav);
+    return 1;
+  }
+  if (rate != wav.sample_rate) {
+    fprintf(stderr, "warning: processing %d Hz as %d Hz\n", wav.sample_rate,
+            rate);
+  }
+  frame_length = rate / 1000 * frame_ms;
+  if (WebRtcVad_ValidRateAndFrameLength(rate, frame_length) != 0) {
+    fprintf(stderr, "invalid frame length: %d ms\n", frame_ms);
+    WavReader_Close(&wav);
+    return 1;
+  }
+  num_frames = wav.num_samples / frame_length;
+
+  // Only the first channel is used.
+  audio = wav.samples;
+  if (wav.channels > 1) {
+    mono = WavReader_CopyChannel(&wav, 0);
+    if (mono == NULL) {
+      fprintf(stderr, "out of memory\n");
+      WavReader_Close(&wav);
+      return 1;
+    }
+    audio = mono;
+  }
+  // The file is mapped, so this is mostly page faults.
+  WebRtcVad_TraceSpan("read", "io", read_start, WebRtcVad_TraceNow());
+
+  sequential = (uint8_t*) malloc(num_frames + 1);
+  parallel = (uint8_t*) malloc(num_frames + 1);
+  if (sequential == NULL || parallel == NULL ||
+      WebRtcVad_Create(&prototype) != 0 || WebRtcVad_Init(prototype) != 0 ||
+      WebRtcVad_set_mode(prototype, mode) != 0) {
+    fprintf(stderr, "cannot set up the VAD\n");
+    return 1;
+  }
+
+  printf("%s: %zu frames of %d ms at %d Hz (%.1f s), %d threads, mode %d\n",
+         argv[optind], num_frames, frame_ms, rate,
+         (double) num_frames * frame_ms / 1000, num_threads, mode);
+
+  // Reference: one instance over the whole file, on a copy of the prototype.
+  {
+    VadInst* handle = NULL;
+
+    WebRtcVad_Create(&handle);
+    WebRtcVad_Clone(handle, prototype);
+    start = NowMs();
+    if (WebRtcVad_ProcessBatch(handle, rate, audio, frame_length, num_frames,
+                               sequential) != 0) {
+      fprintf(stderr, "WebRtcVad_ProcessBatch failed\n");
+      return 1;
+    }
+    sequential_ms = NowMs() - start;
+    WebRtcVad_Free(handle);
+  }
+  printf("sequential: %.2f ms\n", sequential_ms);
+
+  for (w = 0; w < num_warmups; w++) {
+    const size_t warmup_frames = (size_t) (warmups_ms[w] / frame_ms);
+    VadParallelDivergence divergence;
+    double parallel_ms;
+
+    start = NowMs();
+    if (VadParallel_Process(prototype, rate, audio, frame_length, num_frames,
+                            num_threads, warmup_frames, parallel) != 0) {
+      fprintf(stderr, "VadParallel_Process failed\n");
+      return 1;
+    }
+    parallel_ms = NowMs() - start;
+    VadParallel_CompareDecisions(sequential, parallel, num_frames,
+                                 num_threads, &divergence);
+
+    printf("warm-up %5d ms: %8.2f ms (%.2fx), %zu mismatches in %d chunks",
+           warmups_ms[w], parallel_ms, sequential_ms / parallel_ms,
+           divergence.mismatches, divergence.divergent_chunks);
+    if (divergence.mismatches > 0) {
+      printf(", first at frame %zu, last %zu frames into its chunk",
+             divergence.first_mismatch, divergence.max_settle_frames);
+    }
+    printf("\n");
+  }
+
+  if (trace_path != NULL) {
+    const int64_t dropped = WebRtcVad_TraceStop(trace_path);
+
+    if (dropped < 0) {
+      fprintf(stderr, "cannot write %s\n", trace_path);
+    } else if (dropped > 0) {
+      fprintf(stderr, "trace: %lld spans dropped\n", (long long) dropped);
+    }
+  }
+
+  WebRtcVad_Free(prototype);
+  free(sequential);
+  free(parallel);
+  free(mono);
+  WavReader_Close(&wav);
+  return 0;
+}
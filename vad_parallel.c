@@ -0,0 +1,186 @@
+#include "vad_parallel.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  int index;
+  const VadInst* prototype;
+  int fs;
+  const int16_t* audio;
+  int frame_length;
+  // Frames [warmup_start, start) prime the instance, [start, end) are kept.
+  size_t warmup_start;
+  size_t start;
+  size_t end;
+  uint8_t* decisions;
+  int result;
+} ChunkJob;
+
+// Returns the first frame of chunk |chunk| out of |num_chunks|.
+static size_t ChunkStart(size_t num_frames, int num_chunks, int chunk) {
+  return num_frames * (size_t) chunk / (size_t) num_chunks;
+}
+
+static void* ProcessChunk(void* arg) {
+  ChunkJob* job = (ChunkJob*) arg;
+  const int16_t* audio = job->audio + job->warmup_start * job->frame_length;
+  VadInst* handle = NULL;
+  char name[32];
+  uint64_t start;
+  size_t i;
+
+  // Each worker is a row in the trace, if one is running. Job 0 runs on the
+  // calling thread, which keeps its own name.
+  if (job->index > 0) {
+    snprintf(name, sizeof(name), "worker %d", job->index);
+    WebRtcVad_TraceThreadName(name);
+  }
+  start = WebRtcVad_TraceNow();
+
+  job->result = -1;
+  if (WebRtcVad_Create(&handle) != 0) {
+    return NULL;
+  }
+  if (WebRtcVad_Clone(handle, job->prototype) != 0) {
+    WebRtcVad_Free(handle);
+    return NULL;
+  }
+
+  for (i = job->warmup_start; i < job->start; i++) {
+    // The decisions of the warm-up frames belong to the previous chunk.
+    if (WebRtcVad_Process(handle, job->fs, (int16_t*) audio,
+                          job->frame_length) < 0) {
+      WebRtcVad_Free(handle);
+      return NULL;
+    }
+    audio += job->frame_length;
+  }
+  WebRtcVad_TraceSpan("warm-up", "parallel", start, WebRtcVad_TraceNow());
+  start = WebRtcVad_TraceNow();
+  job->result = WebRtcVad_ProcessBatch(handle, job->fs, audio,
+                                       job->frame_length,
+                                       job->end - job->start,
+                                       job->decisions + job->start);
+  WebRtcVad_TraceSpan("chunk", "parallel", start, WebRtcVad_TraceNow());
+
+  WebRtcVad_Free(handle);
+  return NULL;
+}
+
+int VadParallel_Process(const VadInst* prototype, int fs, const int16_t* audio,
+                        int frame_length, size_t num_frames, int num_threads,
+                        size_t warmup_frames, uint8_t* decisions) {
+  ChunkJob* jobs;
+  pthread_t* threads;
+  uint64_t start;
+  int started = 0;
+  int result = 0;
+  int i;
+
+  if (prototype == NULL || num_threads < 1) {
+    return -1;
+  }
+  if ((audio == NULL || decisions == NULL) && num_frames > 0) {
+    return -1;
+  }
+  if (WebRtcVad_ValidRateAndFrameLength(fs, frame_length) != 0) {
+    return -1;
+  }
+  if ((size_t) num_threads > num_frames) {
+    num_threads = num_frames > 0 ? (int) num_frames : 1;
+  }
+
+  jobs = (ChunkJob*) calloc(num_threads, sizeof(*jobs));
+  threads = (pthread_t*) calloc(num_threads, sizeof(*threads));
+  if (jobs == NULL || threads == NULL) {
+    free(jobs);
+    free(threads);
+    return -1;
+  }
+
+  for (i = 0; i < num_threads; i++) {
+    jobs[i].index = i;
+    jobs[i].prototype = prototype;
+    jobs[i].fs = fs;
+    jobs[i].audio = audio;
+    jobs[i].frame_length = frame_length;
+    jobs[i].start = ChunkStart(num_frames, num_threads, i);
+    jobs[i].end = ChunkStart(num_frames, num_threads, i + 1);
+    // The first chunk needs no warm-up, the prototype state is the true
+    // state at frame 0.
+    jobs[i].warmup_start = 0;
+    if (i > 0 && jobs[i].start > warmup_frames) {
+      jobs[i].warmup_start = jobs[i].start - warmup_frames;
+    }
+    jobs[i].decisions = decisions;
+    jobs[i].result = -1;
+  }
+
+  // The first chunk runs on the calling thread.
+  for (i = 1; i < num_threads; i++) {
+    if (pthread_create(&threads[i], NULL, ProcessChunk, &jobs[i]) != 0) {
+      result = -1;
+      break;
+    }
+    started = i;
+  }
+  if (result == 0) {
+    ProcessChunk(&jobs[0]);
+  }
+  // Time spent waiting here is load imbalance between the chunks.
+  start = WebRtcVad_TraceNow();
+  for (i = 1; i <= started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  WebRtcVad_TraceSpan("join", "parallel", start, WebRtcVad_TraceNow());
+  for (i = 0; i < num_threads && result == 0; i++) {
+    if (jobs[i].result != 0) {
+      result = -1;
+    }
+  }
+
+  free(jobs);
+  free(threads);
+  return result;
+}
+
+void VadParallel_CompareDecisions(const uint8_t* sequential,
+                                  const uint8_t* parallel, size_t num_frames,
+                                  int num_threads,
+                                  VadParallelDivergence* divergence) {
+  int chunk;
+  size_t i;
+
+  memset(divergence, 0, sizeof(*divergence));
+  divergence->first_mismatch = num_frames;
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+  if ((size_t) num_threads > num_frames) {
+    num_threads = num_frames > 0 ? (int) num_frames : 1;
+  }
+
+  for (chunk = 0; chunk < num_threads; chunk++) {
+    const size_t start = ChunkStart(num_frames, num_threads, chunk);
+    const size_t end = ChunkStart(num_frames, num_threads, chunk + 1);
+    int divergent = 0;
+
+    for (i = start; i < end; i++) {
+      if (sequential[i] == parallel[i]) {
+        continue;
+      }
+      divergence->mismatches++;
+      if (i < divergence->first_mismatch) {
+        divergence->first_mismatch = i;
+      }
+      if (i - start > divergence->max_settle_frames) {
+        divergence->max_settle_frames = i - start;
+      }
+      divergent = 1;
+    }
+    divergence->divergent_chunks += divergent;
+  }
+}
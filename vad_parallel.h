@@ -0,0 +1,50 @@
+#ifndef VAD_PARALLEL_H_
+#define VAD_PARALLEL_H_
+
+#include "vad.h"
+
+// Runs the VAD over a long recording on several threads. The frames are
+// split into |num_threads| contiguous chunks. Each chunk gets its own copy of
+// |prototype|, which is first primed with the |warmup_frames| frames
+// preceding the chunk (their decisions are dropped). The first chunk starts
+// from |prototype| directly, so it matches sequential processing exactly.
+// Later chunks match it once the filter, noise model and minimum tracking
+// have converged, see VadParallel_CompareDecisions().
+//
+// - prototype     [i] : Initialized and configured VAD instance, it is not
+//                       modified.
+// - fs            [i] : Sampling frequency (Hz): 8000, 16000, 32000 or 48000
+// - audio         [i] : |num_frames| * |frame_length| samples.
+// - frame_length  [i] : Length of each frame in number of samples.
+// - num_frames    [i] : Number of frames in |audio|.
+// - num_threads   [i] : Number of chunks and threads, >= 1.
+// - warmup_frames [i] : Number of frames each chunk is primed with.
+// - decisions     [o] : Decision per frame, 1 - (Active Voice),
+//                       0 - (Non-active Voice).
+//
+// returns             : 0 - (OK), -1 - (invalid argument, out of memory or
+//                       the threads could not be started)
+int VadParallel_Process(const VadInst* prototype, int fs, const int16_t* audio,
+                        int frame_length, size_t num_frames, int num_threads,
+                        size_t warmup_frames, uint8_t* decisions);
+
+// Differences between a parallel and a sequential decision stream.
+typedef struct {
+  size_t mismatches;
+  // First mismatching frame, or |num_frames| if there is none.
+  size_t first_mismatch;
+  // Largest offset of a mismatch from the start of its chunk, in frames.
+  size_t max_settle_frames;
+  // Number of chunks with at least one mismatch.
+  int divergent_chunks;
+} VadParallelDivergence;
+
+// Compares |parallel| decisions from VadParallel_Process() with |sequential|
+// ones from WebRtcVad_ProcessBatch() for the same |num_frames| and
+// |num_threads|.
+void VadParallel_CompareDecisions(const uint8_t* sequential,
+                                  const uint8_t* parallel, size_t num_frames,
+                                  int num_threads,
+                                  VadParallelDivergence* divergence);
+
+#endif  // VAD_PARALLEL_H_
@@ -0,0 +1,529 @@
+// RTP ingest for a VAD sidecar, see vad_rtp.h.
+
+#include "vad_rtp.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum { kRtpHeaderSize = 12 };
+enum { kPayloadTypeMuLaw = 0 };
+enum { kPayloadTypeALaw = 8 };
+enum { kRate = 8000 };
+enum { kSamplesPerMs = kRate / 1000 };
+// Payloads are whole 10 ms frames, up to 60 ms.
+enum { kMinFrameLength = 80 };
+enum { kMaxPayload = 480 };
+enum { kMaxJitterPackets = 64 };
+// A sequence number further ahead than this, or behind by more than
+// |kMaxMisorder|, starts the stream over, as after a restart of the sender.
+enum { kMaxDropout = 3000 };
+enum { kMaxMisorder = 100 };
+// Frames skipped at most for one gap; the hangover is over long before.
+enum { kMaxSkipFrames = 1000 };
+enum { kIdleScanMs = 1000 };
+
+typedef struct {
+  uint8_t filled;
+  uint8_t payload_type;
+  uint16_t seq;
+  uint16_t length;
+  uint32_t timestamp;
+  uint64_t arrival_ms;
+  uint8_t payload[kMaxPayload];
+} Slot;
+
+typedef struct Stream Stream;
+
+struct Stream {
+  uint32_t ssrc;
+  VadInst* vad;
+  uint16_t next_seq;
+  int speech;
+  // RTP timestamp expected with |next_seq|, and of the first packet.
+  uint32_t next_timestamp;
+  uint32_t first_timestamp;
+  // Of the last packet played out, the size of a lost one.
+  int frame_length;
+  int packet_samples;
+  uint64_t last_packet_ms;
+  // Jitter buffer, allocated with the first packet out of sequence. Slot
+  // |seq| % |jitter_packets| holds packet |seq|.
+  Slot* slots;
+  int buffered;
+  // List of the streams with buffered packets.
+  Stream* next_waiting;
+  Stream* previous_waiting;
+};
+
+struct VadRtp {
+  VadRtpConfig config;
+  VadRtpEventFunction on_event;
+  void* context;
+  VadInst* prototype;
+  // Open addressing with linear probing, at most half full.
+  Stream** table;
+  uint32_t table_mask;
+  Stream* waiting;
+  uint64_t next_idle_scan_ms;
+  VadRtpStats stats;
+};
+
+void VadRtp_DefaultConfig(VadRtpConfig* config) {
+  config->mode = 2;
+  config->jitter_packets = 8;
+  config->jitter_ms = 60;
+  config->idle_timeout_ms = 10000;
+  config->max_streams = 65536;
+}
+
+static uint32_t HomeIndex(const VadRtp* self, uint32_t ssrc) {
+  return (ssrc * 0x9E3779B1u) & self->table_mask;
+}
+
+static Stream* FindStream(const VadRtp* self, uint32_t ssrc) {
+  uint32_t i = HomeIndex(self, ssrc);
+
+  while (self->table[i] != NULL) {
+    if (self->table[i]->ssrc == ssrc) {
+      return self->table[i];
+    }
+    i = (i + 1) & self->table_mask;
+  }
+  return NULL;
+}
+
+static void InsertStream(VadRtp* self, Stream* stream) {
+  uint32_t i = HomeIndex(self, stream->ssrc);
+
+  while (self->table[i] != NULL) {
+    i = (i + 1) & self->table_mask;
+  }
+  self->table[i] = stream;
+}
+
+// Removes the entry at |i|, moving later entries of the probe sequence back
+// so that no tombstones are needed.
+static void RemoveAt(VadRtp* self, uint32_t i) {
+  uint32_t j = i;
+
+  self->table[i] = NULL;
+  for (;;) {
+    uint32_t home;
+
+    j = (j + 1) & self->table_mask;
+    if (self->table[j] == NULL) {
+      return;
+    }
+    home = HomeIndex(self, self->table[j]->ssrc);
+    // Stays if its home lies cyclically in (i, j].
+    if (i <= j ? (i < home && home <= j) : (i < home || home <= j)) {
+      continue;
+    }
+    self->table[i] = self->table[j];
+    self->table[j] = NULL;
+    i = j;
+  }
+}
+
+static void AddWaiting(VadRtp* self, Stream* stream) {
+  stream->previous_waiting = NULL;
+  stream->next_waiting = self->waiting;
+  if (self->waiting != NULL) {
+    self->waiting->previous_waiting = stream;
+  }
+  self->waiting = stream;
+}
+
+static void RemoveWaiting(VadRtp* self, Stream* stream) {
+  if (stream->previous_waiting != NULL) {
+    stream->previous_waiting->next_waiting = stream->next_waiting;
+  } else {
+    self->waiting = stream->next_waiting;
+  }
+  if (stream->next_waiting != NULL) {
+    stream->next_waiting->previous_waiting = stream->previous_waiting;
+  }
+  stream->next_waiting = NULL;
+  stream->previous_waiting = NULL;
+}
+
+static void Emit(VadRtp* self, Stream* stream, int type, uint32_t timestamp) {
+  VadRtpEvent event;
+
+  stream->speech = type == kVadRtpStart;
+  self->stats.events++;
+  if (self->on_event != NULL) {
+    event.ssrc = stream->ssrc;
+    event.type = type;
+    event.media_ms = (timestamp - stream->first_timestamp) / kSamplesPerMs;
+    self->on_event(self->context, &event);
+  }
+}
+
+// Empties the jitter buffer and starts the stream over at |seq|, with a
+// fresh VAD.
+static void Restart(VadRtp* self, Stream* stream, uint16_t seq,
+                    uint32_t timestamp) {
+  if (stream->speech) {
+    Emit(self, stream, kVadRtpStop, stream->next_timestamp);
+  }
+  if (stream->buffered > 0) {
+    memset(stream->slots, 0, self->config.jitter_packets * sizeof(Slot));
+    stream->buffered = 0;
+    RemoveWaiting(self, stream);
+  }
+  WebRtcVad_Clone(stream->vad, self->prototype);
+  stream->next_seq = seq;
+  stream->next_timestamp = timestamp;
+  stream->first_timestamp = timestamp;
+}
+
+// Advances over |num_frames| frames without audio. While in speech this goes
+// frame by frame, so that a stop event gets the frame the hangover ends on.
+static void SkipFrames(VadRtp* self, Stream* stream, uint32_t num_frames) {
+  uint32_t timestamp = stream->next_timestamp;
+
+  if (num_frames > kMaxSkipFrames) {
+    num_frames = kMaxSkipFrames;
+  }
+  self->stats.skipped_frames += num_frames;
+  while (num_frames > 0 && stream->speech) {
+    if (WebRtcVad_ProcessNonSpeech(stream->vad, kRate, stream->frame_length,
+                                   1, NULL) == 0) {
+      Emit(self, stream, kVadRtpStop, timestamp);
+    }
+    timestamp += stream->frame_length;
+    num_frames--;
+  }
+  if (num_frames > 0) {
+    WebRtcVad_ProcessNonSpeech(stream->vad, kRate, stream->frame_length,
+                               (int) num_frames, NULL);
+  }
+}
+
+// Skips the frames of |num_packets| lost packets.
+static void SkipLost(VadRtp* self, Stream* stream, uint32_t num_packets) {
+  const uint32_t frames_per_packet =
+      stream->packet_samples / stream->frame_length;
+
+  self->stats.lost_packets += num_packets;
+  SkipFrames(self, stream, num_packets * frames_per_packet);
+  stream->next_seq = (uint16_t) (stream->next_seq + num_packets);
+  stream->next_timestamp += num_packets * stream->packet_samples;
+}
+
+// Runs the packet |seq| through the VAD, after the frames of a DTX pause
+// before it.
+static void PlayOut(VadRtp* self, Stream* stream, uint16_t seq,
+                    uint32_t timestamp, int payload_type,
+                    const uint8_t* payload, int length) {
+  const int format = payload_type == kPayloadTypeMuLaw ? kVadFormatMuLaw :
+      kVadFormatALaw;
+  const int32_t pause = (int32_t) (timestamp - stream->next_timestamp);
+  int offset, vad;
+
+  if (pause > 0) {
+    SkipFrames(self, stream, (uint32_t) pause / stream->frame_length);
+  }
+  // The largest frame that divides the payload.
+  stream->frame_length = length % 240 == 0 ? 240 :
+      length % 160 == 0 ? 160 : kMinFrameLength;
+  stream->packet_samples = length;
+  for (offset = 0; offset < length; offset += stream->frame_length) {
+    vad = WebRtcVad_ProcessFormat(stream->vad, kRate, format,
+                                  &payload[offset], stream->frame_length);
+    self->stats.frames++;
+    if (vad >= 0 && vad != stream->speech) {
+      Emit(self, stream, vad ? kVadRtpStart : kVadRtpStop,
+           timestamp + offset);
+    }
+  }
+  stream->next_seq = (uint16_t) (seq + 1);
+  stream->next_timestamp = timestamp + length;
+}
+
+// Plays out the buffered packets that are next in sequence.
+static void Drain(VadRtp* self, Stream* stream) {
+  const int jitter_packets = self->config.jitter_packets;
+
+  while (stream->buffered > 0) {
+    Slot* slot = &stream->slots[stream->next_seq % jitter_packets];
+
+    if (!slot->filled || slot->seq != stream->next_seq) {
+      return;
+    }
+    slot->filled = 0;
+    stream->buffered--;
+    PlayOut(self, stream, slot->seq, slot->timestamp, slot->payload_type,
+            slot->payload, slot->length);
+  }
+  RemoveWaiting(self, stream);
+}
+
+// Gives up on the missing packets before the first buffered one.
+static void SkipToBuffered(VadRtp* self, Stream* stream) {
+  const int jitter_packets = self->config.jitter_packets;
+  uint32_t missing = 0;
+
+  while (!stream->slots[(stream->next_seq + missing) % jitter_packets].filled) {
+    missing++;
+  }
+  SkipLost(self, stream, missing);
+  Drain(self, stream);
+}
+
+static Stream* CreateStream(VadRtp* self, uint32_t ssrc) {
+  Stream* stream = (Stream*) calloc(1, sizeof(Stream));
+
+  if (stream == NULL) {
+    return NULL;
+  }
+  if (WebRtcVad_Create(&stream->vad) != 0 ||
+      WebRtcVad_Clone(stream->vad, self->prototype) != 0) {
+    WebRtcVad_Free(stream->vad);
+    free(stream);
+    return NULL;
+  }
+  stream->ssrc = ssrc;
+  InsertStream(self, stream);
+  self->stats.streams++;
+  self->stats.streams_created++;
+  return stream;
+}
+
+static void FreeStream(Stream* stream) {
+  WebRtcVad_Free(stream->vad);
+  free(stream->slots);
+  free(stream);
+}
+
+VadRtp* VadRtp_Create(const VadRtpConfig* config, VadRtpEventFunction on_event,
+                      void* context) {
+  VadRtp* self;
+  uint32_t size = 1;
+
+  self = (VadRtp*) calloc(1, sizeof(VadRtp));
+  if (self == NULL) {
+    return NULL;
+  }
+  if (config != NULL) {
+    self->config = *config;
+  } else {
+    VadRtp_DefaultConfig(&self->config);
+  }
+  self->on_event = on_event;
+  self->context = context;
+  if (self->config.jitter_packets < 1 ||
+      self->config.jitter_packets > kMaxJitterPackets ||
+      self->config.jitter_ms < 0 || self->config.idle_timeout_ms <= 0 ||
+      self->config.max_streams < 1 || self->config.max_streams > (1 << 24)) {
+    free(self);
+    return NULL;
+  }
+  while (size < 2 * (uint32_t) self->config.max_streams) {
+    size <<= 1;
+  }
+  self->table = (Stream**) calloc(size, sizeof(Stream*));
+  self->table_mask = size - 1;
+  if (self->table == NULL || WebRtcVad_Create(&self->prototype) != 0 ||
+      WebRtcVad_Init(self->prototype) != 0 ||
+      WebRtcVad_set_mode(self->prototype, self->config.mode) != 0) {
+    VadRtp_Free(self);
+    return NULL;
+  }
+  return self;
+}
+
+void VadRtp_Free(VadRtp* self) {
+  uint32_t i;
+
+  if (self == NULL) {
+    return;
+  }
+  if (self->table != NULL) {
+    for (i = 0; i <= self->table_mask; i++) {
+      if (self->table[i] != NULL) {
+        FreeStream(self->table[i]);
+      }
+    }
+  }
+  free(self->table);
+  WebRtcVad_Free(self->prototype);
+  free(self);
+}
+
+int VadRtp_Input(VadRtp* self, const uint8_t* packet, size_t length,
+                 uint64_t now_ms) {
+  size_t header = kRtpHeaderSize;
+  size_t payload_length;
+  int payload_type;
+  uint16_t seq;
+  uint32_t timestamp, ssrc;
+  int16_t ahead;
+  Stream* stream;
+  Slot* slot;
+
+  // Version 2, CSRCs, extension and padding.
+  if (length < kRtpHeaderSize || (packet[0] >> 6) != 2) {
+    self->stats.invalid_packets++;
+    return -1;
+  }
+  header += 4 * (packet[0] & 0x0F);
+  if ((packet[0] & 0x10) && header + 4 <= length) {
+    header += 4 + 4 * ((packet[header + 2] << 8) | packet[header + 3]);
+  }
+  payload_length = length;
+  if ((packet[0] & 0x20) && length > header) {
+    payload_length -= packet[length - 1];
+  }
+  payload_type = packet[1] & 0x7F;
+  if (payload_length <= header ||
+      (payload_type != kPayloadTypeMuLaw && payload_type != kPayloadTypeALaw)) {
+    self->stats.invalid_packets++;
+    return -1;
+  }
+  payload_length -= header;
+  if (payload_length > kMaxPayload || payload_length % kMinFrameLength != 0) {
+    self->stats.invalid_packets++;
+    return -1;
+  }
+  seq = (uint16_t) ((packet[2] << 8) | packet[3]);
+  timestamp = ((uint32_t) packet[4] << 24) | (packet[5] << 16) |
+      (packet[6] << 8) | packet[7];
+  ssrc = ((uint32_t) packet[8] << 24) | (packet[9] << 16) |
+      (packet[10] << 8) | packet[11];
+
+  stream = FindStream(self, ssrc);
+  if (stream == NULL) {
+    if (self->stats.streams >= self->config.max_streams) {
+      self->stats.dropped_packets++;
+      return -1;
+    }
+    stream = CreateStream(self, ssrc);
+    if (stream == NULL) {
+      self->stats.dropped_packets++;
+      return -1;
+    }
+    stream->next_seq = seq;
+    stream->next_timestamp = timestamp;
+    stream->first_timestamp = timestamp;
+    stream->frame_length = kMinFrameLength;
+    stream->packet_samples = (int) payload_length;
+  }
+  self->stats.packets++;
+  stream->last_packet_ms = now_ms;
+
+  ahead = (int16_t) (seq - stream->next_seq);
+  if (ahead < -kMaxMisorder || ahead > kMaxDropout) {
+    self->stats.streams_reset++;
+    Restart(self, stream, seq, timestamp);
+    ahead = 0;
+  }
+  if (ahead < 0) {
+    self->stats.late_packets++;
+    return -1;
+  }
+  // The common case, straight from the packet.
+  if (ahead == 0 && stream->buffered == 0) {
+    PlayOut(self, stream, seq, timestamp, payload_type, &packet[header],
+            (int) payload_length);
+    return 0;
+  }
+
+  if (stream->slots == NULL) {
+    stream->slots = (Slot*) calloc(self->config.jitter_packets, sizeof(Slot));
+    if (stream->slots == NULL) {
+      self->stats.dropped_packets++;
+      return -1;
+    }
+  }
+  // No room behind the gap: play out or give up on the oldest packets.
+  while (ahead >= self->config.jitter_packets) {
+    if (stream->buffered == 0) {
+      SkipLost(self, stream, ahead - self->config.jitter_packets + 1);
+    } else {
+      SkipToBuffered(self, stream);
+    }
+    ahead = (int16_t) (seq - stream->next_seq);
+  }
+  slot = &stream->slots[seq % self->config.jitter_packets];
+  if (slot->filled) {
+    self->stats.duplicate_packets++;
+    return -1;
+  }
+  slot->filled = 1;
+  slot->payload_type = (uint8_t) payload_type;
+  slot->seq = seq;
+  slot->length = (uint16_t) payload_length;
+  slot->timestamp = timestamp;
+  slot->arrival_ms = now_ms;
+  memcpy(slot->payload, &packet[header], payload_length);
+  if (stream->buffered++ == 0) {
+    AddWaiting(self, stream);
+  }
+  Drain(self, stream);
+  return 0;
+}
+
+int VadRtp_Poll(VadRtp* self, uint64_t now_ms) {
+  const int jitter_packets = self->config.jitter_packets;
+  int64_t due_ms = kIdleScanMs;
+  Stream* stream = self->waiting;
+  uint32_t i;
+
+  while (stream != NULL) {
+    Stream* next = stream->next_waiting;
+    const Slot* first = NULL;
+    int n;
+
+    // The first buffered packet waited longest for the gap before it.
+    for (n = 0; first == NULL && n < jitter_packets; n++) {
+      const Slot* slot = &stream->slots[(stream->next_seq + n) %
+                                        jitter_packets];
+      if (slot->filled) {
+        first = slot;
+      }
+    }
+    if (first != NULL) {
+      const int64_t wait_ms = (int64_t) (first->arrival_ms +
+                                         self->config.jitter_ms) -
+          (int64_t) now_ms;
+
+      if (wait_ms <= 0) {
+        SkipToBuffered(self, stream);
+      } else if (wait_ms < due_ms) {
+        due_ms = wait_ms;
+      }
+    }
+    stream = next;
+  }
+
+  if (now_ms >= self->next_idle_scan_ms) {
+    self->next_idle_scan_ms = now_ms + kIdleScanMs;
+    i = 0;
+    while (i <= self->table_mask) {
+      stream = self->table[i];
+      if (stream != NULL &&
+          now_ms - stream->last_packet_ms >=
+          (uint64_t) self->config.idle_timeout_ms) {
+        if (stream->speech) {
+          Emit(self, stream, kVadRtpStop, stream->next_timestamp);
+        }
+        if (stream->buffered > 0) {
+          RemoveWaiting(self, stream);
+        }
+        RemoveAt(self, i);
+        FreeStream(stream);
+        self->stats.streams--;
+        // A later entry may have moved to |i|.
+        continue;
+      }
+      i++;
+    }
+  }
+  return (int) due_ms;
+}
+
+void VadRtp_GetStats(const VadRtp* self, VadRtpStats* stats) {
+  *stats = self->stats;
+}
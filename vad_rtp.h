@@ -0,0 +1,103 @@
+#ifndef VAD_RTP_H_
+#define VAD_RTP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vad.h"
+
+// RTP ingest for a VAD sidecar. Packets of any number of streams are handed
+// in one at a time, independent of how they were received. Every SSRC gets
+// its own VAD instance and a small jitter buffer that puts the packets back
+// into sequence order. G.711 payloads (PT 0, mu-law, and PT 8, A-law) are
+// processed straight from the packet in 10, 20 or 30 ms frames at 8 kHz.
+//
+// A packet in sequence is processed when it arrives. Behind a gap, packets
+// are held until the missing one arrives, the buffer is full or the gap is
+// older than |jitter_ms|; the missing packets then count as lost, and their
+// frames as well as those of a DTX pause in the RTP timestamps are skipped
+// with WebRtcVad_ProcessNonSpeech(). Changes of the decision are reported as
+// start and stop events with the media time of the frame.
+//
+// Not thread safe; use one VadRtp per thread.
+typedef struct VadRtp VadRtp;
+
+typedef struct {
+  int mode;                // VAD aggressiveness, 0 - 3.
+  int jitter_packets;      // Jitter buffer slots per stream, 1 - 64.
+  int jitter_ms;           // Longest wait for a missing packet.
+  int idle_timeout_ms;     // Streams without packets are dropped after this.
+  int max_streams;         // Packets of further SSRCs are dropped.
+} VadRtpConfig;
+
+enum {
+  kVadRtpStart = 1,        // Speech started.
+  kVadRtpStop = 0          // Speech ended, or its stream was dropped.
+};
+
+typedef struct {
+  uint32_t ssrc;
+  int type;                // kVadRtpStart or kVadRtpStop.
+  // Media time of the first frame with the new decision, from the RTP
+  // timestamp, relative to the first packet of the stream.
+  uint32_t media_ms;
+} VadRtpEvent;
+
+typedef void (*VadRtpEventFunction)(void* context, const VadRtpEvent* event);
+
+typedef struct {
+  uint64_t packets;            // Accepted RTP packets.
+  uint64_t invalid_packets;    // Not RTP, unsupported payload or length.
+  uint64_t late_packets;       // Arrived after their slot was played out.
+  uint64_t duplicate_packets;
+  uint64_t dropped_packets;    // Of SSRCs beyond |max_streams|.
+  uint64_t lost_packets;       // Never arrived in time, skipped.
+  uint64_t frames;             // Run through WebRtcVad_ProcessFormat().
+  uint64_t skipped_frames;     // Lost or DTX, WebRtcVad_ProcessNonSpeech().
+  uint64_t events;
+  uint64_t streams_created;
+  uint64_t streams_reset;      // Sequence number or SSRC reused.
+  int streams;                 // Current number of streams.
+} VadRtpStats;
+
+// Sets |config| to the defaults: mode 2, 8 packets, 60 ms jitter, 10 s idle
+// timeout and 65536 streams.
+void VadRtp_DefaultConfig(VadRtpConfig* config);
+
+// Creates an ingest without streams.
+//
+// - config   [i] : Settings, or NULL for the defaults.
+// - on_event [i] : Called with every start and stop event, or NULL.
+// - context  [i] : Passed to |on_event|.
+//
+// returns        : The ingest, or NULL (invalid settings or out of memory)
+VadRtp* VadRtp_Create(const VadRtpConfig* config, VadRtpEventFunction on_event,
+                      void* context);
+
+// Frees the ingest and all its streams, without events.
+void VadRtp_Free(VadRtp* self);
+
+// Hands in one UDP payload.
+//
+// - self   [i/o] : Ingest.
+// - packet [i]   : RTP packet, only read during the call.
+// - length [i]   : Size of |packet| in bytes.
+// - now_ms [i]   : Monotonic time of arrival.
+//
+// returns        : 0 - (OK, possibly buffered), -1 - (not accepted, see the
+//                  statistics)
+int VadRtp_Input(VadRtp* self, const uint8_t* packet, size_t length,
+                 uint64_t now_ms);
+
+// Plays out the packets behind gaps older than |jitter_ms| and drops idle
+// streams, with a stop event if they were in speech. Call at least every
+// few milliseconds; only the streams waiting for a packet are visited on
+// every call.
+//
+// returns : Milliseconds until the next call is due, at most 1000.
+int VadRtp_Poll(VadRtp* self, uint64_t now_ms);
+
+// Copies the counters.
+void VadRtp_GetStats(const VadRtp* self, VadRtpStats* stats);
+
+#endif  // VAD_RTP_H_
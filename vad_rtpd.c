@@ -0,0 +1,542 @@
+// VAD sidecar for a media server: receives G.711 RTP over UDP and reports
+// speech start and stop per stream, see vad_rtp.h.
+//
+// Usage: vad_rtpd [-a addr] [-p port] [-u events.sock] [-m mode]
+//                 [-j jitter_packets] [-w jitter_ms] [-s stats_s]
+//                 [-t threads] [-k batch] [-b]
+//
+// Events go as text lines to every client connected to the Unix socket:
+//
+//   start <ssrc in hex> <media ms>
+//   stop <ssrc in hex> <media ms>
+//
+// A client that does not keep up is disconnected.
+//
+// Every worker thread is pinned to one of the cores the process may run on
+// and has its own UDP socket on the
+// port (SO_REUSEPORT) and its own VadRtp. The kernel spreads the senders
+// over the sockets by address and port, so the packets of a stream always
+// reach the same worker as long as it comes from a single source port. A
+// worker drains its socket with recvmmsg() in batches of |batch| packets and
+// hands them to the streams straight from the receive buffers; the event
+// lines of a batch go out with one send() per client. With -b the workers
+// spin on the socket instead of sleeping in epoll, for the lowest latency at
+// the cost of a busy core each. The main thread serves the clients, the
+// statistics, SIGINT and SIGTERM.
+
+// recvmmsg(), accept4() and pthread_setaffinity_np().
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vad_rtp.h"
+
+enum { kMaxBatch = 64 };
+// Batches received before the timeouts are served again.
+enum { kMaxBatchesPerWakeup = 16 };
+enum { kMaxPacket = 1500 };
+enum { kMaxClients = 16 };
+enum { kMaxThreads = 256 };
+enum { kReceiveBuffer = 8 << 20 };
+// Event lines collected before they are sent, 32 bytes each at most.
+enum { kEventBuffer = 16384 };
+// Busy polling in the kernel, where the driver supports it.
+enum { kBusyPollUs = 50 };
+
+typedef struct {
+  pthread_mutex_t mutex;
+  int sockets[kMaxClients];
+  int num_sockets;
+} Clients;
+
+typedef struct {
+  int socket;
+  int cpu;  // -1 if the worker is not pinned.
+  int batch;
+  int busy_poll;
+  VadRtp* rtp;
+  Clients* clients;
+  // Read and written with __atomic builtins.
+  const int* running;
+  // Readable once the workers are to stop.
+  int stop_fd;
+  pthread_t thread;
+  // Event lines of the current batch.
+  char events[kEventBuffer];
+  size_t events_length;
+  // Copy of the counters for the main thread.
+  pthread_mutex_t stats_mutex;
+  VadRtpStats stats;
+  uint8_t buffers[kMaxBatch][kMaxPacket];
+  struct mmsghdr messages[kMaxBatch];
+  struct iovec iovecs[kMaxBatch];
+} Worker;
+
+static uint64_t NowMs(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static double CpuSeconds(void) {
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+      (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// Needs |clients->mutex|.
+static void DropClient(Clients* clients, int i) {
+  close(clients->sockets[i]);
+  clients->sockets[i] = clients->sockets[--clients->num_sockets];
+}
+
+static void FlushEvents(Worker* worker) {
+  Clients* clients = worker->clients;
+  int i;
+
+  if (worker->events_length == 0) {
+    return;
+  }
+  pthread_mutex_lock(&clients->mutex);
+  for (i = clients->num_sockets - 1; i >= 0; i--) {
+    if (send(clients->sockets[i], worker->events, worker->events_length,
+             MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t) worker->events_length) {
+      fprintf(stderr, "client too slow or gone, disconnected\n");
+      DropClient(clients, i);
+    }
+  }
+  pthread_mutex_unlock(&clients->mutex);
+  worker->events_length = 0;
+}
+
+static void AddEvent(void* context, const VadRtpEvent* event) {
+  Worker* worker = (Worker*) context;
+
+  if (worker->events_length + 32 > kEventBuffer) {
+    FlushEvents(worker);
+  }
+  worker->events_length +=
+      sprintf(worker->events + worker->events_length, "%s %08x %u\n",
+              event->type == kVadRtpStart ? "start" : "stop", event->ssrc,
+              event->media_ms);
+}
+
+static void* RunWorker(void* argument) {
+  Worker* worker = (Worker*) argument;
+  VadRtp* rtp = worker->rtp;
+  cpu_set_t cpus;
+  struct epoll_event event;
+  int epoll_fd = -1;
+  int timeout_ms = 0;
+  uint64_t last_poll_ms = 0;
+  int i;
+
+  if (worker->cpu >= 0) {
+    int error;
+
+    CPU_ZERO(&cpus);
+    CPU_SET(worker->cpu, &cpus);
+    error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (error != 0) {
+      fprintf(stderr, "cannot pin a worker to cpu %d: %s\n", worker->cpu,
+              strerror(error));
+    }
+  }
+
+  if (!worker->busy_poll) {
+    epoll_fd = epoll_create1(0);
+    event.events = EPOLLIN;
+    event.data.fd = worker->socket;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, worker->socket, &event);
+    event.data.fd = worker->stop_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, worker->stop_fd, &event);
+  }
+  for (i = 0; i < worker->batch; i++) {
+    worker->iovecs[i].iov_base = worker->buffers[i];
+    worker->iovecs[i].iov_len = kMaxPacket;
+    memset(&worker->messages[i].msg_hdr, 0, sizeof(struct msghdr));
+    worker->messages[i].msg_hdr.msg_iov = &worker->iovecs[i];
+    worker->messages[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  while (__atomic_load_n(worker->running, __ATOMIC_RELAXED)) {
+    uint64_t now_ms;
+    int batches;
+
+    if (!worker->busy_poll &&
+        epoll_wait(epoll_fd, &event, 1, timeout_ms) < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      exit(1);
+    }
+    for (batches = 0; batches < kMaxBatchesPerWakeup; batches++) {
+      const int received = recvmmsg(worker->socket, worker->messages,
+                                    worker->batch, MSG_DONTWAIT, NULL);
+
+      if (received <= 0) {
+        break;
+      }
+      now_ms = NowMs();
+      for (i = 0; i < received; i++) {
+        VadRtp_Input(rtp, worker->buffers[i], worker->messages[i].msg_len,
+                     now_ms);
+      }
+      if (received < worker->batch) {
+        break;
+      }
+    }
+
+    // Spinning, the timeouts are due at most once per millisecond.
+    now_ms = NowMs();
+    if (!worker->busy_poll || now_ms != last_poll_ms) {
+      timeout_ms = VadRtp_Poll(rtp, now_ms);
+      last_poll_ms = now_ms;
+      pthread_mutex_lock(&worker->stats_mutex);
+      VadRtp_GetStats(rtp, &worker->stats);
+      pthread_mutex_unlock(&worker->stats_mutex);
+    }
+    FlushEvents(worker);
+  }
+
+  if (epoll_fd >= 0) {
+    close(epoll_fd);
+  }
+  return NULL;
+}
+
+static int OpenSocket(const struct sockaddr_in* address, int busy_poll) {
+  const int one = 1;
+  const int busy_poll_us = kBusyPollUs;
+  int size = kReceiveBuffer;
+  int fd;
+
+  fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  if (fd < 0 ||
+      setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0) {
+    return -1;
+  }
+  // Rides out scheduling hiccups at high packet rates.
+  if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) != 0) {
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  }
+  if (busy_poll) {
+    setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us,
+               sizeof(busy_poll_us));
+  }
+  if (bind(fd, (const struct sockaddr*) address, sizeof(*address)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void PrintStats(Worker* workers, int num_threads, double seconds,
+                       double cpu_seconds, uint64_t* last_packets) {
+  VadRtpStats total;
+  int t;
+
+  memset(&total, 0, sizeof(total));
+  for (t = 0; t < num_threads; t++) {
+    VadRtpStats stats;
+
+    pthread_mutex_lock(&workers[t].stats_mutex);
+    stats = workers[t].stats;
+    pthread_mutex_unlock(&workers[t].stats_mutex);
+    total.packets += stats.packets;
+    total.invalid_packets += stats.invalid_packets;
+    total.late_packets += stats.late_packets;
+    total.duplicate_packets += stats.duplicate_packets;
+    total.dropped_packets += stats.dropped_packets;
+    total.lost_packets += stats.lost_packets;
+    total.streams_reset += stats.streams_reset;
+    total.events += stats.events;
+    total.streams += stats.streams;
+  }
+  fprintf(stderr, "%.0f pps, %.0f%% cpu, %d streams, %llu packets, "
+          "%llu lost, %llu late, %llu duplicate, %llu invalid, "
+          "%llu dropped, %llu resets, %llu events\n",
+          (total.packets - *last_packets) / seconds,
+          100 * cpu_seconds / seconds, total.streams,
+          (unsigned long long) total.packets,
+          (unsigned long long) total.lost_packets,
+          (unsigned long long) total.late_packets,
+          (unsigned long long) total.duplicate_packets,
+          (unsigned long long) total.invalid_packets,
+          (unsigned long long) total.dropped_packets,
+          (unsigned long long) total.streams_reset,
+          (unsigned long long) total.events);
+  *last_packets = total.packets;
+}
+
+static void Usage(void) {
+  fprintf(stderr, "usage: vad_rtpd [-a addr] [-p port] [-u events.sock] "
+          "[-m mode] [-j jitter_packets] [-w jitter_ms] [-s stats_s] "
+          "[-t threads] [-k batch] [-b]\n");
+}
+
+int main(int argc, char* argv[]) {
+  const char* address = "0.0.0.0";
+  int port = 5004;
+  const char* events_path = "/tmp/vad_rtpd.sock";
+  int stats_s = 10;
+  int num_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  int batch = kMaxBatch;
+  int busy_poll = 0;
+  VadRtpConfig config;
+  Clients clients;
+  Worker* workers;
+  cpu_set_t allowed_cpus;
+  int num_allowed_cpus = 0;
+  struct sockaddr_in udp_address;
+  struct sockaddr_un unix_address;
+  struct epoll_event event;
+  sigset_t signals;
+  int listener, signals_fd, stop_fd, epoll_fd;
+  int running = 1;
+  uint64_t next_stats_ms, last_stats_ms, last_packets = 0;
+  double last_cpu_seconds;
+  int opt, i, t;
+
+  // The workers are pinned to the cores of the process's cpuset, one per
+  // core as long as there are enough.
+  if (sched_getaffinity(0, sizeof(allowed_cpus), &allowed_cpus) == 0) {
+    num_allowed_cpus = CPU_COUNT(&allowed_cpus);
+    num_threads = num_allowed_cpus;
+  } else {
+    perror("sched_getaffinity, the workers are not pinned");
+  }
+
+  VadRtp_DefaultConfig(&config);
+  while ((opt = getopt(argc, argv, "a:p:u:m:j:w:s:t:k:b")) != -1) {
+    if (opt == 'a') {
+      address = optarg;
+    } else if (opt == 'p') {
+      port = atoi(optarg);
+    } else if (opt == 'u') {
+      events_path = optarg;
+    } else if (opt == 'm') {
+      config.mode = atoi(optarg);
+    } else if (opt == 'j') {
+      config.jitter_packets = atoi(optarg);
+    } else if (opt == 'w') {
+      config.jitter_ms = atoi(optarg);
+    } else if (opt == 's') {
+      stats_s = atoi(optarg);
+    } else if (opt == 't') {
+      num_threads = atoi(optarg);
+    } else if (opt == 'k') {
+      batch = atoi(optarg);
+    } else if (opt == 'b') {
+      busy_poll = 1;
+    } else {
+      Usage();
+      return 1;
+    }
+  }
+  if (optind != argc || stats_s < 1 || num_threads < 1 ||
+      num_threads > kMaxThreads || batch < 1 || batch > kMaxBatch) {
+    Usage();
+    return 1;
+  }
+
+  memset(&udp_address, 0, sizeof(udp_address));
+  udp_address.sin_family = AF_INET;
+  udp_address.sin_port = htons((uint16_t) port);
+  if (inet_pton(AF_INET, address, &udp_address.sin_addr) != 1) {
+    fprintf(stderr, "invalid address: %s\n", address);
+    return 1;
+  }
+
+  memset(&unix_address, 0, sizeof(unix_address));
+  unix_address.sun_family = AF_UNIX;
+  if (strlen(events_path) >= sizeof(unix_address.sun_path)) {
+    fprintf(stderr, "path too long: %s\n", events_path);
+    return 1;
+  }
+  strcpy(unix_address.sun_path, events_path);
+  unlink(events_path);
+  listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (bind(listener, (struct sockaddr*) &unix_address,
+           sizeof(unix_address)) != 0 || listen(listener, kMaxClients) != 0) {
+    perror(events_path);
+    return 1;
+  }
+
+  // Before the workers start, so that they inherit the mask.
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, NULL);
+  signals_fd = signalfd(-1, &signals, SFD_NONBLOCK);
+  stop_fd = eventfd(0, EFD_NONBLOCK);
+
+  pthread_mutex_init(&clients.mutex, NULL);
+  clients.num_sockets = 0;
+  workers = (Worker*) calloc(num_threads, sizeof(Worker));
+  if (workers == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  // All sockets are bound before any packet is read, so that the kernel
+  // spreads the senders over all of them from the start.
+  for (t = 0; t < num_threads; t++) {
+    workers[t].rtp = VadRtp_Create(&config, AddEvent, &workers[t]);
+    if (workers[t].rtp == NULL) {
+      fprintf(stderr, "invalid settings\n");
+      return 1;
+    }
+    workers[t].socket = OpenSocket(&udp_address, busy_poll);
+    if (workers[t].socket < 0) {
+      perror("udp");
+      return 1;
+    }
+  }
+  for (t = 0; t < num_threads; t++) {
+    workers[t].cpu = -1;
+    if (num_allowed_cpus > 0) {
+      int cpu, n = t % num_allowed_cpus;
+
+      // The n-th allowed cpu.
+      for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed_cpus) && n-- == 0) {
+          workers[t].cpu = cpu;
+          break;
+        }
+      }
+    }
+    workers[t].batch = batch;
+    workers[t].busy_poll = busy_poll;
+    workers[t].clients = &clients;
+    workers[t].running = &running;
+    workers[t].stop_fd = stop_fd;
+    pthread_mutex_init(&workers[t].stats_mutex, NULL);
+    if (pthread_create(&workers[t].thread, NULL, RunWorker,
+                       &workers[t]) != 0) {
+      fprintf(stderr, "cannot start the workers\n");
+      return 1;
+    }
+  }
+
+  epoll_fd = epoll_create1(0);
+  event.events = EPOLLIN;
+  event.data.fd = listener;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listener, &event);
+  event.data.fd = signals_fd;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signals_fd, &event);
+
+  fprintf(stderr, "listening on %s:%d, events on %s, mode %d, %d packets "
+          "or %d ms of jitter, %d threads, batches of %d%s\n", address, port,
+          events_path, config.mode, config.jitter_packets, config.jitter_ms,
+          num_threads, batch, busy_poll ? ", busy polling" : "");
+  last_stats_ms = NowMs();
+  next_stats_ms = last_stats_ms + stats_s * 1000;
+  last_cpu_seconds = CpuSeconds();
+
+  while (__atomic_load_n(&running, __ATOMIC_RELAXED)) {
+    struct epoll_event events[kMaxClients + 2];
+    uint64_t now_ms;
+    int num_events, n;
+
+    now_ms = NowMs();
+    num_events = epoll_wait(epoll_fd, events, kMaxClients + 2,
+                            now_ms < next_stats_ms ?
+                            (int) (next_stats_ms - now_ms) : 0);
+    if (num_events < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      break;
+    }
+    for (n = 0; n < num_events; n++) {
+      const int fd = events[n].data.fd;
+
+      if (fd == listener) {
+        const int client = accept4(listener, NULL, NULL, SOCK_NONBLOCK);
+
+        if (client < 0) {
+          continue;
+        }
+        pthread_mutex_lock(&clients.mutex);
+        if (clients.num_sockets == kMaxClients) {
+          close(client);
+        } else {
+          clients.sockets[clients.num_sockets++] = client;
+          event.events = EPOLLIN;
+          event.data.fd = client;
+          epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client, &event);
+        }
+        pthread_mutex_unlock(&clients.mutex);
+      } else if (fd == signals_fd) {
+        __atomic_store_n(&running, 0, __ATOMIC_RELAXED);
+      } else {
+        // Clients only ever close. The socket may also have been dropped
+        // by a worker already, and its number reused.
+        char discard[256];
+        const ssize_t size = read(fd, discard, sizeof(discard));
+
+        if (size == 0 || (size < 0 && errno != EAGAIN)) {
+          pthread_mutex_lock(&clients.mutex);
+          for (i = 0; i < clients.num_sockets; i++) {
+            if (clients.sockets[i] == fd) {
+              DropClient(&clients, i);
+              break;
+            }
+          }
+          pthread_mutex_unlock(&clients.mutex);
+        }
+      }
+    }
+
+    now_ms = NowMs();
+    if (now_ms >= next_stats_ms) {
+      const double cpu_seconds = CpuSeconds();
+
+      PrintStats(workers, num_threads, (now_ms - last_stats_ms) / 1e3,
+                 cpu_seconds - last_cpu_seconds, &last_packets);
+      last_stats_ms = now_ms;
+      last_cpu_seconds = cpu_seconds;
+      next_stats_ms = now_ms + stats_s * 1000;
+    }
+  }
+
+  // Also after an error above.
+  __atomic_store_n(&running, 0, __ATOMIC_RELAXED);
+  {
+    const uint64_t one = 1;
+
+    if (write(stop_fd, &one, sizeof(one)) != sizeof(one)) {
+      perror("eventfd");
+    }
+  }
+  for (t = 0; t < num_threads; t++) {
+    pthread_join(workers[t].thread, NULL);
+    close(workers[t].socket);
+    VadRtp_Free(workers[t].rtp);
+  }
+  for (i = 0; i < clients.num_sockets; i++) {
+    close(clients.sockets[i]);
+  }
+  close(listener);
+  unlink(events_path);
+  close(signals_fd);
+  close(stop_fd);
+  close(epoll_fd);
+  free(workers);
+  return 0;
+}
@@ -0,0 +1,612 @@
+// Shared memory transport between a media process and a VAD worker, see
+// vad_shm.h.
+
+// memfd_create() and the file seals.
+#define _GNU_SOURCE
+
+#include "vad_shm.h"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+enum { kMagic = 0x53444156 };  // "VADS"
+enum { kVersion = 1 };
+enum { kMaxFrameLength = 1440 };
+enum { kMaxStreams = 1 << 20 };
+enum { kMaxRingFrames = 4096 };
+enum { kMaxDecisionRingSize = 1 << 24 };
+// The worker checks for VadShm_Stop() this often while it waits for room in
+// the decision ring.
+enum { kStopCheckMs = 100 };
+
+// Start of the segment. Each side writes to its own cache lines only.
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t num_streams;
+  uint32_t ring_frames;
+  uint32_t max_frame_length;
+  uint32_t decision_ring_size;
+  uint32_t wake_batch;
+  uint32_t changes_only;
+  uint64_t size;
+  uint8_t padding0[64 - 40];
+  // Media side: bumped for every wakeup of the worker.
+  uint32_t audio_doorbell;
+  uint32_t decision_tail;
+  uint32_t stopped;
+  uint32_t reader_waiting;
+  uint8_t padding1[64 - 16];
+  // Worker side.
+  uint32_t decision_head;
+  uint32_t worker_waiting;
+  uint32_t space_waiting;
+  uint8_t padding2[64 - 12];
+} Header;
+
+typedef struct {
+  // Media side.
+  uint32_t head;
+  // |head| when the stream was opened, frame indices count from here.
+  uint32_t base;
+  uint32_t generation;
+  int32_t fs;
+  int32_t frame_length;
+  int32_t mode;
+  uint8_t padding0[64 - 24];
+  // Worker side.
+  uint32_t tail;
+  uint8_t padding1[64 - 4];
+} StreamRing;
+
+// The worker's own state of a stream, never in the segment.
+typedef struct {
+  VadInst* vad;
+  uint32_t generation;
+  uint32_t base;
+  int fs;
+  int frame_length;
+  int last_decision;
+} WorkerStream;
+
+struct VadShm {
+  int fd;
+  int owner;
+  void* map;
+  size_t size;
+  // Validated copy of the settings in the segment.
+  VadShmConfig config;
+  Header* header;
+  uint64_t* ready;
+  StreamRing* streams;
+  int16_t* audio;
+  VadShmDecision* decisions;
+  // Media side.
+  int pending_frames;
+  int* frame_lengths;
+  // Worker side, allocated with the first VadShm_Work().
+  WorkerStream* workers;
+  int pending_decisions;
+};
+
+static int Futex(uint32_t* word, int op, uint32_t value, int timeout_ms) {
+  struct timespec timeout;
+
+  timeout.tv_sec = timeout_ms / 1000;
+  timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+  return (int) syscall(SYS_futex, word, op, value,
+                       timeout_ms >= 0 ? &timeout : NULL, NULL, 0);
+}
+
+static void Wake(uint32_t* word) {
+  Futex(word, FUTEX_WAKE, 1, -1);
+}
+
+// Sleeps while |*word| == |value|, at most |timeout_ms|.
+static void Wait(uint32_t* word, uint32_t value, int timeout_ms) {
+  Futex(word, FUTEX_WAIT, value, timeout_ms);
+}
+
+static uint32_t Load(const uint32_t* word) {
+  return __atomic_load_n(word, __ATOMIC_ACQUIRE);
+}
+
+static void Store(uint32_t* word, uint32_t value) {
+  __atomic_store_n(word, value, __ATOMIC_RELEASE);
+}
+
+static int IsPowerOfTwo(int value) {
+  return value > 0 && (value & (value - 1)) == 0;
+}
+
+void VadShm_DefaultConfig(VadShmConfig* config) {
+  config->num_streams = 1024;
+  config->ring_frames = 16;
+  config->max_frame_length = 480;
+  config->decision_ring_size = 16384;
+  config->wake_batch = 32;
+  config->changes_only = 0;
+}
+
+// Returns the size of the segment, or 0 if |config| is invalid.
+static uint64_t Layout(const VadShmConfig* config, uint64_t* streams_offset,
+                       uint64_t* audio_offset, uint64_t* decisions_offset) {
+  const uint64_t ready_words = ((uint64_t) config->num_streams + 63) / 64;
+  uint64_t size;
+
+  if (config->num_streams < 1 || config->num_streams > kMaxStreams ||
+      !IsPowerOfTwo(config->ring_frames) ||
+      config->ring_frames > kMaxRingFrames ||
+      config->max_frame_length < 1 ||
+      config->max_frame_length > kMaxFrameLength ||
+      !IsPowerOfTwo(config->decision_ring_size) ||
+      config->decision_ring_size > kMaxDecisionRingSize ||
+      config->wake_batch < 1) {
+    return 0;
+  }
+  size = sizeof(Header) + ready_words * sizeof(uint64_t);
+  size = (size + 63) & ~(uint64_t) 63;
+  *streams_offset = size;
+  size += (uint64_t) config->num_streams * sizeof(StreamRing);
+  *audio_offset = size;
+  size += (uint64_t) config->num_streams * config->ring_frames *
+      config->max_frame_length * sizeof(int16_t);
+  size = (size + 63) & ~(uint64_t) 63;
+  *decisions_offset = size;
+  size += (uint64_t) config->decision_ring_size * sizeof(VadShmDecision);
+  return size;
+}
+
+// Points |self| into the mapping.
+static void SetPointers(VadShm* self, uint64_t streams_offset,
+                        uint64_t audio_offset, uint64_t decisions_offset) {
+  uint8_t* base = (uint8_t*) self->map;
+
+  self->header = (Header*) base;
+  self->ready = (uint64_t*) (base + sizeof(Header));
+  self->streams = (StreamRing*) (base + streams_offset);
+  self->audio = (int16_t*) (base + audio_offset);
+  self->decisions = (VadShmDecision*) (base + decisions_offset);
+}
+
+VadShm* VadShm_Create(const VadShmConfig* config) {
+  VadShmConfig defaults;
+  uint64_t streams_offset, audio_offset, decisions_offset, size;
+  VadShm* self;
+
+  if (config == NULL) {
+    VadShm_DefaultConfig(&defaults);
+    config = &defaults;
+  }
+  size = Layout(config, &streams_offset, &audio_offset, &decisions_offset);
+  if (size == 0) {
+    return NULL;
+  }
+  self = (VadShm*) calloc(1, sizeof(VadShm));
+  if (self == NULL) {
+    return NULL;
+  }
+  self->config = *config;
+  self->owner = 1;
+  self->size = (size_t) size;
+  self->map = MAP_FAILED;
+  // Sealed at its size: the worker maps it only then, so that the media
+  // process cannot truncate it under the worker, nor the other way round.
+  self->fd = memfd_create("vad_shm", MFD_ALLOW_SEALING);
+  self->frame_lengths = (int*) calloc(config->num_streams, sizeof(int));
+  if (self->fd < 0 || self->frame_lengths == NULL ||
+      ftruncate(self->fd, (off_t) size) != 0 ||
+      fcntl(self->fd, F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+    VadShm_Free(self);
+    return NULL;
+  }
+  self->map = mmap(NULL, self->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   self->fd, 0);
+  if (self->map == MAP_FAILED) {
+    VadShm_Free(self);
+    return NULL;
+  }
+  SetPointers(self, streams_offset, audio_offset, decisions_offset);
+  self->header->version = kVersion;
+  self->header->num_streams = (uint32_t) config->num_streams;
+  self->header->ring_frames = (uint32_t) config->ring_frames;
+  self->header->max_frame_length = (uint32_t) config->max_frame_length;
+  self->header->decision_ring_size = (uint32_t) config->decision_ring_size;
+  self->header->wake_batch = (uint32_t) config->wake_batch;
+  self->header->changes_only = config->changes_only != 0;
+  self->header->size = size;
+  Store(&self->header->magic, kMagic);
+  return self;
+}
+
+VadShm* VadShm_Attach(int fd) {
+  struct stat status;
+  Header header;
+  uint64_t streams_offset, audio_offset, decisions_offset, size;
+  // Without these seals the peer could truncate the segment under the
+  // mapping. fcntl() fails on files that cannot be sealed at all.
+  const int required_seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+  const int seals = fcntl(fd, F_GET_SEALS);
+  VadShm* self;
+
+  if (seals < 0 || (seals & required_seals) != required_seals ||
+      fstat(fd, &status) != 0 || status.st_size < (off_t) sizeof(Header) ||
+      pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+      header.magic != kMagic || header.version != kVersion ||
+      header.num_streams > kMaxStreams ||
+      header.ring_frames > kMaxRingFrames ||
+      header.max_frame_length > kMaxFrameLength ||
+      header.decision_ring_size > kMaxDecisionRingSize ||
+      header.wake_batch > (uint32_t) 1 << 30) {
+    return NULL;
+  }
+  self = (VadShm*) calloc(1, sizeof(VadShm));
+  if (self == NULL) {
+    return NULL;
+  }
+  self->fd = fd;
+  self->config.num_streams = (int) header.num_streams;
+  self->config.ring_frames = (int) header.ring_frames;
+  self->config.max_frame_length = (int) header.max_frame_length;
+  self->config.decision_ring_size = (int) header.decision_ring_size;
+  self->config.wake_batch = (int) header.wake_batch;
+  self->config.changes_only = header.changes_only != 0;
+  size = Layout(&self->config, &streams_offset, &audio_offset,
+                &decisions_offset);
+  if (size == 0 || size != header.size || size != (uint64_t) status.st_size) {
+    free(self);
+    return NULL;
+  }
+  self->size = (size_t) size;
+  self->map = mmap(NULL, self->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                   0);
+  if (self->map == MAP_FAILED) {
+    free(self);
+    return NULL;
+  }
+  SetPointers(self, streams_offset, audio_offset, decisions_offset);
+  return self;
+}
+
+int VadShm_Fd(const VadShm* self) {
+  return self->fd;
+}
+
+void VadShm_Free(VadShm* self) {
+  int i;
+
+  if (self == NULL) {
+    return;
+  }
+  if (self->workers != NULL) {
+    for (i = 0; i < self->config.num_streams; i++) {
+      WebRtcVad_Free(self->workers[i].vad);
+    }
+    free(self->workers);
+  }
+  if (self->map != NULL && self->map != MAP_FAILED) {
+    munmap(self->map, self->size);
+  }
+  if (self->owner && self->fd >= 0) {
+    close(self->fd);
+  }
+  free(self->frame_lengths);
+  free(self);
+}
+
+int VadShm_OpenStream(VadShm* self, int stream, int fs, int frame_length,
+                      int mode) {
+  StreamRing* ring;
+
+  if (stream < 0 || stream >= self->config.num_streams ||
+      (fs != 48000 && WebRtcVad_ValidRateAndFrameLength(fs, frame_length)) ||
+      (fs == 48000 && frame_length != 480 && frame_length != 960 &&
+       frame_length != 1440) ||
+      frame_length > self->config.max_frame_length || mode < 0 || mode > 3) {
+    return -1;
+  }
+  ring = &self->streams[stream];
+  if (Load(&ring->tail) != ring->head) {
+    return -1;
+  }
+  ring->fs = fs;
+  ring->frame_length = frame_length;
+  ring->mode = mode;
+  ring->base = ring->head;
+  Store(&ring->generation, ring->generation + 1);
+  self->frame_lengths[stream] = frame_length;
+  return 0;
+}
+
+int VadShm_WriteFrame(VadShm* self, int stream, const int16_t* frame) {
+  const int frame_length = stream >= 0 && stream < self->config.num_streams ?
+      self->frame_lengths[stream] : 0;
+  StreamRing* ring;
+  uint64_t* word;
+  uint64_t bit;
+  uint32_t head;
+
+  if (frame_length == 0) {
+    return -1;
+  }
+  ring = &self->streams[stream];
+  head = ring->head;
+  if (head - Load(&ring->tail) >= (uint32_t) self->config.ring_frames) {
+    return -1;
+  }
+  memcpy(&self->audio[((size_t) stream * self->config.ring_frames +
+                       (head & (self->config.ring_frames - 1))) *
+                      self->config.max_frame_length],
+         frame, frame_length * sizeof(int16_t));
+  // Publishing |head| and testing the bit are both sequentially consistent,
+  // as are the worker clearing the bit and then reading |head| (see
+  // DrainStream()): either it sees the frame, or the bit is set again. With a
+  // release store the bit test could pass the buffered store of |head|, and
+  // the worker clear the bit and read the old |head|, stranding the frame.
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+  word = &self->ready[stream / 64];
+  bit = (uint64_t) 1 << (stream % 64);
+  if (!(__atomic_load_n(word, __ATOMIC_SEQ_CST) & bit)) {
+    __atomic_fetch_or(word, bit, __ATOMIC_SEQ_CST);
+  }
+  if (++self->pending_frames >= self->config.wake_batch) {
+    VadShm_Flush(self);
+  }
+  return 0;
+}
+
+void VadShm_Flush(VadShm* self) {
+  Header* header = self->header;
+
+  self->pending_frames = 0;
+  __atomic_fetch_add(&header->audio_doorbell, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&header->worker_waiting, __ATOMIC_SEQ_CST)) {
+    Wake(&header->audio_doorbell);
+  }
+}
+
+int VadShm_ReadDecisions(VadShm* self, VadShmDecision* decisions,
+                         int max_decisions, int timeout_ms) {
+  Header* header = self->header;
+  const uint32_t mask = (uint32_t) self->config.decision_ring_size - 1;
+  const uint32_t tail = header->decision_tail;
+  uint32_t head = Load(&header->decision_head);
+  uint32_t available, i;
+  int n = 0;
+
+  if (head == tail && timeout_ms != 0) {
+    __atomic_store_n(&header->reader_waiting, 1, __ATOMIC_SEQ_CST);
+    head = __atomic_load_n(&header->decision_head, __ATOMIC_SEQ_CST);
+    if (head == tail) {
+      Wait(&header->decision_head, head, timeout_ms);
+    }
+    __atomic_store_n(&header->reader_waiting, 0, __ATOMIC_SEQ_CST);
+    head = Load(&header->decision_head);
+  }
+  available = head - tail;
+  if (available > mask + 1) {
+    // Not a worker of ours; skip whatever it wrote.
+    __atomic_store_n(&header->decision_tail, head, __ATOMIC_SEQ_CST);
+  } else {
+    if (available > (uint32_t) max_decisions) {
+      available = (uint32_t) max_decisions;
+    }
+    for (i = 0; i < available; i++) {
+      const VadShmDecision* decision = &self->decisions[(tail + i) & mask];
+
+      if (decision->stream < (uint32_t) self->config.num_streams) {
+        decisions[n++] = *decision;
+      }
+    }
+    __atomic_store_n(&header->decision_tail, tail + available,
+                     __ATOMIC_SEQ_CST);
+  }
+  if (__atomic_load_n(&header->space_waiting, __ATOMIC_SEQ_CST)) {
+    Wake(&header->decision_tail);
+  }
+  return n;
+}
+
+void VadShm_Stop(VadShm* self) {
+  __atomic_store_n(&self->header->stopped, 1, __ATOMIC_SEQ_CST);
+  VadShm_Flush(self);
+  Wake(&self->header->decision_tail);
+}
+
+static void WakeReader(VadShm* self) {
+  self->pending_decisions = 0;
+  if (__atomic_load_n(&self->header->reader_waiting, __ATOMIC_SEQ_CST)) {
+    Wake(&self->header->decision_head);
+  }
+}
+
+// Appends a decision, waiting for room. Returns -1 if stopped meanwhile.
+static int PushDecision(VadShm* self, uint32_t stream, uint32_t frame,
+                        int decision) {
+  Header* header = self->header;
+  const uint32_t size = (uint32_t) self->config.decision_ring_size;
+  const uint32_t head = header->decision_head;
+  VadShmDecision* slot;
+
+  for (;;) {
+    const uint32_t tail = __atomic_load_n(&header->decision_tail,
+                                          __ATOMIC_SEQ_CST);
+
+    // A tail ahead of the head is corrupt and makes the ring look full.
+    if (head - tail < size) {
+      break;
+    }
+    if (__atomic_load_n(&header->stopped, __ATOMIC_ACQUIRE)) {
+      return -1;
+    }
+    // The reader must see what is there before it can make room.
+    WakeReader(self);
+    __atomic_store_n(&header->space_waiting, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->decision_tail, __ATOMIC_SEQ_CST) == tail) {
+      Wait(&header->decision_tail, tail, kStopCheckMs);
+    }
+    __atomic_store_n(&header->space_waiting, 0, __ATOMIC_SEQ_CST);
+  }
+  slot = &self->decisions[head & (size - 1)];
+  slot->stream = stream;
+  slot->frame = frame;
+  slot->decision = decision;
+  __atomic_store_n(&header->decision_head, head + 1, __ATOMIC_SEQ_CST);
+  if (++self->pending_decisions >= self->config.wake_batch) {
+    WakeReader(self);
+  }
+  return 0;
+}
+
+// Runs the VAD over the frames of |stream|. Returns the number of frames or
+// -1 if stopped.
+static int DrainStream(VadShm* self, int stream) {
+  StreamRing* ring = &self->streams[stream];
+  WorkerStream* worker = &self->workers[stream];
+  const uint32_t ring_frames = (uint32_t) self->config.ring_frames;
+  uint32_t tail = ring->tail;
+  int processed = 0;
+
+  for (;;) {
+    // Sequentially consistent after DrainReady() cleared the ready bit, see
+    // VadShm_WriteFrame().
+    const uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+    const uint32_t generation = Load(&ring->generation);
+
+    if (head == tail) {
+      return processed;
+    }
+    if (generation != worker->generation) {
+      // Settings are written before the generation, and frames after.
+      worker->generation = generation;
+      worker->base = ring->base;
+      worker->fs = ring->fs;
+      worker->frame_length = ring->frame_length;
+      worker->last_decision = -1;
+      if (worker->frame_length < 1 ||
+          worker->frame_length > self->config.max_frame_length ||
+          (worker->vad == NULL && WebRtcVad_Create(&worker->vad) != 0) ||
+          WebRtcVad_Init(worker->vad) != 0 ||
+          WebRtcVad_set_mode(worker->vad, ring->mode) != 0) {
+        worker->frame_length = 0;
+      }
+    }
+    if (head - tail > ring_frames || worker->frame_length == 0) {
+      // Not from a media process of ours, or a bad stream; drop it all.
+      tail = head;
+      Store(&ring->tail, tail);
+      continue;
+    }
+    for (; tail != head; tail++) {
+      int16_t* frame = &self->audio[((size_t) stream * ring_frames +
+                                     (tail & (ring_frames - 1))) *
+                                    self->config.max_frame_length];
+      const int decision = WebRtcVad_Process(worker->vad, worker->fs, frame,
+                                             worker->frame_length);
+
+      processed++;
+      if (decision >= 0 && (!self->config.changes_only ||
+                            decision != worker->last_decision)) {
+        if (PushDecision(self, (uint32_t) stream, tail - worker->base,
+                         decision) != 0) {
+          return -1;
+        }
+      }
+      worker->last_decision = decision;
+      // The frame may be overwritten from here on.
+      Store(&ring->tail, tail + 1);
+    }
+  }
+}
+
+// Runs the VAD over the frames of all streams flagged ready.
+static int DrainReady(VadShm* self) {
+  const int num_words = (self->config.num_streams + 63) / 64;
+  int processed = 0;
+  int w;
+
+  for (w = 0; w < num_words; w++) {
+    uint64_t bits;
+
+    if (__atomic_load_n(&self->ready[w], __ATOMIC_RELAXED) == 0) {
+      continue;
+    }
+    bits = __atomic_exchange_n(&self->ready[w], 0, __ATOMIC_SEQ_CST);
+    while (bits != 0) {
+      const int stream = w * 64 + __builtin_ctzll(bits);
+      int n;
+
+      bits &= bits - 1;
+      if (stream >= self->config.num_streams) {
+        continue;
+      }
+      n = DrainStream(self, stream);
+      if (n < 0) {
+        return -1;
+      }
+      processed += n;
+    }
+  }
+  return processed;
+}
+
+static int AnyReady(const VadShm* self) {
+  const int num_words = (self->config.num_streams + 63) / 64;
+  int w;
+
+  for (w = 0; w < num_words; w++) {
+    if (__atomic_load_n(&self->ready[w], __ATOMIC_SEQ_CST) != 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int VadShm_Work(VadShm* self, int timeout_ms) {
+  Header* header = self->header;
+  int processed = 0;
+  int waited = 0;
+
+  if (self->workers == NULL) {
+    self->workers = (WorkerStream*) calloc(self->config.num_streams,
+                                           sizeof(WorkerStream));
+    if (self->workers == NULL) {
+      return -1;
+    }
+  }
+  for (;;) {
+    const uint32_t doorbell = __atomic_load_n(&header->audio_doorbell,
+                                              __ATOMIC_SEQ_CST);
+    int n;
+
+    if (__atomic_load_n(&header->stopped, __ATOMIC_ACQUIRE)) {
+      return -1;
+    }
+    n = DrainReady(self);
+    if (n < 0) {
+      return -1;
+    }
+    processed += n;
+    if (processed > 0 || timeout_ms == 0 || waited) {
+      break;
+    }
+    __atomic_store_n(&header->worker_waiting, 1, __ATOMIC_SEQ_CST);
+    if (!AnyReady(self)) {
+      Wait(&header->audio_doorbell, doorbell, timeout_ms);
+      waited = 1;
+    }
+    __atomic_store_n(&header->worker_waiting, 0, __ATOMIC_SEQ_CST);
+  }
+  if (self->pending_decisions > 0) {
+    WakeReader(self);
+  }
+  return processed;
+}
@@ -0,0 +1,105 @@
+#ifndef VAD_SHM_H_
+#define VAD_SHM_H_
+
+#include <stdint.h>
+
+#include "vad.h"
+
+// Shared memory transport between a media process and a VAD worker process.
+// The segment is a memfd holding one single producer, single consumer ring
+// of audio frames per stream and one ring of decisions back. The media
+// process writes frames and reads decisions; the worker process runs the
+// VAD on every frame and writes the decisions. Neither side copies more than
+// the frame itself, and a wakeup (futex) is only needed once per
+// |wake_batch| frames or decisions, or when a side goes to sleep.
+//
+// The worker keeps the VAD state in its own memory and trusts nothing in the
+// segment: ring indices are bounded and stream settings validated before
+// use, so a misbehaving peer cannot crash it. If the worker dies, the media
+// process can start a new one on the same segment. It resumes with the
+// first frame not yet consumed, with fresh VAD state; the decision of that
+// frame may then come twice.
+//
+// Each side uses its own VadShm. Neither is thread safe.
+typedef struct VadShm VadShm;
+
+typedef struct {
+  int num_streams;
+  int ring_frames;         // Frames per stream ring, a power of two.
+  int max_frame_length;    // Samples per frame, at most 1440.
+  int decision_ring_size;  // A power of two.
+  int wake_batch;          // Frames or decisions per wakeup.
+  // Only decisions that differ from the previous frame of the stream.
+  int changes_only;
+} VadShmConfig;
+
+typedef struct {
+  uint32_t stream;
+  // Index of the frame since VadShm_OpenStream().
+  uint32_t frame;
+  int32_t decision;  // 1 - (Active Voice), 0 - (Non-active Voice).
+} VadShmDecision;
+
+// Sets |config| to 1024 streams of 16 frames of up to 30 ms at 16 kHz, a
+// ring of 16384 decisions, wakeups every 32 and all decisions.
+void VadShm_DefaultConfig(VadShmConfig* config);
+
+// Creates and maps a new segment, on the media side.
+//
+// returns : The segment, or NULL (invalid settings, no memory)
+VadShm* VadShm_Create(const VadShmConfig* config);
+
+// Maps the segment behind |fd|, on the worker side. |fd| is not closed, the
+// mapping stays valid without it.
+//
+// returns : The segment, or NULL (not a segment, no memory)
+VadShm* VadShm_Attach(int fd);
+
+// File descriptor of the segment, to be inherited or sent to the worker.
+int VadShm_Fd(const VadShm* self);
+
+// Unmaps the segment and frees the VAD instances of this side.
+void VadShm_Free(VadShm* self);
+
+// Media side. Starts |stream| over with new settings. The worker picks them
+// up with the next frame, with a fresh VAD.
+//
+// - stream       [i] : Index, < |num_streams|.
+// - fs           [i] : Sampling frequency (Hz): 8000, 16000, 32000 or 48000
+// - frame_length [i] : Samples per frame, a valid length at |fs| and at most
+//                      |max_frame_length|.
+// - mode         [i] : Aggressiveness, 0 - 3.
+//
+// returns            : 0 - (OK), -1 - (invalid settings, or frames of the
+//                      previous settings are still in the ring)
+int VadShm_OpenStream(VadShm* self, int stream, int fs, int frame_length,
+                      int mode);
+
+// Media side. Appends a frame of |stream| to its ring.
+//
+// returns : 0 - (OK), -1 - (the ring is full or the stream is not open)
+int VadShm_WriteFrame(VadShm* self, int stream, const int16_t* frame);
+
+// Media side. Wakes the worker for the frames written since the last wakeup,
+// say at the end of every 10 ms tick.
+void VadShm_Flush(VadShm* self);
+
+// Media side. Takes up to |max_decisions| decisions, waiting up to
+// |timeout_ms| (-1: forever) for the first one.
+//
+// returns : Number of decisions, 0 on timeout
+int VadShm_ReadDecisions(VadShm* self, VadShmDecision* decisions,
+                         int max_decisions, int timeout_ms);
+
+// Media side. Makes VadShm_Work() return -1 from now on.
+void VadShm_Stop(VadShm* self);
+
+// Worker side. Runs the VAD over all frames that are ready, waiting up to
+// |timeout_ms| (-1: forever) if there are none. Frames of streams with
+// invalid settings are dropped. Waits for room when the decision ring is
+// full.
+//
+// returns : Number of frames processed, -1 - (stopped)
+int VadShm_Work(VadShm* self, int timeout_ms);
+
+#endif  // VAD_SHM_H_
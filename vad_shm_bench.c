@@ -0,0 +1,417 @@
+// Measures the shared memory transport of vad_shm.h against pipes and
+// against the VAD in process.
+//
+// Usage: vad_shm_bench [-n streams] [-f frame_ms] [-m mode] [-w wake_batch]
+//                      [-F frames] [-k] file.wav
+//
+// Every stream plays the file from its own offset, |frames| frames each,
+// and a forked worker process runs the VAD. With pipes every frame is one
+// write() into the worker and one back with its decision. The decisions of
+// both must match the VAD in process exactly. Time is wall clock over both
+// processes, CPU time is their sum.
+//
+// With -k the worker is killed halfway through and a new one is started on
+// the same segment. The frames the dead worker had taken without writing
+// a decision are reported as missing, and later decisions may differ as the
+// new worker starts with fresh VAD state.
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vad.h"
+#include "vad_shm.h"
+#include "wav_reader.h"
+
+enum { kPipeWindow = 64 };
+
+typedef struct {
+  int num_streams;
+  int fs;
+  int frame_length;
+  int mode;
+  size_t frames_per_stream;
+  const int16_t* audio;
+  size_t num_audio_frames;
+} Job;
+
+typedef struct {
+  uint32_t stream;
+  uint32_t frame;
+} PipeHeader;
+
+static double NowSeconds(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double CpuSeconds(int who) {
+  struct rusage usage;
+
+  getrusage(who, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+      (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static double TotalCpuSeconds(void) {
+  return CpuSeconds(RUSAGE_SELF) + CpuSeconds(RUSAGE_CHILDREN);
+}
+
+static const int16_t* Frame(const Job* job, int stream, size_t frame) {
+  const size_t offset = (size_t) stream * 97 + frame;
+
+  return &job->audio[(offset % job->num_audio_frames) * job->frame_length];
+}
+
+static void InProcess(const Job* job, uint8_t* decisions) {
+  VadInst** vads = (VadInst**) calloc(job->num_streams, sizeof(VadInst*));
+  size_t frame;
+  int s;
+
+  for (s = 0; s < job->num_streams; s++) {
+    WebRtcVad_Create(&vads[s]);
+    WebRtcVad_Init(vads[s]);
+    WebRtcVad_set_mode(vads[s], job->mode);
+  }
+  for (frame = 0; frame < job->frames_per_stream; frame++) {
+    for (s = 0; s < job->num_streams; s++) {
+      decisions[s * job->frames_per_stream + frame] = (uint8_t)
+          WebRtcVad_Process(vads[s], job->fs, (int16_t*) Frame(job, s, frame),
+                            job->frame_length);
+    }
+  }
+  for (s = 0; s < job->num_streams; s++) {
+    WebRtcVad_Free(vads[s]);
+  }
+  free(vads);
+}
+
+static int ReadFully(int fd, void* data, size_t size) {
+  uint8_t* bytes = (uint8_t*) data;
+
+  while (size > 0) {
+    const ssize_t n = read(fd, bytes, size);
+
+    if (n <= 0) {
+      return -1;
+    }
+    bytes += n;
+    size -= n;
+  }
+  return 0;
+}
+
+static void PipeWorker(const Job* job, int in, int out) {
+  VadInst** vads = (VadInst**) calloc(job->num_streams, sizeof(VadInst*));
+  int16_t frame[1440];
+  PipeHeader header;
+  VadShmDecision decision;
+  int s;
+
+  for (s = 0; s < job->num_streams; s++) {
+    WebRtcVad_Create(&vads[s]);
+    WebRtcVad_Init(vads[s]);
+    WebRtcVad_set_mode(vads[s], job->mode);
+  }
+  while (ReadFully(in, &header, sizeof(header)) == 0 &&
+         ReadFully(in, frame, job->frame_length * sizeof(int16_t)) == 0) {
+    decision.stream = header.stream;
+    decision.frame = header.frame;
+    decision.decision = WebRtcVad_Process(vads[header.stream], job->fs, frame,
+                                          job->frame_length);
+    if (write(out, &decision, sizeof(decision)) != sizeof(decision)) {
+      break;
+    }
+  }
+  _exit(0);
+}
+
+static void ViaPipes(const Job* job, uint8_t* decisions) {
+  const size_t total = job->frames_per_stream * job->num_streams;
+  int to_worker[2], from_worker[2];
+  size_t frame, received = 0;
+  int outstanding = 0;
+  pid_t worker;
+  int s;
+
+  if (pipe(to_worker) != 0 || pipe(from_worker) != 0) {
+    perror("pipe");
+    exit(1);
+  }
+  worker = fork();
+  if (worker == 0) {
+    close(to_worker[1]);
+    close(from_worker[0]);
+    PipeWorker(job, to_worker[0], from_worker[1]);
+  }
+  close(to_worker[0]);
+  close(from_worker[1]);
+  for (frame = 0; frame < job->frames_per_stream; frame++) {
+    for (s = 0; s < job->num_streams; s++) {
+      PipeHeader header;
+
+      header.stream = (uint32_t) s;
+      header.frame = (uint32_t) frame;
+      if (write(to_worker[1], &header, sizeof(header)) != sizeof(header) ||
+          write(to_worker[1], Frame(job, s, frame),
+                job->frame_length * sizeof(int16_t)) !=
+          (ssize_t) (job->frame_length * sizeof(int16_t))) {
+        perror("write");
+        exit(1);
+      }
+      // The window keeps both pipes from filling up.
+      if (++outstanding == kPipeWindow) {
+        VadShmDecision batch[kPipeWindow];
+        const ssize_t n = read(from_worker[0], batch, sizeof(batch));
+        ssize_t i;
+
+        for (i = 0; i < n / (ssize_t) sizeof(VadShmDecision); i++) {
+          decisions[batch[i].stream * job->frames_per_stream +
+                    batch[i].frame] = (uint8_t) batch[i].decision;
+        }
+        received += n / sizeof(VadShmDecision);
+        outstanding -= n / sizeof(VadShmDecision);
+      }
+    }
+  }
+  close(to_worker[1]);
+  while (received < total) {
+    VadShmDecision decision;
+
+    if (ReadFully(from_worker[0], &decision, sizeof(decision)) != 0) {
+      break;
+    }
+    decisions[decision.stream * job->frames_per_stream + decision.frame] =
+        (uint8_t) decision.decision;
+    received++;
+  }
+  close(from_worker[0]);
+  waitpid(worker, NULL, 0);
+}
+
+static pid_t StartShmWorker(int fd) {
+  const pid_t worker = fork();
+
+  if (worker == 0) {
+    VadShm* shm = VadShm_Attach(fd);
+
+    if (shm == NULL) {
+      fprintf(stderr, "cannot attach\n");
+      _exit(1);
+    }
+    while (VadShm_Work(shm, -1) >= 0) {
+    }
+    VadShm_Free(shm);
+    _exit(0);
+  }
+  return worker;
+}
+
+static size_t TakeDecisions(VadShm* shm, const Job* job, uint8_t* decisions,
+                            int timeout_ms) {
+  VadShmDecision batch[1024];
+  int n, i;
+
+  n = VadShm_ReadDecisions(shm, batch, 1024, timeout_ms);
+  for (i = 0; i < n; i++) {
+    if (batch[i].frame < job->frames_per_stream) {
+      decisions[batch[i].stream * job->frames_per_stream + batch[i].frame] =
+          (uint8_t) batch[i].decision;
+    }
+  }
+  return (size_t) n;
+}
+
+// Returns the number of decisions that never came.
+static size_t ViaShm(const Job* job, int wake_batch, int kill_worker,
+                     uint8_t* decisions) {
+  const size_t total = job->frames_per_stream * job->num_streams;
+  VadShmConfig config;
+  VadShm* shm;
+  size_t frame, received = 0;
+  pid_t worker;
+  int s;
+
+  VadShm_DefaultConfig(&config);
+  config.num_streams = job->num_streams;
+  config.max_frame_length = job->frame_length;
+  config.wake_batch = wake_batch;
+  shm = VadShm_Create(&config);
+  if (shm == NULL) {
+    fprintf(stderr, "cannot create the segment\n");
+    exit(1);
+  }
+  for (s = 0; s < job->num_streams; s++) {
+    VadShm_OpenStream(shm, s, job->fs, job->frame_length, job->mode);
+  }
+  worker = StartShmWorker(VadShm_Fd(shm));
+
+  for (frame = 0; frame < job->frames_per_stream; frame++) {
+    if (kill_worker && frame == job->frames_per_stream / 2) {
+      kill(worker, SIGKILL);
+      waitpid(worker, NULL, 0);
+      worker = StartShmWorker(VadShm_Fd(shm));
+      printf("  worker killed and restarted at frame %zu\n", frame);
+    }
+    for (s = 0; s < job->num_streams; s++) {
+      while (VadShm_WriteFrame(shm, s, Frame(job, s, frame)) != 0) {
+        VadShm_Flush(shm);
+        received += TakeDecisions(shm, job, decisions, 1);
+      }
+    }
+    // One tick of all streams.
+    VadShm_Flush(shm);
+    received += TakeDecisions(shm, job, decisions, 0);
+  }
+  // A killed worker may have taken frames without writing their decisions.
+  while (received < total) {
+    const size_t n = TakeDecisions(shm, job, decisions, 200);
+
+    if (n == 0) {
+      break;
+    }
+    received += n;
+  }
+  VadShm_Stop(shm);
+  waitpid(worker, NULL, 0);
+  VadShm_Free(shm);
+  return received < total ? total - received : 0;
+}
+
+static size_t CountMismatches(const uint8_t* a, const uint8_t* b,
+                              size_t size) {
+  size_t mismatches = 0, i;
+
+  for (i = 0; i < size; i++) {
+    mismatches += a[i] != b[i];
+  }
+  return mismatches;
+}
+
+static void Usage(void) {
+  fprintf(stderr, "usage: vad_shm_bench [-n streams] [-f frame_ms] "
+          "[-m mode] [-w wake_batch] [-F frames] [-k] file.wav\n");
+}
+
+int main(int argc, char* argv[]) {
+  int frame_ms = 10;
+  int wake_batch = 32;
+  int kill_worker = 0;
+  size_t frames = 0;
+  WavReader wav;
+  Job job;
+  int16_t* mono;
+  uint8_t* reference;
+  uint8_t* decisions;
+  size_t total;
+  double start, cpu, in_process_s;
+  int opt;
+
+  job.num_streams = 100;
+  job.mode = 2;
+  while ((opt = getopt(argc, argv, "n:f:m:w:F:k")) != -1) {
+    if (opt == 'n') {
+      job.num_streams = atoi(optarg);
+    } else if (opt == 'f') {
+      frame_ms = atoi(optarg);
+    } else if (opt == 'm') {
+      job.mode = atoi(optarg);
+    } else if (opt == 'w') {
+      wake_batch = atoi(optarg);
+    } else if (opt == 'F') {
+      frames = (size_t) atol(optarg);
+    } else if (opt == 'k') {
+      kill_worker = 1;
+    } else {
+      Usage();
+      return 1;
+    }
+  }
+  if (optind != argc - 1 || job.num_streams < 1 || wake_batch < 1) {
+    Usage();
+    return 1;
+  }
+  if (WavReader_Open(&wav, argv[optind]) != 0) {
+    fprintf(stderr, "%s: %s\n", argv[optind], wav.error);
+    return 1;
+  }
+  job.fs = WavReader_VadRate(&wav);
+  if (job.fs < 0) {
+    fprintf(stderr, "%s: %d Hz is not supported by the VAD\n", argv[optind],
+            wav.sample_rate);
+    return 1;
+  }
+  job.frame_length = job.fs / 1000 * frame_ms;
+  if (WebRtcVad_ValidRateAndFrameLength(job.fs, job.frame_length) != 0 ||
+      wav.num_samples < (size_t) job.frame_length) {
+    fprintf(stderr, "invalid frame length: %d ms\n", frame_ms);
+    return 1;
+  }
+  mono = WavReader_CopyChannel(&wav, 0);
+  if (mono == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  job.audio = mono;
+  job.num_audio_frames = wav.num_samples / job.frame_length;
+  job.frames_per_stream = frames > 0 ? frames : job.num_audio_frames;
+  total = job.frames_per_stream * job.num_streams;
+  reference = (uint8_t*) malloc(total);
+  decisions = (uint8_t*) malloc(total);
+
+  printf("%d streams of %zu frames of %d ms at %d Hz, mode %d\n",
+         job.num_streams, job.frames_per_stream, frame_ms, job.fs, job.mode);
+
+  start = NowSeconds();
+  cpu = TotalCpuSeconds();
+  InProcess(&job, reference);
+  in_process_s = NowSeconds() - start;
+  printf("in process: %7.0f ns/frame, %7.0f ns/frame cpu\n",
+         1e9 * in_process_s / total, 1e9 * (TotalCpuSeconds() - cpu) / total);
+
+  memset(decisions, 0xFF, total);
+  start = NowSeconds();
+  cpu = TotalCpuSeconds();
+  ViaPipes(&job, decisions);
+  {
+    const size_t mismatches = CountMismatches(reference, decisions, total);
+
+    printf("pipes:      %7.0f ns/frame, %7.0f ns/frame cpu, %zu mismatches\n",
+           1e9 * (NowSeconds() - start) / total,
+           1e9 * (TotalCpuSeconds() - cpu) / total, mismatches);
+    if (mismatches > 0) {
+      return 1;
+    }
+  }
+
+  memset(decisions, 0xFF, total);
+  start = NowSeconds();
+  cpu = TotalCpuSeconds();
+  {
+    const size_t missing = ViaShm(&job, wake_batch, kill_worker, decisions);
+    const size_t mismatches = CountMismatches(reference, decisions, total);
+
+    printf("shm:        %7.0f ns/frame, %7.0f ns/frame cpu, %zu mismatches",
+           1e9 * (NowSeconds() - start) / total,
+           1e9 * (TotalCpuSeconds() - cpu) / total, mismatches - missing);
+    if (kill_worker) {
+      printf(", %zu missing", missing);
+    }
+    printf("\n");
+    if (!kill_worker && mismatches > 0) {
+      return 1;
+    }
+  }
+  WavReader_Close(&wav);
+  free(mono);
+  free(reference);
+  free(decisions);
+  return 0;
+}
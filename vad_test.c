@@ -1,39 +1,89 @@
 #include<stdio.h>
+#include<stdlib.h>
 #include "vad.h"
+#include "wav_reader.h"
+
 int main()
 {
-	FILE *fpInputf;
+	WavReader wav;
 	int ret = 0;
 	int noVoiceCount = 0;
 	int maxZeroFrame = 80; // 连续80帧（delay = 80 * 采样/帧长）检测到没有声音  标识停止
 	int voiceStartFlag = 0; // 是否标志了语音开始 0 未标定
-	int kRates[] = { 8000, 12000, 16000, 24000, 32000, 48000 };
-	int kFrameLengths[] = { 80, 120, 160, 240, 320, 480, 640, 960 };
-	short datas[kFrameLengths[2]];
-		
+	int rate, frameLength;
+	size_t numFrames, i;
+	int16_t* mono = NULL;
+	const int16_t* audio;
+	uint8_t* decisions;
+
 	VadInst* handle = NULL;
 	int mode = 2; // 模式
 	// 1.初始化 设置模式
 	WebRtcVad_Create(&handle);
 	WebRtcVad_Init(handle);
 	WebRtcVad_set_mode(handle,mode);
+	// 每个实例占用的内存（48 kHz 时额外分配重采样状态，浮点引擎额外分配浮点状态）
+	printf("bytes per instance: %d (+%d at 48 kHz, +%d with the float engine)\n",
+	       (int)sizeof(VadInstT), (int)sizeof(WebRtcSpl_State48khzTo8khz),
+	       (int)sizeof(VadFloatState));
+
+	// 映射整个文件，采样数据直接指向映射区，不含 44 字节的文件头
+	if(WavReader_Open(&wav, "deb_01.wav") != 0)
+	{
+		printf("There is no input file (%s)\n", wav.error);
+		WebRtcVad_Free(handle);
+		return 0;
+	}
 
-	fpInputf=fopen("deb_01.wav","rb");
-	if(fpInputf==NULL)
+	// 使用文件头里的采样率，相差 5% 以内时按最接近的 VAD 采样率处理，否则不支持
+	rate = WavReader_VadRate(&wav);
+	if(rate < 0)
 	{
-		printf("There is no input file\n");
+		printf("%d Hz is not supported by the VAD\n", wav.sample_rate);
+		WavReader_Close(&wav);
+		WebRtcVad_Free(handle);
 		return 0;
 	}
+	if(rate != wav.sample_rate)
+	{
+		printf("warning: processing %d Hz as %d Hz\n", wav.sample_rate, rate);
+	}
+	frameLength = rate / 50; // 20 ms
+	numFrames = wav.num_samples / frameLength;
+
+	// 多声道时只取第一个声道
+	audio = wav.samples;
+	if(wav.channels > 1)
+	{
+		mono = WavReader_CopyChannel(&wav, 0);
+		if(mono == NULL)
+		{
+			printf("out of memory\n");
+			WavReader_Close(&wav);
+			WebRtcVad_Free(handle);
+			return 0;
+		}
+		audio = mono;
+	}
+
+	// 2.执行检测 一次处理所有完整的帧
+	decisions = (uint8_t*)malloc(numFrames > 0 ? numFrames : 1);
+	if(decisions == NULL ||
+	   WebRtcVad_ProcessBatch(handle, rate, audio, frameLength, numFrames,
+	                          decisions) != 0)
+	{
+		printf("WebRtcVad_ProcessBatch is error\n");
+		numFrames = 0;
+	}
 
-	while(!feof(fpInputf))
+	for (i = 0; i < numFrames; i++)
 	{
-		fread(datas,sizeof(short),kFrameLengths[2],fpInputf);
-		// 2.执行检测
-		ret = vad_main_process(handle, kFrameLengths[2], kRates[0], datas);
-		
+		ret = decisions[i];
+		printf("result = %d\n",ret);
+
 		if(ret == 0) {
 			noVoiceCount+=1;
-			if(noVoiceCount >= maxZeroFrame){ 
+			if(noVoiceCount >= maxZeroFrame){
 				if(voiceStartFlag == 1){ // 标记语音停止
 					voiceStartFlag = 0;
 					// ...
@@ -45,12 +95,20 @@ int main()
 			voiceStartFlag = 1;
 			noVoiceCount = 0;
 		}
-		
+
 	}
-	fclose(fpInputf);	
+	// 最后不足一帧的采样不处理
+	if(wav.num_samples % frameLength != 0)
+	{
+		printf("ignored %d trailing samples\n",
+		       (int)(wav.num_samples % frameLength));
+	}
+	free(decisions);
+	free(mono);
+	WavReader_Close(&wav);
 	// 3.释放
 	WebRtcVad_Free(handle);
-	
+
 	printf("finished \n");
 	return 0;
 }
@@ -0,0 +1,321 @@
+#include "wav_reader.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum { kFormatPcm = 0x0001 };
+enum { kFormatExtensible = 0xFFFE };
+enum { kRiffHeaderSize = 12 };
+enum { kChunkHeaderSize = 8 };
+enum { kFmtMinSize = 16 };
+enum { kFmtExtensibleSize = 40 };
+
+// KSDATAFORMAT_SUBTYPE_PCM, the format tag goes in the first two bytes.
+static const uint8_t kPcmSubFormatTail[14] = {
+  0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00,
+  0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+};
+
+static uint16_t ReadLe16(const uint8_t* p) {
+  return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t ReadLe32(const uint8_t* p) {
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) |
+      ((uint32_t) p[3] << 24);
+}
+
+static int Fail(WavReader* reader, const char* error) {
+  reader->error = error;
+  return -1;
+}
+
+// Returns 1 if the four bytes at |p| look like a chunk id.
+static int IsChunkId(const uint8_t* p) {
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    if (p[i] < 0x20 || p[i] > 0x7E) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Validates the "fmt " chunk of |size| bytes at |fmt|.
+static int ParseFormat(WavReader* reader, const uint8_t* fmt, size_t size) {
+  uint16_t format_tag;
+  int block_align;
+
+  if (size < kFmtMinSize) {
+    return Fail(reader, "fmt chunk too short");
+  }
+  format_tag = ReadLe16(fmt);
+  reader->channels = ReadLe16(fmt + 2);
+  reader->sample_rate = (int) ReadLe32(fmt + 4);
+  block_align = ReadLe16(fmt + 12);
+  reader->bits_per_sample = ReadLe16(fmt + 14);
+
+  if (format_tag == kFormatExtensible) {
+    // cbSize must cover valid bits, channel mask and the sub format GUID.
+    if (size < kFmtExtensibleSize || ReadLe16(fmt + 16) < 22) {
+      return Fail(reader, "extensible fmt chunk too short");
+    }
+    if (memcmp(fmt + 26, kPcmSubFormatTail, sizeof(kPcmSubFormatTail)) != 0) {
+      return Fail(reader, "unknown sub format");
+    }
+    format_tag = ReadLe16(fmt + 24);
+    // Valid bits may be fewer than the container, the samples are still
+    // left aligned 16-bit words.
+    if (ReadLe16(fmt + 18) > reader->bits_per_sample) {
+      return Fail(reader, "invalid number of valid bits");
+    }
+  }
+
+  if (format_tag != kFormatPcm) {
+    return Fail(reader, "not PCM");
+  }
+  if (reader->bits_per_sample != 16) {
+    return Fail(reader, "not 16 bits per sample");
+  }
+  if (reader->channels < 1 || reader->sample_rate <= 0) {
+    return Fail(reader, "invalid channel count or sample rate");
+  }
+  if (block_align != reader->channels * 2) {
+    return Fail(reader, "invalid block alignment");
+  }
+  return 0;
+}
+
+// Points |reader->samples| at |size| bytes of sample data at |data|.
+static int SetSamples(WavReader* reader, const uint8_t* data, size_t size) {
+  const size_t block_size = (size_t) reader->channels * sizeof(int16_t);
+  size_t total;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  size_t i;
+#endif
+
+  reader->num_samples = size / block_size;
+  total = reader->num_samples * reader->channels;
+  if (total == 0) {
+    reader->samples = NULL;
+    return 0;
+  }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  reader->copy = (int16_t*) malloc(total * sizeof(int16_t));
+  if (reader->copy == NULL) {
+    return Fail(reader, "out of memory");
+  }
+  for (i = 0; i < total; i++) {
+    reader->copy[i] = (int16_t) ReadLe16(data + 2 * i);
+  }
+  reader->samples = reader->copy;
+#else
+  if (((uintptr_t) data & (sizeof(int16_t) - 1)) != 0) {
+    // Odd chunk layout, e.g., a missing pad byte before the data chunk.
+    reader->copy = (int16_t*) malloc(total * sizeof(int16_t));
+    if (reader->copy == NULL) {
+      return Fail(reader, "out of memory");
+    }
+    memcpy(reader->copy, data, total * sizeof(int16_t));
+    reader->samples = reader->copy;
+  } else {
+    reader->samples = (const int16_t*) data;
+  }
+#endif
+  return 0;
+}
+
+// Walks the chunks of the |file_size| bytes at |file|.
+static int ParseFile(WavReader* reader, const uint8_t* file,
+                     size_t file_size) {
+  const uint8_t* fmt = NULL;
+  const uint8_t* data = NULL;
+  size_t fmt_size = 0;
+  size_t data_size = 0;
+  size_t end;
+  size_t pos;
+
+  if (memcmp(file, "RIFF", 4) != 0 || memcmp(file + 8, "WAVE", 4) != 0) {
+    return Fail(reader, "not a RIFF/WAVE file");
+  }
+  // Streaming writers leave the RIFF size at 0 or 0xFFFFFFFF, so walk the
+  // chunks up to the end of the file rather than trusting it.
+  end = file_size;
+
+  pos = kRiffHeaderSize;
+  while (pos + kChunkHeaderSize <= end && (fmt == NULL || data == NULL)) {
+    const uint8_t* chunk = file + pos;
+    size_t size = ReadLe32(chunk + 4);
+    size_t available = end - pos - kChunkHeaderSize;
+
+    if (memcmp(chunk, "data", 4) == 0) {
+      if (data != NULL) {
+        return Fail(reader, "more than one data chunk");
+      }
+      data = chunk + kChunkHeaderSize;
+      data_size = size < available ? size : available;
+    } else if (memcmp(chunk, "fmt ", 4) == 0) {
+      if (size > available) {
+        return Fail(reader, "fmt chunk truncated");
+      }
+      fmt = chunk + kChunkHeaderSize;
+      fmt_size = size;
+    }
+    if (size > available) {
+      break;
+    }
+    // Chunks are padded to an even size, but some writers leave out the
+    // pad byte. Use whichever position holds the next chunk id.
+    pos += kChunkHeaderSize + size;
+    if ((size & 1) && (pos + 1 + 4 > end || !IsChunkId(file + pos + 1)) &&
+        pos + 4 <= end && IsChunkId(file + pos)) {
+      continue;
+    }
+    pos += size & 1;
+  }
+
+  if (fmt == NULL) {
+    return Fail(reader, "no fmt chunk");
+  }
+  if (data == NULL) {
+    return Fail(reader, "no data chunk");
+  }
+  if (ParseFormat(reader, fmt, fmt_size) != 0) {
+    return -1;
+  }
+  return SetSamples(reader, data, data_size);
+}
+
+int WavReader_Open(WavReader* reader, const char* path) {
+  struct stat st;
+  int fd;
+
+  memset(reader, 0, sizeof(*reader));
+  if (path == NULL) {
+    return Fail(reader, "no file name");
+  }
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return Fail(reader, "cannot open file");
+  }
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return Fail(reader, "not a regular file");
+  }
+  if (st.st_size < kRiffHeaderSize + kChunkHeaderSize) {
+    close(fd);
+    return Fail(reader, "file too short");
+  }
+  reader->map_size = (size_t) st.st_size;
+  reader->map = mmap(NULL, reader->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (reader->map == MAP_FAILED) {
+    reader->map = NULL;
+    return Fail(reader, "cannot map file");
+  }
+  // The file is read front to back exactly once.
+  madvise(reader->map, reader->map_size, MADV_SEQUENTIAL);
+
+  if (ParseFile(reader, (const uint8_t*) reader->map, reader->map_size) != 0) {
+    const char* error = reader->error;
+    WavReader_Close(reader);
+    reader->error = error;
+    return -1;
+  }
+  if (reader->copy != NULL) {
+    // Nothing refers to the mapping any more.
+    munmap(reader->map, reader->map_size);
+    reader->map = NULL;
+  }
+  return 0;
+}
+
+int WavReader_OpenMemory(WavReader* reader, const void* data, size_t size) {
+  memset(reader, 0, sizeof(*reader));
+  if (data == NULL || size < kRiffHeaderSize + kChunkHeaderSize) {
+    return Fail(reader, "file too short");
+  }
+  if (ParseFile(reader, (const uint8_t*) data, size) != 0) {
+    const char* error = reader->error;
+    WavReader_Close(reader);
+    reader->error = error;
+    return -1;
+  }
+  return 0;
+}
+
+size_t WavReader_ExpectedSize(const void* data, size_t size) {
+  const uint8_t* file = (const uint8_t*) data;
+  size_t pos = kRiffHeaderSize;
+
+  if (size < kRiffHeaderSize || memcmp(file, "RIFF", 4) != 0 ||
+      memcmp(file + 8, "WAVE", 4) != 0) {
+    return size;
+  }
+  while (pos + kChunkHeaderSize <= size) {
+    const uint32_t chunk_size = ReadLe32(file + pos + 4);
+
+    if (memcmp(file + pos, "data", 4) == 0) {
+      // Left at 0 or 0xFFFFFFFF by streaming writers.
+      if (chunk_size == 0 || chunk_size == 0xFFFFFFFF) {
+        return 0;
+      }
+      return pos + kChunkHeaderSize + chunk_size;
+    }
+    pos += kChunkHeaderSize + chunk_size + (chunk_size & 1);
+  }
+  return 0;
+}
+
+int WavReader_VadRate(const WavReader* reader) {
+  // The rates of WebRtcVad_Process().
+  static const int kRates[] = { 8000, 16000, 32000, 48000 };
+  size_t i;
+
+  for (i = 0; i < sizeof(kRates) / sizeof(*kRates); i++) {
+    if (llabs((long long) reader->sample_rate - kRates[i]) * 20 <=
+        kRates[i]) {
+      return kRates[i];
+    }
+  }
+  return -1;
+}
+
+int16_t* WavReader_CopyChannel(const WavReader* reader, int channel) {
+  int16_t* samples;
+  size_t i;
+
+  if (channel < 0 || channel >= reader->channels) {
+    return NULL;
+  }
+  samples = (int16_t*) malloc(reader->num_samples > 0 ?
+                              reader->num_samples * sizeof(int16_t) : 1);
+  if (samples == NULL) {
+    return NULL;
+  }
+  for (i = 0; i < reader->num_samples; i++) {
+    samples[i] = reader->samples[i * reader->channels + channel];
+  }
+  return samples;
+}
+
+void WavReader_Close(WavReader* reader) {
+  if (reader == NULL) {
+    return;
+  }
+  if (reader->map != NULL) {
+    munmap(reader->map, reader->map_size);
+  }
+  free(reader->copy);
+  reader->map = NULL;
+  reader->copy = NULL;
+  reader->samples = NULL;
+  reader->num_samples = 0;
+}
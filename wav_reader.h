@@ -0,0 +1,87 @@
+#ifndef WAV_READER_H_
+#define WAV_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Read-only view of a 16-bit PCM RIFF/WAVE file. The file is memory mapped
+// and |samples| points straight into the mapping whenever the sample data is
+// suitably aligned. Otherwise (the data chunk starts at an odd offset, or the
+// host is big endian) the samples are copied once.
+typedef struct {
+  int sample_rate;
+  int channels;
+  int bits_per_sample;
+  // Interleaved samples, |num_samples| per channel.
+  const int16_t* samples;
+  size_t num_samples;
+  // Describes why WavReader_Open() failed.
+  const char* error;
+
+  // Private.
+  void* map;
+  size_t map_size;
+  int16_t* copy;
+} WavReader;
+
+// Maps |path| and parses its "fmt " and "data" chunks. Chunks may come in
+// any order, unknown chunks are skipped and both PCM (format tag 1) and
+// WAVE_FORMAT_EXTENSIBLE with a PCM sub format are accepted. A data chunk
+// whose size field is larger than the file (truncated or still being
+// written) is cut at the end of the file.
+//
+// - reader [o] : Reader to initialize.
+// - path   [i] : File name.
+//
+// returns      : 0 - (OK), -1 - (cannot be read, not a 16-bit PCM WAVE
+//                file; |reader->error| says why)
+int WavReader_Open(WavReader* reader, const char* path);
+
+// Parses a file that is already in memory, as WavReader_Open() does. The
+// samples point into |data| when suitably aligned, so |data| must outlive
+// the reader.
+//
+// - reader [o] : Reader to initialize.
+// - data   [i] : The whole file.
+// - size   [i] : Size of |data| in bytes.
+//
+// returns      : 0 - (OK), -1 - (not a 16-bit PCM WAVE file;
+//                |reader->error| says why)
+int WavReader_OpenMemory(WavReader* reader, const void* data, size_t size);
+
+// Tells from the start of a file how large the whole file should be, that
+// is, where its data chunk ends, so the rest can be read in one go.
+//
+// - data [i] : The first |size| bytes of the file.
+// - size [i] : Size of |data| in bytes.
+//
+// returns    : Size of the file up to the end of the data chunk,
+//              |size| - (not a WAVE file, nothing more is needed),
+//              0 - (unknown: the data chunk starts beyond |data| or a
+//              streaming writer left its size open)
+size_t WavReader_ExpectedSize(const void* data, size_t size);
+
+// Picks the rate at which the VAD should process |reader|: its own rate if
+// the VAD supports it (8, 16, 32 or 48 kHz), or the nearest supported rate
+// within 5 %, for recordings whose clock is slightly off (e.g., 15625 Hz).
+// Other rates, such as 44.1 or 22.05 kHz, would need resampling first.
+//
+// - reader [i] : An open reader.
+//
+// returns      : The rate in Hz, -1 - (not supported by the VAD)
+int WavReader_VadRate(const WavReader* reader);
+
+// Copies |channel| out of the interleaved samples.
+//
+// - reader  [i] : An open reader.
+// - channel [i] : Channel index, < |reader->channels|.
+//
+// returns       : |reader->num_samples| samples to free() (at least one
+//                 byte is allocated), or NULL (invalid channel, out of
+//                 memory)
+int16_t* WavReader_CopyChannel(const WavReader* reader, int channel);
+
+// Unmaps the file and frees a copy of the samples, if any.
+void WavReader_Close(WavReader* reader);
+
+#endif  // WAV_READER_H_